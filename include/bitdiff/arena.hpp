@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <cstddef>
+
+namespace isaki::bitdiff
+{
+    // Vector kernels want cache line alignment; O_DIRECT wants page
+    // alignment.
+    inline constexpr std::size_t SIMD_ALIGNMENT = 64;
+    inline constexpr std::size_t IO_ALIGNMENT = 4096;
+
+    // One mapping that backs every buffer a diff needs. From 1 MiB up the
+    // mapping is 2 MiB aligned and backed by huge pages when the system
+    // allows it; smaller arenas use ordinary pages. Memory is
+    // handed out uninitialized (anonymous pages are zero on first touch) and
+    // released all at once on destruction. With a NUMA placement installed
+    // the mapping is bound to its node (see placement.hpp).
+    class Arena final
+    {
+    public:
+        Arena() = delete;
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+        Arena(Arena&&) = delete;
+        Arena& operator=(Arena&&) = delete;
+
+        ~Arena();
+
+        explicit Arena(std::size_t capacity);
+
+        // Alignment must be a power of two no larger than IO_ALIGNMENT for
+        // arenas under 1 MiB, or 2 MiB otherwise. Throws
+        // std::bad_alloc when the arena is exhausted.
+        [[nodiscard]] void* allocate(std::size_t len, std::size_t alignment);
+
+        template<typename T>
+        [[nodiscard]] T* allocate(const std::size_t count, const std::size_t alignment)
+        {
+            return static_cast<T*>(allocate(count * sizeof(T), alignment));
+        }
+
+        // True when the mapping came from MAP_HUGETLB rather than relying on
+        // transparent huge pages.
+        [[nodiscard]] bool isHugeTlb() const noexcept;
+
+    private:
+        unsigned char* m_base;
+        std::size_t m_mapped;
+        std::size_t m_used;
+        bool m_hugetlb;
+    };
+}
@@ -3,16 +3,31 @@
 
 #pragma once
 
+#include <array>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string_view>
 #include <ostream>
 #include <filesystem>
 
+#include "bitdiff/arena.hpp"
 #include "bitdiff/reader.hpp"
+#include "bitdiff/interleave.hpp"
+#include "bitdiff/compare.hpp"
+#include "bitdiff/dataout.hpp"
+#include "bitdiff/checkpoint.hpp"
+#include "bitdiff/mask.hpp"
+#include "bitdiff/sink.hpp"
 
 namespace isaki::bitdiff
 {
+    // See index.hpp; it needs diff_count from here.
+    class IndexWriter;
+
+    // See format.hpp.
+    class FormatPipeline;
+
     struct diff_count
     {
         std::uintmax_t bytes;
@@ -28,33 +43,197 @@ namespace isaki::bitdiff
         BitDiff(BitDiff&&) = delete;
         BitDiff& operator=(BitDiff&&) = delete;
 
-        BitDiff(std::string_view a, std::string_view b, std::size_t bufferSize, bool fastMode);
+        BitDiff(std::string_view a, std::string_view b, const read_options& readOptions, bool fastMode);
         ~BitDiff();
 
-        // Returns the number of differences.
-        [[nodiscard]] diff_count process(std::ostream& output, bool printHeader, DataOutType type);
+        // Returns the number of differences. Records cover one word of the
+        // given format each; bytes counts the differing bytes within them.
+        [[nodiscard]] diff_count process(Sink& output, bool printHeader, DataOutType type, const word_format_s& word);
+
+        // Stream convenience wrapper; enables failbit | badbit exceptions on
+        // output for the duration of the call.
+        [[nodiscard]] diff_count process(std::ostream& output, bool printHeader, DataOutType type, const word_format_s& word);
+
+        // Writes a binary patch that turns A into B (see patch.hpp) instead of
+        // text records. Both inputs must be the same size.
+        [[nodiscard]] diff_count writePatch(Sink& output);
+
+        // Writes which blockSize byte blocks differ (see blockmap.hpp), or
+        // their indices as text when list is set. Both inputs must be the
+        // same size. Returns the number of dirty blocks.
+        [[nodiscard]] std::uint64_t writeBlockMap(Sink& output, std::size_t blockSize, bool list);
 
         [[nodiscard]] std::uintmax_t getFileASize() const noexcept;
         [[nodiscard]] std::uintmax_t getFileBSize() const noexcept;
 
+        // Saves progress to checkpoint at its interval during process(). The
+        // checkpoint must outlive process().
+        void setCheckpoint(const Checkpoint* checkpoint) noexcept;
+
+        // Differences covered by mask are ignored by process() and
+        // writeBlockMap(); records still show both inputs as read. Patches
+        // must rebuild B exactly, so writePatch() refuses a mask. The mask
+        // must outlive the call.
+        void setMask(const Mask* mask);
+
+        // Records every difference seen by process(), writePatch() or
+        // writeBlockMap() in index, after the mask is applied. The index
+        // must outlive the call; finishing it is up to the caller.
+        void setIndex(IndexWriter* index) noexcept;
+
+        // In fast mode, formats process() records on this many threads when
+        // more than one (see format.hpp). Without fast mode every record is
+        // flushed as it is found, so formatting stays inline.
+        void setFormatThreads(std::size_t threads) noexcept;
+
+        // Continues the run saved in state. Reads must have been opened at
+        // state.offset (read_options::startOffset) and the output positioned
+        // at state.outputOffset. No header is written.
+        void resume(const checkpoint_s& state);
+
     private:
-        using NewlineFunc = void (*)(std::ostream&);
+        using NewlineFunc = void (*)(Sink&);
 
         void cleanup() noexcept;
 
+        // Reads both inputs in lockstep from m_start, calling
+        // onChunk(base, compareB, len) with the compared length of each fill
+        // and onBoundary(bytesRead) after every full one. compareB is
+        // m_buffer_b, or its masked copy when the mask covers part of the
+        // fill. Throws if the inputs end early or out of step.
+        template<typename F, typename G>
+        void forEachChunk(F&& onChunk, G&& onBoundary);
+
         std::uintmax_t m_fsize_a;
         std::uintmax_t m_fsize_b;
 
         std::filesystem::path m_path_a;
         std::filesystem::path m_path_b;
 
+        std::size_t m_bsize;
+        std::size_t m_blksize;
+
+        // Resume state
+        std::uintmax_t m_start;
+        diff_count m_start_count;
+        DataOutType m_start_type;
+        word_format_s m_start_word;
+        bool m_resumed;
+
+        const Checkpoint* m_checkpoint;
+        const Mask* m_mask;
+        IndexWriter* m_index;
+        std::size_t m_formatThreads;
+
+        // Backs every buffer below; released last.
+        Arena* m_arena;
+
         unsigned char* m_buffer_a;
         unsigned char* m_buffer_b;
 
-        Reader* m_reader_a;
-        Reader* m_reader_b;
+        // Masked copy of m_buffer_b; only mapped once a mask is set.
+        std::unique_ptr<Arena> m_maskArena;
+        unsigned char* m_buffer_mask;
+
+        // Owned unless m_interleaved is set, in which case they are its ports.
+        ChunkSource* m_reader_a;
+        ChunkSource* m_reader_b;
+
+        InterleavedReader* m_interleaved;
 
         NewlineFunc m_newline;
+        bool m_fast;
+        bool m_adaptive;
         bool m_valid;
     };
+
+    // Diffs a sequence of file pairs on one pair of reader threads, one set
+    // of buffers and one set of record formatters. A BitDiff starts its
+    // readers and maps its buffers for a single pair, which dominates when
+    // the files are small; a session pays for that once, and its adaptive
+    // read size is measured across all pairs. Pairs are compared by the
+    // same chunk loop as BitDiff, with a mask and format threads, but
+    // without an index: offsets restart with every pair.
+    class DiffSession final
+    {
+    public:
+        DiffSession() = delete;
+        DiffSession(const DiffSession&) = delete;
+        DiffSession& operator=(const DiffSession&) = delete;
+        DiffSession(DiffSession&&) = delete;
+        DiffSession& operator=(DiffSession&&) = delete;
+
+        ~DiffSession();
+
+        // Reads with readOptions, which must not ask for extents or a start
+        // offset; those are set per run, not per pair.
+        DiffSession(const read_options& readOptions, bool fastMode);
+
+        // Diffs a against b, writing the records BitDiff::process would,
+        // each preceded by prefix. Inputs of different sizes are compared
+        // up to the smaller. Output is only flushed per record without fast
+        // mode; flushing at the end is up to the caller. The session stays
+        // usable after a pair fails.
+        [[nodiscard]] diff_count diff(std::string_view a, std::string_view b, Sink& output, std::string_view prefix,
+            DataOutType type, const word_format_s& word);
+
+        // Pairs diffed to the end so far.
+        [[nodiscard]] std::uintmax_t getPairCount() const noexcept;
+
+        // As BitDiff::setMask, applied to every pair at its own offsets.
+        void setMask(const Mask* mask);
+
+        // As BitDiff::setFormatThreads. The threads are kept across pairs;
+        // each pair's records are written before diff() returns.
+        void setFormatThreads(std::size_t threads) noexcept;
+
+    private:
+        using NewlineFunc = void (*)(Sink&);
+
+        static constexpr std::size_t FORMATTERS = 3 * 4;
+
+        [[nodiscard]] DataOut& getOut(DataOutType type, std::size_t wordSize);
+
+        // The pipeline for output, type and wordSize, or nullptr when
+        // records are formatted inline.
+        [[nodiscard]] FormatPipeline* getPipeline(Sink& output, DataOutType type, std::size_t wordSize);
+
+        std::size_t m_bsize;
+
+        // Fill size before block alignment, and fills read in total; the
+        // size is measured once, over the first fills of the session.
+        std::size_t m_fillSize;
+        std::size_t m_fills;
+
+        std::uintmax_t m_pairs;
+
+        const Mask* m_mask;
+        std::size_t m_formatThreads;
+
+        // Backs every buffer below; declared first so it is released last.
+        Arena m_arena;
+
+        unsigned char* m_buffer_a;
+        unsigned char* m_buffer_b;
+
+        // Masked copy of m_buffer_b; only mapped once a mask is set.
+        std::unique_ptr<Arena> m_maskArena;
+        unsigned char* m_buffer_mask;
+
+        std::unique_ptr<Reader> m_reader_a;
+        std::unique_ptr<Reader> m_reader_b;
+
+        // One formatter per output mode and word size, made on first use.
+        std::array<std::unique_ptr<DataOut>, FORMATTERS> m_outs;
+
+        // Made on first use and again when what it formats for changes.
+        std::unique_ptr<FormatPipeline> m_pipeline;
+        const Sink* m_pipelineOutput;
+        DataOutType m_pipelineType;
+        std::size_t m_pipelineWord;
+
+        NewlineFunc m_newline;
+        bool m_fast;
+        bool m_adaptive;
+    };
 }
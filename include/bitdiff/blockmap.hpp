@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "bitdiff/sink.hpp"
+
+namespace isaki::bitdiff
+{
+    // Block bitmap layout; every integer is little endian.
+    //
+    //   header  : "BITBLOCK", u32 version, u32 reserved, u64 size,
+    //             u64 block size, u64 blocks
+    //   bitmap  : (blocks + 7) / 8 bytes; block i is bit i % 8 (least
+    //             significant first) of byte i / 8, set when it differs
+    //   trailer : u64 dirty blocks
+    //
+    // The last block is short when size is not a multiple of block size.
+    class BlockMapWriter final
+    {
+    public:
+        BlockMapWriter() = delete;
+        BlockMapWriter(const BlockMapWriter&) = delete;
+        BlockMapWriter& operator=(const BlockMapWriter&) = delete;
+        BlockMapWriter(BlockMapWriter&&) = delete;
+        BlockMapWriter& operator=(BlockMapWriter&&) = delete;
+
+        ~BlockMapWriter();
+
+        // Both inputs must be size bytes long. With list set, dirty block
+        // indices are written as decimal text, one per line, instead of the
+        // bitmap.
+        BlockMapWriter(Sink& output, std::uintmax_t size, std::size_t blockSize, bool list);
+
+        // Feeds the next len bytes of each input, which start at base. A
+        // block only needs its first difference, so the rest of a dirty
+        // block is skipped.
+        void update(std::uintmax_t base, const unsigned char* a, const unsigned char* b, std::size_t len);
+
+        // Writes the remaining bitmap and the trailer; returns the dirty
+        // block count.
+        [[nodiscard]] std::uint64_t finish();
+
+    private:
+        // Returns blockSize; throws std::runtime_error when it is zero. Runs
+        // in the initializer, before the block count divides by it.
+        [[nodiscard]] static std::uint64_t validateBlockSize(std::size_t blockSize);
+
+        void close(bool dirty);
+
+        Sink& m_output;
+
+        const std::uint64_t m_blockSize;
+        const std::uint64_t m_blocks;
+        const bool m_list;
+
+        // Block being fed, and whether it has differed yet.
+        std::uint64_t m_block;
+        bool m_dirty;
+
+        // Bitmap byte being filled.
+        unsigned char m_bits;
+
+        std::uint64_t m_count;
+    };
+}
@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include "bitdiff/compare.hpp"
+#include "bitdiff/dataout.hpp"
+
+namespace isaki::bitdiff
+{
+    // One input as a run found it. A file rewritten in place keeps its path
+    // and inode but not its mtime; one replaced by rename gets a new inode.
+    struct input_identity_s
+    {
+        // Absolute.
+        std::string path;
+
+        std::uintmax_t size;
+        std::uintmax_t device;
+        std::uintmax_t inode;
+
+        // Nanoseconds since the epoch.
+        std::uintmax_t mtime;
+
+        bool operator==(const input_identity_s&) const = default;
+    };
+
+    struct checkpoint_s
+    {
+        // Identity of the run; a resume must match these.
+        input_identity_s inputA;
+        input_identity_s inputB;
+        DataOutType type;
+        word_format_s word;
+
+        // Mask::getDigest(), or that of no mask.
+        std::uint64_t maskDigest;
+
+        // Progress. Every byte before offset has been compared and its
+        // records are in the first outputOffset bytes of the output.
+        std::uintmax_t offset;
+        std::uintmax_t diffBytes;
+        std::uintmax_t diffBits;
+        std::uintmax_t outputOffset;
+    };
+
+    // Stats file for a checkpoint. Throws std::system_error.
+    [[nodiscard]] input_identity_s identify_input(const std::filesystem::path& file);
+
+    // A small text file holding one checkpoint_s. Saves replace the file
+    // atomically, so a crash leaves either the previous or the new state.
+    class Checkpoint final
+    {
+    public:
+        Checkpoint() = delete;
+        Checkpoint(const Checkpoint&) = delete;
+        Checkpoint& operator=(const Checkpoint&) = delete;
+        Checkpoint(Checkpoint&&) = delete;
+        Checkpoint& operator=(Checkpoint&&) = delete;
+
+        ~Checkpoint();
+
+        Checkpoint(const std::filesystem::path& file, std::chrono::seconds interval);
+
+        // Throws std::runtime_error when the file is missing or malformed.
+        [[nodiscard]] checkpoint_s load() const;
+
+        void save(const checkpoint_s& state) const;
+
+        // Called once a run completes; a finished diff has nothing to resume.
+        void remove() const;
+
+        [[nodiscard]] std::chrono::seconds getInterval() const noexcept;
+
+    private:
+        std::filesystem::path m_file;
+        std::filesystem::path m_temp;
+        std::chrono::seconds m_interval;
+    };
+}
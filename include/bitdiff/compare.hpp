@@ -0,0 +1,157 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <concepts>
+
+#include "bitdiff/kernel.hpp"
+
+namespace isaki::bitdiff
+{
+    // Largest supported word; fills are kept a multiple of this so words
+    // never straddle two chunks.
+    constexpr std::size_t MAX_WORD_LENGTH = 8;
+
+    enum class Endian
+    {
+        Little,
+        Big
+    };
+
+    struct word_format_s
+    {
+        // 1, 2, 4 or 8 bytes.
+        std::size_t size;
+        Endian endian;
+    };
+
+    constexpr word_format_s BYTE_FORMAT = { .size = 1, .endian = Endian::Little };
+
+    namespace internal
+    {
+        template<std::size_t W> struct word_type;
+        template<> struct word_type<2> { using type = std::uint16_t; };
+        template<> struct word_type<4> { using type = std::uint32_t; };
+        template<> struct word_type<8> { using type = std::uint64_t; };
+
+        // Decodes len <= width bytes as a width byte word. A short word is
+        // zero padded at its end, so its bytes keep their full width value.
+        inline std::uint64_t decode_word(const unsigned char* p, const std::size_t len, const std::size_t width, const Endian endian) noexcept
+        {
+            std::uint64_t ret = 0;
+            for (std::size_t k = 0; k < len; ++k)
+            {
+                const std::size_t shift = (endian == Endian::Little) ? k : (width - 1 - k);
+                ret |= static_cast<std::uint64_t>(p[k]) << (8 * shift);
+            }
+
+            return ret;
+        }
+
+        template<std::size_t W, typename F>
+        void word_kernel(const Endian endian, const unsigned char* a, const unsigned char* b, const std::size_t len, F& f)
+        {
+            using word_t = typename word_type<W>::type;
+
+            const std::size_t whole = len - (len % W);
+
+            // Equality does not depend on byte order; only decode on a miss.
+            for (std::size_t i = 0; i < whole;)
+            {
+                word_t wa;
+                word_t wb;
+                std::memcpy(&wa, a + i, W);
+                std::memcpy(&wb, b + i, W);
+
+                if (wa == wb)
+                {
+                    // Skip equal runs with the vector kernel.
+                    const std::size_t hit = i + find_difference(a + i, b + i, whole - i);
+                    i = hit - (hit % W);
+                    continue;
+                }
+
+                f(i, decode_word(a + i, W, W, endian), decode_word(b + i, W, W, endian));
+                i += W;
+            }
+
+            if (whole != len && std::memcmp(a + whole, b + whole, len - whole) != 0)
+            {
+                f(whole, decode_word(a + whole, len - whole, W, endian), decode_word(b + whole, len - whole, W, endian));
+            }
+        }
+    }
+
+    // Calls f(i) for every i in [0, len) where a[i] != b[i], in order. This
+    // is the compare kernel shared by every diff mode.
+    template<typename F>
+    requires std::invocable<F&, std::size_t>
+    void for_each_difference(const unsigned char* a, const unsigned char* b, const std::size_t len, F&& f)
+    {
+        std::size_t i = find_difference(a, b, len);
+        while (i < len)
+        {
+            f(i);
+
+            // Dense runs stay inline; equal runs go back to the kernel.
+            if (++i < len && a[i] == b[i])
+            {
+                i += find_difference(a + i, b + i, len - i);
+            }
+        }
+    }
+
+    // Word granular form of for_each_difference: calls f(i, wordA, wordB)
+    // for every differing word, where i is the byte offset of the word. A
+    // trailing partial word is compared as one short word.
+    template<typename F>
+    requires std::invocable<F&, std::size_t, std::uint64_t, std::uint64_t>
+    void for_each_word_difference(const word_format_s& format, const unsigned char* a, const unsigned char* b, const std::size_t len, F&& f)
+    {
+        switch (format.size)
+        {
+            case 2:
+                internal::word_kernel<2>(format.endian, a, b, len, f);
+                break;
+
+            case 4:
+                internal::word_kernel<4>(format.endian, a, b, len, f);
+                break;
+
+            case 8:
+                internal::word_kernel<8>(format.endian, a, b, len, f);
+                break;
+
+            default:
+                for_each_difference(a, b, len, [&f, a, b](const std::size_t i)
+                {
+                    f(i, a[i], b[i]);
+                });
+                break;
+        }
+    }
+
+    // Decodes the word of format starting at p, of which len bytes remain.
+    // A trailing partial word reads the way for_each_word_difference
+    // passes it.
+    inline std::uint64_t read_word(const word_format_s& format, const unsigned char* p, const std::size_t len) noexcept
+    {
+        return internal::decode_word(p, (len < format.size) ? len : format.size, format.size, format.endian);
+    }
+
+    // Number of non-zero bytes in x; the byte count of a word difference.
+    // The multiply sums the per-byte flags into the top byte, so this needs
+    // no popcount.
+    constexpr int nonzero_bytes(std::uint64_t x) noexcept
+    {
+        x |= x >> 4;
+        x |= x >> 2;
+        x |= x >> 1;
+        return static_cast<int>(((x & 0x0101010101010101ULL) * 0x0101010101010101ULL) >> 56);
+    }
+}
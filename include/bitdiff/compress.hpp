@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "bitdiff/pool.hpp"
+#include "bitdiff/sink.hpp"
+
+namespace isaki::bitdiff
+{
+    enum class Codec
+    {
+        Gzip,
+        Zstd
+    };
+
+    // False for codecs this build was made without.
+    [[nodiscard]] bool codec_available(Codec codec) noexcept;
+
+    // Compresses everything written to it into output. Data is cut into
+    // large blocks that are compressed on a worker pool and written in
+    // order, each as a complete gzip member or zstd frame; both formats
+    // allow concatenation, so standard tools read the result as one stream.
+    //
+    // Flushes do not cut a block (a line at a time would ruin the ratio);
+    // persist() and close() do.
+    class CompressSink final : public Sink
+    {
+    public:
+        CompressSink() = delete;
+        CompressSink(const CompressSink&) = delete;
+        CompressSink& operator=(const CompressSink&) = delete;
+        CompressSink(CompressSink&&) = delete;
+        CompressSink& operator=(CompressSink&&) = delete;
+
+        // Drops anything not yet written; call close() to finish the stream.
+        ~CompressSink() override;
+
+        // Output must outlive this sink. A thread count of 0 uses the
+        // hardware concurrency.
+        CompressSink(Sink& output, Codec codec, std::size_t threads);
+
+        // Compresses and writes everything still buffered, then flushes
+        // output. Writes nothing if nothing was ever written to this sink.
+        void close();
+
+    protected:
+        void commit(const char* staged, std::size_t stagedLen, const char* data, std::size_t len) override;
+
+        void syncData() override;
+
+    private:
+        struct block_s
+        {
+            std::string in;
+            std::string out;
+            std::exception_ptr error;
+            bool done;
+        };
+
+        void submit();
+
+        // Writes finished blocks in order. With all set, waits for every
+        // block; otherwise only while too many are in flight.
+        void drain(bool all);
+
+        Sink& m_output;
+        const Codec m_codec;
+
+        std::unique_ptr<char[]> m_buffer;
+        std::string m_pending;
+
+        std::mutex m_mtx;
+        std::condition_variable m_done;
+        std::deque<std::unique_ptr<block_s>> m_blocks;
+        std::size_t m_window;
+
+        // Declared last so its workers stop before the blocks go away.
+        WorkPool m_pool;
+    };
+}
@@ -0,0 +1,137 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "bitdiff/arena.hpp"
+#include "bitdiff/bitdiff.hpp"
+#include "bitdiff/compare.hpp"
+#include "bitdiff/dataout.hpp"
+#include "bitdiff/fd.hpp"
+#include "bitdiff/pool.hpp"
+#include "bitdiff/sink.hpp"
+
+namespace isaki::bitdiff
+{
+    // bitdiffd wire protocol; one request per connection, all text.
+    //
+    //   request : "diff" TAB mode TAB word TAB endian TAB pathA TAB pathB LF
+    //             mode is a, b or x; word is 1, 2, 4 or 8; endian is le or
+    //             be; paths are absolute
+    //   reply   : the records bitdiff would print, then
+    //             "#end" TAB bytes TAB bits LF, or "#error" TAB message LF
+    //
+    // Records never start with '#', so the last line is always the status.
+
+    // Serves diffs on a Unix domain socket. File A of each request is the
+    // baseline: it stays mapped between requests, up to a byte budget, and
+    // is only mapped again when its size, inode or mtime changes. File B is
+    // read once. Requests run on a shared pool with per-worker buffers, in
+    // the order they were accepted; a client that stops reading or sending
+    // times out instead of holding a worker.
+    class DiffDaemon final
+    {
+    public:
+        DiffDaemon() = delete;
+        DiffDaemon(const DiffDaemon&) = delete;
+        DiffDaemon& operator=(const DiffDaemon&) = delete;
+        DiffDaemon(DiffDaemon&&) = delete;
+        DiffDaemon& operator=(DiffDaemon&&) = delete;
+
+        // Removes the socket file.
+        ~DiffDaemon();
+
+        // Binds socket, replacing a stale socket file. A thread count of 0
+        // uses the hardware concurrency.
+        DiffDaemon(const std::filesystem::path& socket, std::size_t threads, std::uintmax_t cacheBytes);
+
+        // Accepts requests until stopFd becomes readable, then waits for the
+        // requests already accepted.
+        void serve(int stopFd);
+
+        [[nodiscard]] std::uintmax_t getServedCount() const noexcept;
+
+    private:
+        // A mapped baseline; unmapped when the last request using it ends.
+        // The descriptor is kept to notice truncation before it faults.
+        struct baseline_s
+        {
+            FileDescriptor fd;
+            const unsigned char* data;
+            std::size_t length;
+
+            dev_t dev;
+            ino_t ino;
+            timespec mtime;
+
+            baseline_s() = default;
+            baseline_s(const baseline_s&) = delete;
+            baseline_s& operator=(const baseline_s&) = delete;
+            ~baseline_s();
+
+            // Throws std::runtime_error when the file is now shorter than
+            // the mapping.
+            void checkLength() const;
+        };
+
+        struct worker_s
+        {
+            Arena arena;
+            unsigned char* buffer;
+
+            // One formatter per output mode and word size, made on first use.
+            std::array<std::unique_ptr<DataOut>, 12> outs;
+
+            worker_s();
+
+            [[nodiscard]] DataOut& getOut(DataOutType type, std::size_t wordSize);
+        };
+
+        // The cached mapping of file, mapped again if the file changed.
+        [[nodiscard]] std::shared_ptr<const baseline_s> acquire(const std::filesystem::path& file);
+
+        void handle(int fd, std::size_t worker);
+
+        [[nodiscard]] diff_count diff(Sink& output, const baseline_s& a, const std::filesystem::path& b,
+            DataOutType type, const word_format_s& word, worker_s& scratch);
+
+        std::filesystem::path m_socket;
+        FileDescriptor m_listen;
+
+        // Most recently used first; m_index points into it.
+        std::mutex m_cacheMtx;
+        std::list<std::pair<std::string, std::shared_ptr<const baseline_s>>> m_cache;
+        std::unordered_map<std::string, decltype(m_cache)::iterator> m_index;
+        std::uintmax_t m_cacheBytes;
+        std::uintmax_t m_cacheLimit;
+
+        std::atomic<std::uintmax_t> m_served;
+        std::atomic<std::size_t> m_active;
+
+        std::vector<std::unique_ptr<worker_s>> m_workers;
+
+        // Declared last so its workers stop before the cache goes away.
+        WorkPool m_pool;
+    };
+
+    // Sends one request to the daemon on socket and copies the records to
+    // output. Throws std::runtime_error with the daemon's message when the
+    // request fails.
+    [[nodiscard]] diff_count daemon_request(const std::filesystem::path& socket, const std::filesystem::path& a,
+        const std::filesystem::path& b, DataOutType type, const word_format_s& word, Sink& output);
+}
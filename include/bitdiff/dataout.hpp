@@ -7,16 +7,20 @@
 #include <cstddef>
 #include <cstdint>
 #include <climits>
+#include <memory>
 
 #include <concepts>
 #include <type_traits>
 
+#include "bitdiff/arena.hpp"
+#include "bitdiff/sink.hpp"
+
 namespace isaki::bitdiff
 {
     namespace internal
     {
         template <typename F>
-        concept BuildFunction = requires(F f, char* ptr, std::size_t size, unsigned char value)
+        concept BuildFunction = requires(F f, char* ptr, std::size_t size, std::uint64_t value)
         {
             { f(ptr, size, value) } noexcept -> std::same_as<void>;
         };
@@ -42,16 +46,18 @@ namespace isaki::bitdiff
 
         [[nodiscard]] virtual int getDiffPopCount() const;
 
-        virtual void init(std::uintmax_t address, unsigned char dataA, unsigned char dataB) noexcept;
+        // Values hold one word; only the low word size bytes are used.
+        virtual void init(std::uintmax_t address, std::uint64_t dataA, std::uint64_t dataB) noexcept;
 
-        virtual void print(std::ostream& os) const = 0;
+        virtual void print(Sink& os) const = 0;
 
     protected:
-        DataOut(std::string_view prefix, std::size_t tokenSize, char delim);
+        // Scratch space comes from arena, which must outlive this object.
+        DataOut(std::string_view prefix, std::size_t tokenSize, char delim, Arena& arena);
 
         template<typename F>
         requires internal::BuildFunction<F>
-        void printBuffer(std::ostream& os, F&& f) const
+        void printBuffer(Sink& os, F&& f) const
         {
             // Fill the buffer correctly.
             f(m_posA, m_tokenSize, m_a);
@@ -68,17 +74,17 @@ namespace isaki::bitdiff
         const std::size_t m_recordSize;
 
         // Scratch buffers
-        // This is temporary storage. The memory these pointers reference
-        // may be modified even in const methods because it is not part of
-        // the object's logical state.
+        // This is temporary storage owned by the arena. The memory these
+        // pointers reference may be modified even in const methods because it
+        // is not part of the object's logical state.
         char* m_buffer;
         char* m_posAddr;
         char* m_posA;
         char* m_posB;
 
         // Variant state
-        unsigned char m_a;
-        unsigned char m_b;
+        std::uint64_t m_a;
+        std::uint64_t m_b;
     };
 
     class HexDataOut final : public DataOut
@@ -92,9 +98,9 @@ namespace isaki::bitdiff
 
         ~HexDataOut() override;
 
-        explicit HexDataOut(char delim);
+        HexDataOut(char delim, std::size_t wordSize, Arena& arena);
 
-        void print(std::ostream& os) const override;
+        void print(Sink& os) const override;
 
     private:
         using super = DataOut;
@@ -111,9 +117,9 @@ namespace isaki::bitdiff
 
         ~BinaryDataOut() override;
 
-        explicit BinaryDataOut(char delim);
+        BinaryDataOut(char delim, std::size_t wordSize, Arena& arena);
 
-        void print(std::ostream& os) const  override;
+        void print(Sink& os) const  override;
 
     private:
         using super = DataOut;
@@ -130,17 +136,22 @@ namespace isaki::bitdiff
 
         ~BitDataOut() override;
 
-        BitDataOut(char delim);
+        BitDataOut(char delim, std::size_t wordSize, Arena& arena);
 
         [[nodiscard]] int getDiffPopCount() const override;
 
-        void init(std::uintmax_t address, unsigned char dataA, unsigned char dataB) noexcept override;
+        void init(std::uintmax_t address, std::uint64_t dataA, std::uint64_t dataB) noexcept override;
 
-        void print(std::ostream& os) const  override;
+        void print(Sink& os) const  override;
 
     private:
-        unsigned char m_xor;
+        std::uint64_t m_xor;
 
         using super = DataOut;
     };
+
+    // Creates the formatter for type, with tokens wide enough for one word of
+    // wordSize bytes. Scratch space comes from arena, which must outlive the
+    // result.
+    [[nodiscard]] std::unique_ptr<DataOut> make_data_out(DataOutType type, char delim, std::size_t wordSize, Arena& arena);
 }
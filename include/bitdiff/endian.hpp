@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <cstdint>
+
+namespace isaki::bitdiff
+{
+    // Little endian integers for the on-disk formats (patches, block maps
+    // and indexes) and the content hash, independent of the host byte
+    // order. The compiler folds each loop into a single access on little
+    // endian targets.
+
+    inline void store_le32(unsigned char* p, const std::uint32_t value) noexcept
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            p[i] = static_cast<unsigned char>(value >> (8 * i));
+        }
+    }
+
+    inline void store_le64(unsigned char* p, const std::uint64_t value) noexcept
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            p[i] = static_cast<unsigned char>(value >> (8 * i));
+        }
+    }
+
+    [[nodiscard]] inline std::uint32_t load_le32(const unsigned char* p) noexcept
+    {
+        std::uint32_t ret = 0;
+        for (int i = 3; i >= 0; --i)
+        {
+            ret = (ret << 8) | p[i];
+        }
+
+        return ret;
+    }
+
+    [[nodiscard]] inline std::uint64_t load_le64(const unsigned char* p) noexcept
+    {
+        std::uint64_t ret = 0;
+        for (int i = 7; i >= 0; --i)
+        {
+            ret = (ret << 8) | p[i];
+        }
+
+        return ret;
+    }
+}
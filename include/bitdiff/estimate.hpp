@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+#include "bitdiff/bitdiff.hpp"
+#include "bitdiff/mask.hpp"
+
+namespace isaki::bitdiff
+{
+    struct estimate_s
+    {
+        // Bytes both inputs share; the population being estimated.
+        std::uintmax_t size;
+
+        std::size_t blocks;
+        std::uintmax_t sampledBytes;
+        diff_count sampled;
+
+        // Fractions of differing bytes and bits, each with the half width of
+        // its 95% confidence interval.
+        double byteFraction;
+        double byteMargin;
+        double bitFraction;
+        double bitMargin;
+
+        // Fractions scaled up to the whole of size.
+        diff_count projected;
+    };
+
+    // Estimates how much a and b differ by comparing one randomly placed
+    // block from each of budget / block length equal strata, read with
+    // pread. Reads everything when budget covers the inputs. Differences
+    // covered by mask (may be null) are ignored.
+    [[nodiscard]] estimate_s estimate_difference(
+        const std::filesystem::path& a,
+        const std::filesystem::path& b,
+        std::uintmax_t budget,
+        const Mask* mask);
+}
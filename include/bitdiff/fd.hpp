@@ -0,0 +1,80 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <cerrno>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace isaki::bitdiff
+{
+    // Owns a file descriptor and closes it when it goes out of scope. Takes
+    // whatever the system call returned, so callers check get() for failure
+    // as usual; a negative descriptor is never closed. A moved-from holder
+    // owns nothing.
+    class FileDescriptor final
+    {
+    public:
+        FileDescriptor(const FileDescriptor&) = delete;
+        FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+        FileDescriptor() noexcept :
+            m_fd(-1) {}
+
+        explicit FileDescriptor(const int fd) noexcept :
+            m_fd(fd) {}
+
+        FileDescriptor(FileDescriptor&& o) noexcept :
+            m_fd(std::exchange(o.m_fd, -1)) {}
+
+        FileDescriptor& operator=(FileDescriptor&& o) noexcept
+        {
+            if (this != &o)
+            {
+                close();
+                m_fd = std::exchange(o.m_fd, -1);
+            }
+
+            return *this;
+        }
+
+        ~FileDescriptor()
+        {
+            close();
+        }
+
+        [[nodiscard]] int get() const noexcept
+        {
+            return m_fd;
+        }
+
+        // Closes now and returns what ::close did, for writers that must
+        // report a failed close; 0 when nothing was owned.
+        int close() noexcept
+        {
+            const int fd = std::exchange(m_fd, -1);
+            return (fd >= 0) ? ::close(fd) : 0;
+        }
+
+    private:
+        int m_fd;
+    };
+
+    // Opens file read only. Throws std::system_error naming the file.
+    [[nodiscard]] inline FileDescriptor open_read(const std::filesystem::path& file)
+    {
+        FileDescriptor ret(::open(file.c_str(), O_RDONLY | O_CLOEXEC));
+        if (ret.get() < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "Unable to open " + file.string());
+        }
+
+        return ret;
+    }
+}
@@ -0,0 +1,116 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bitdiff/arena.hpp"
+#include "bitdiff/dataout.hpp"
+#include "bitdiff/pool.hpp"
+#include "bitdiff/sink.hpp"
+
+namespace isaki::bitdiff
+{
+    // Moves DataOut formatting off the compare thread. Records are collected
+    // as (offset, a, b) tuples in fixed size batches; a pool renders each
+    // batch into text and the blocks are written in order, so the output is
+    // the same as formatting inline. Worth it when nearly every byte differs
+    // and formatting, not comparing, bounds the run.
+    class FormatPipeline final
+    {
+    public:
+        FormatPipeline() = delete;
+        FormatPipeline(const FormatPipeline&) = delete;
+        FormatPipeline& operator=(const FormatPipeline&) = delete;
+        FormatPipeline(FormatPipeline&&) = delete;
+        FormatPipeline& operator=(FormatPipeline&&) = delete;
+
+        // Drops records not yet written; call drain() to write them.
+        ~FormatPipeline();
+
+        // Output must outlive the pipeline.
+        FormatPipeline(Sink& output, DataOutType type, std::size_t wordSize, std::size_t threads);
+
+        void add(const std::uintmax_t offset, const std::uint64_t a, const std::uint64_t b)
+        {
+            if (m_fill == BATCH_RECORDS) [[unlikely]]
+            {
+                submit();
+            }
+
+            m_batch->records[m_fill++] = { .offset = offset, .a = a, .b = b };
+        }
+
+        // Starts every record added from now on with prefix.
+        void setPrefix(std::string_view prefix);
+
+        // Writes every record added so far to the output.
+        void drain();
+
+    private:
+        static constexpr std::size_t BATCH_RECORDS = 64 * 1024;
+
+        struct record_s
+        {
+            std::uintmax_t offset;
+            std::uint64_t a;
+            std::uint64_t b;
+        };
+
+        struct batch_s
+        {
+            std::unique_ptr<record_s[]> records;
+            std::size_t count;
+            std::string prefix;
+            std::string text;
+            std::exception_ptr error;
+            bool done;
+        };
+
+        struct worker_s
+        {
+            Arena arena;
+            std::unique_ptr<DataOut> out;
+            BufferSink sink;
+
+            worker_s(DataOutType type, std::size_t wordSize);
+        };
+
+        void submit();
+
+        void newBatch();
+
+        // Writes finished batches in order. With all set, waits for every
+        // batch; otherwise only while too many are in flight.
+        void write(bool all);
+
+        Sink& m_output;
+
+        std::unique_ptr<batch_s> m_batch;
+        std::size_t m_fill;
+        std::string m_prefix;
+
+        std::vector<std::unique_ptr<worker_s>> m_workers;
+
+        std::mutex m_mtx;
+        std::condition_variable m_done;
+        std::deque<std::unique_ptr<batch_s>> m_pending;
+        std::size_t m_window;
+
+        // Record arrays of formatted batches, reused by newBatch().
+        std::vector<std::unique_ptr<record_s[]>> m_spare;
+
+        // Declared last so its workers stop before the batches go away.
+        WorkPool m_pool;
+    };
+}
@@ -0,0 +1,39 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace isaki::bitdiff
+{
+    // Streaming XXH64 with a zero seed. Fast enough to run over both inputs
+    // alongside the compare without becoming the bottleneck; not a
+    // cryptographic hash.
+    class Hash64 final
+    {
+    public:
+        Hash64(const Hash64&) = delete;
+        Hash64& operator=(const Hash64&) = delete;
+        Hash64(Hash64&&) = delete;
+        Hash64& operator=(Hash64&&) = delete;
+
+        Hash64() noexcept;
+        ~Hash64();
+
+        void update(const unsigned char* data, std::size_t len) noexcept;
+
+        // Digest of everything passed to update() so far.
+        [[nodiscard]] std::uint64_t digest() const noexcept;
+
+    private:
+        static constexpr std::size_t STRIPE_LENGTH = 32;
+
+        std::uint64_t m_acc[4];
+        std::uint64_t m_total;
+
+        unsigned char m_tail[STRIPE_LENGTH];
+        std::size_t m_tailLen;
+    };
+}
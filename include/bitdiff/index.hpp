@@ -0,0 +1,153 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "bitdiff/bitdiff.hpp"
+#include "bitdiff/sink.hpp"
+
+namespace isaki::bitdiff
+{
+    // Diff index layout; every integer is little endian.
+    //
+    //   header    : "BITINDEX", u32 version, u32 reserved
+    //   blocks    : zlib streams of up to INDEX_BLOCK_RECORDS records, each
+    //               a LEB128 offset delta from the previous record (the
+    //               first is relative to the block's first offset), the
+    //               byte from A and the byte from B
+    //   directory : one entry per block (see index_entry_s), in offset order
+    //   trailer   : u64 directory position, u64 blocks, u64 bytes,
+    //               u64 bits, "BITINDEX"
+    //
+    // Entries carry the counts of every block before them, so a count over
+    // any range needs a binary search and at most two block decodes.
+    inline constexpr std::size_t INDEX_BLOCK_RECORDS = 4096;
+
+    struct index_entry_s
+    {
+        std::uint64_t first;
+        std::uint64_t last;
+        std::uint64_t position;
+        std::uint32_t length;
+        std::uint32_t records;
+
+        // Totals over all earlier blocks.
+        std::uint64_t bytesBefore;
+        std::uint64_t bitsBefore;
+    };
+
+    struct index_record_s
+    {
+        std::uint64_t offset;
+        unsigned char a;
+        unsigned char b;
+    };
+
+    // Records every differing byte fed to it into an index file.
+    class IndexWriter final
+    {
+    public:
+        IndexWriter() = delete;
+        IndexWriter(const IndexWriter&) = delete;
+        IndexWriter& operator=(const IndexWriter&) = delete;
+        IndexWriter(IndexWriter&&) = delete;
+        IndexWriter& operator=(IndexWriter&&) = delete;
+
+        ~IndexWriter();
+
+        // Creates or truncates file and writes the header.
+        explicit IndexWriter(const std::filesystem::path& file);
+
+        // Feeds the next len bytes of each input, which start at base.
+        void update(std::uintmax_t base, const unsigned char* a, const unsigned char* b, std::size_t len);
+
+        // Writes the last block, the directory and the trailer, and closes
+        // the file.
+        void finish();
+
+    private:
+        void emit();
+
+        FdSink m_output;
+
+        // Block being collected.
+        std::vector<index_record_s> m_records;
+        std::string m_raw;
+        std::string m_packed;
+
+        std::vector<index_entry_s> m_entries;
+        diff_count m_total;
+    };
+
+    // Read only view of an index file through a private mapping.
+    class IndexReader final
+    {
+    public:
+        IndexReader() = delete;
+        IndexReader(const IndexReader&) = delete;
+        IndexReader& operator=(const IndexReader&) = delete;
+        IndexReader(IndexReader&&) = delete;
+        IndexReader& operator=(IndexReader&&) = delete;
+
+        ~IndexReader();
+
+        // Throws std::runtime_error if the header, directory or trailer is
+        // malformed.
+        explicit IndexReader(const std::filesystem::path& file);
+
+        [[nodiscard]] std::size_t getBlockCount() const noexcept;
+        [[nodiscard]] diff_count getTotal() const noexcept;
+
+        // Differences at offsets in [begin, end).
+        [[nodiscard]] diff_count count(std::uint64_t begin, std::uint64_t end) const;
+
+        // Calls f(record) for each difference at offsets in [begin, end), in
+        // offset order.
+        template<typename F>
+        void forEach(const std::uint64_t begin, const std::uint64_t end, F&& f) const
+        {
+            std::vector<index_record_s> records;
+            for (std::size_t i = findBlock(begin); i < m_blocks && getEntry(i).first < end; ++i)
+            {
+                decode(i, records);
+                for (const index_record_s& r : records)
+                {
+                    if (r.offset >= begin && r.offset < end)
+                    {
+                        f(r);
+                    }
+                }
+            }
+        }
+
+    private:
+        [[nodiscard]] index_entry_s getEntry(std::size_t block) const noexcept;
+
+        // First block whose last offset is at or past offset.
+        [[nodiscard]] std::size_t findBlock(std::uint64_t offset) const noexcept;
+
+        // Prefix counts; block may be one past the last.
+        [[nodiscard]] std::uint64_t bytesBefore(std::size_t block) const noexcept;
+        [[nodiscard]] std::uint64_t bitsBefore(std::size_t block) const noexcept;
+
+        void decode(std::size_t block, std::vector<index_record_s>& records) const;
+
+        // Differences in block at offsets in [begin, end).
+        [[nodiscard]] diff_count countBlock(std::size_t block, std::uint64_t begin, std::uint64_t end) const;
+
+        void cleanup() noexcept;
+
+        const unsigned char* m_map;
+        std::size_t m_length;
+
+        const unsigned char* m_directory;
+        std::size_t m_blocks;
+        diff_count m_total;
+    };
+}
@@ -0,0 +1,126 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <mutex>
+#include <filesystem>
+#include <cstddef>
+#include <cstdint>
+#include <condition_variable>
+#include <thread>
+#include <stop_token>
+#include <exception>
+
+#include "bitdiff/arena.hpp"
+#include "bitdiff/fd.hpp"
+#include "bitdiff/reader.hpp"
+
+namespace isaki::bitdiff
+{
+    // True when both files live on the same physical disk (partitions are
+    // folded into their parent) and the kernel reports it as rotational.
+    [[nodiscard]] bool share_rotational_device(
+        const std::filesystem::path& a,
+        const std::filesystem::path& b) noexcept;
+
+    // Reads two inputs from a single thread, alternating whole extents so a
+    // spinning disk seeks once per extent rather than once per chunk. Each
+    // input gets a ring of two extents so the consumer can work through one
+    // extent of each while the next is read; all four extents stay mapped
+    // for the whole run.
+    class InterleavedReader final
+    {
+    public:
+        InterleavedReader() = delete;
+        InterleavedReader(const InterleavedReader&) = delete;
+        InterleavedReader& operator=(const InterleavedReader&) = delete;
+        InterleavedReader(InterleavedReader&&) = delete;
+        InterleavedReader& operator=(InterleavedReader&&) = delete;
+
+        ~InterleavedReader();
+
+        // The ring buffers come from arena, which must outlive this object.
+        // extentSize is rounded up to a whole number of chunks. Both inputs
+        // are read from startOffset.
+        InterleavedReader(
+            const std::filesystem::path& a,
+            const std::filesystem::path& b,
+            Arena& arena,
+            std::size_t chunkSize,
+            std::size_t extentSize,
+            bool keepCache,
+            std::uintmax_t startOffset);
+
+        [[nodiscard]] ChunkSource& getSourceA() noexcept;
+        [[nodiscard]] ChunkSource& getSourceB() noexcept;
+
+        // Arena space needed for the given geometry.
+        [[nodiscard]] static std::size_t getPoolSize(std::size_t chunkSize, std::size_t extentSize) noexcept;
+
+    private:
+        struct lane_s
+        {
+            std::uintmax_t offset;
+            std::uintmax_t consumed;
+            std::uintmax_t dropped;
+
+            unsigned char* pool;
+            std::size_t* lengths;
+
+            // Ring positions, in slots.
+            std::size_t head;
+            std::size_t filled;
+
+            FileDescriptor fd;
+            bool eos;
+        };
+
+        class Port final : public ChunkSource
+        {
+        public:
+            Port(InterleavedReader& owner, std::size_t lane) noexcept;
+            ~Port() override;
+
+            std::size_t read(unsigned char* buffer) override;
+
+            // Chunk geometry is fixed by the ring.
+            void setFillSize(std::size_t fillSize) override;
+
+            [[nodiscard]] double getFillRate() override;
+
+        private:
+            InterleavedReader& m_owner;
+            const std::size_t m_lane;
+        };
+
+        void run(std::stop_token stop);
+
+        std::size_t take(std::size_t lane, unsigned char* buffer);
+
+        std::size_t fillSlot(lane_s& lane, std::size_t slot);
+
+        void cleanup() noexcept;
+
+        const std::size_t m_chunk;
+        const std::size_t m_slotsPerExtent;
+        const std::size_t m_slots;
+        const bool m_keepCache;
+
+        lane_s m_lanes[2];
+
+        Port m_portA;
+        Port m_portB;
+
+        // Additional error tracking
+        std::exception_ptr m_error;
+
+        // Thread control
+        std::mutex m_mtx;
+        std::condition_variable m_slotFull;
+        std::condition_variable_any m_slotFree;
+
+        // Thread must outlive resources used by run()
+        std::jthread m_thread;
+    };
+}
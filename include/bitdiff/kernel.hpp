@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace isaki::bitdiff
+{
+    // Returns the index of the first i < len where a[i] != b[i], or len when
+    // the ranges are equal. Runs the widest variant the CPU supports, chosen
+    // once at startup, so a portable build still gets vector compares.
+    [[nodiscard]] std::size_t find_difference(const unsigned char* a, const unsigned char* b, std::size_t len) noexcept;
+
+    // Name of the active find_difference variant, e.g. "avx2".
+    [[nodiscard]] std::string_view get_kernel_name() noexcept;
+
+    // Number of set bits in x. A portable build cannot assume POPCNT, so
+    // the count is chosen at startup like find_difference; a build that
+    // already targets POPCNT inlines it instead.
+#ifdef __POPCNT__
+    [[nodiscard]] inline int count_bits(const std::uint64_t x) noexcept
+    {
+        return std::popcount(x);
+    }
+#else
+    [[nodiscard]] int count_bits(std::uint64_t x) noexcept;
+#endif
+
+    // Writes the low bytes of value as 2 * bytes lowercase hex digits, most
+    // significant first; bytes is at most 8.
+    void format_hex(char* out, std::uint64_t value, std::size_t bytes) noexcept;
+
+    // Writes the low bytes of value as 8 * bytes binary digits, most
+    // significant first; a bit clear in shown prints as '.' instead.
+    void format_bits(char* out, std::uint64_t value, std::uint64_t shown, std::size_t bytes) noexcept;
+
+    // Name of the active count_bits and formatter variant, e.g. "bmi2".
+    [[nodiscard]] std::string_view get_bit_kernel_name() noexcept;
+
+    // Forces a compare or bit variant by name; "generic" forces both. False
+    // if the name is unknown or unsupported here.
+    bool set_kernel(std::string_view name) noexcept;
+}
@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace isaki::bitdiff
+{
+    // Offsets whose differences are ignored. The mask file is text, one
+    // entry per line; numbers are decimal or 0x prefixed hexadecimal and
+    // '#' starts a comment:
+    //
+    //   skip <offset> <length>         ignore every bit of the range
+    //   bits <offset> <length> <mask>  ignore the bits set in mask in each
+    //                                  byte of the range
+    //
+    // Entries may overlap; their ignored bits combine.
+    class Mask final
+    {
+    public:
+        Mask() = delete;
+        Mask(const Mask&) = delete;
+        Mask& operator=(const Mask&) = delete;
+        Mask(Mask&&) = delete;
+        Mask& operator=(Mask&&) = delete;
+
+        ~Mask();
+
+        // Throws std::runtime_error naming the line of any malformed entry.
+        explicit Mask(const std::filesystem::path& file);
+
+        // Returns what to compare a against for the len bytes starting at
+        // offset base: b itself when no entry covers them, otherwise scratch
+        // holding b with the ignored bits of a copied over it, so masked
+        // differences compare equal and are not counted. b is left as read
+        // for the records. scratch must hold len bytes.
+        [[nodiscard]] const unsigned char* apply(std::uintmax_t base, const unsigned char* a, const unsigned char* b, unsigned char* scratch,
+            std::size_t len) const noexcept;
+
+        [[nodiscard]] std::size_t getRangeCount() const noexcept;
+
+    private:
+        struct range_s
+        {
+            std::uintmax_t begin;
+            std::uintmax_t end;
+            unsigned char ignore;
+        };
+
+        // Sorted and non-overlapping.
+        std::vector<range_s> m_ranges;
+
+        friend std::uint64_t mask_digest(const Mask* mask) noexcept;
+    };
+
+    // Digest of what mask ignores, so a reworded mask file keeps it. No mask
+    // has the digest of one that ignores nothing.
+    [[nodiscard]] std::uint64_t mask_digest(const Mask* mask) noexcept;
+}
@@ -0,0 +1,101 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "bitdiff/bitdiff.hpp"
+#include "bitdiff/hash.hpp"
+#include "bitdiff/sink.hpp"
+
+namespace isaki::bitdiff
+{
+    // Binary patch layout; every integer is little endian.
+    //
+    //   header  : "BITPATCH", u32 version, u32 reserved, u64 size
+    //   record  : u64 offset, u32 length, length bytes taken from B
+    //   trailer : u64 PATCH_END, u32 0, u64 records, u64 hash A, u64 hash B
+    //
+    // Records are in ascending, non-overlapping offset order. Hashes are
+    // Hash64 digests of the whole of each input.
+    constexpr std::uint64_t PATCH_END = ~std::uint64_t(0);
+
+    struct patch_trailer_s
+    {
+        std::uint64_t records;
+        std::uint64_t hashA;
+        std::uint64_t hashB;
+    };
+
+    // Turns the compare stream into coalesced patch records. Differences
+    // separated by only a few equal bytes share a record, since the equal
+    // bytes cost less than another record header.
+    class PatchWriter final
+    {
+    public:
+        PatchWriter() = delete;
+        PatchWriter(const PatchWriter&) = delete;
+        PatchWriter& operator=(const PatchWriter&) = delete;
+        PatchWriter(PatchWriter&&) = delete;
+        PatchWriter& operator=(PatchWriter&&) = delete;
+
+        ~PatchWriter();
+
+        // Writes the header. Both inputs must be size bytes long.
+        PatchWriter(Sink& output, std::uintmax_t size);
+
+        // Feeds the next len bytes of each input, which start at base.
+        void update(std::uintmax_t base, const unsigned char* a, const unsigned char* b, std::size_t len);
+
+        // Writes the last record and the trailer; returns the differences.
+        [[nodiscard]] diff_count finish();
+
+    private:
+        void emit();
+
+        Sink& m_output;
+
+        Hash64 m_hash_a;
+        Hash64 m_hash_b;
+
+        std::vector<unsigned char> m_pending;
+        std::uintmax_t m_pendingStart;
+
+        std::uint64_t m_records;
+        diff_count m_count;
+    };
+
+    // Sequential reader for a patch file. The trailer is read up front so a
+    // caller can check the target before applying anything.
+    class PatchReader final
+    {
+    public:
+        PatchReader() = delete;
+        PatchReader(const PatchReader&) = delete;
+        PatchReader& operator=(const PatchReader&) = delete;
+        PatchReader(PatchReader&&) = delete;
+        PatchReader& operator=(PatchReader&&) = delete;
+
+        ~PatchReader();
+
+        // Throws std::runtime_error if the header or trailer is malformed.
+        explicit PatchReader(const std::filesystem::path& file);
+
+        [[nodiscard]] std::uintmax_t getSize() const noexcept;
+        [[nodiscard]] const patch_trailer_s& getTrailer() const noexcept;
+
+        // Reads the next record into data; false once the trailer is reached.
+        bool next(std::uint64_t& offset, std::vector<unsigned char>& data);
+
+    private:
+        std::ifstream m_in;
+        std::uintmax_t m_size;
+        std::uint64_t m_seen;
+        patch_trailer_s m_trailer;
+    };
+}
@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace isaki::bitdiff
+{
+    // Pins the threads of a run to chosen CPUs and binds arena memory to a
+    // NUMA node, so buffers are filled and compared on the node that holds
+    // them. Threads place themselves on start (place_thread) and record
+    // which CPU they are on as they work (place_sample), for report().
+    class Placement final
+    {
+    public:
+        Placement() = delete;
+        Placement(const Placement&) = delete;
+        Placement& operator=(const Placement&) = delete;
+        Placement(Placement&&) = delete;
+        Placement& operator=(Placement&&) = delete;
+
+        // Uninstalls the placement.
+        ~Placement();
+
+        // Installs this as the process placement; only one may exist, and it
+        // must be created before the threads and arenas it should place.
+        // cpus is a list such as "0-3,8"; each placed thread gets the next
+        // CPU of the list in turn. When empty, threads may run on any CPU of
+        // node, or anywhere without one. A node of -1 leaves memory alone.
+        // Throws std::runtime_error for CPUs or a node this process cannot
+        // use.
+        Placement(std::string_view cpus, int node);
+
+        // Where each placed thread was pinned and ran. Every placed thread
+        // must have finished its work first.
+        void report(std::ostream& os) const;
+
+    private:
+        friend void place_thread(std::string_view name) noexcept;
+        friend void place_sample() noexcept;
+        friend void place_memory(void* ptr, std::size_t len) noexcept;
+
+        // Enough for CPU_SETSIZE CPUs.
+        static constexpr std::size_t CPU_WORDS = 16;
+
+        struct thread_s
+        {
+            std::string name;
+
+            // CPU this thread was pinned to, or -1 for the whole set.
+            int pinned;
+
+            // Bit per CPU the thread was seen on.
+            std::atomic<std::uint64_t> seen[CPU_WORDS];
+        };
+
+        static Placement* getActive() noexcept;
+
+        // Pins the calling thread and returns its record.
+        thread_s* add(std::string_view name) noexcept;
+
+        [[nodiscard]] int getNode(int cpu) const noexcept;
+
+        std::vector<int> m_cpus;
+        int m_node;
+
+        // Node of each CPU, -1 where unknown.
+        std::vector<int> m_cpuNode;
+
+        std::mutex m_mtx;
+        std::size_t m_next;
+        std::vector<std::unique_ptr<thread_s>> m_threads;
+
+        std::atomic<bool> m_memoryWarned;
+    };
+
+    // Pins the calling thread and records it under name. Ignored without a
+    // placement.
+    void place_thread(std::string_view name) noexcept;
+
+    // Notes the CPU the calling thread is on. One branch without a
+    // placement; cheap enough to call once per fill.
+    void place_sample() noexcept;
+
+    // Binds a fresh mapping to the placement's node, before anything
+    // touches it. Ignored without a node.
+    void place_memory(void* ptr, std::size_t len) noexcept;
+}
@@ -0,0 +1,79 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace isaki::bitdiff
+{
+    // Which of its own tasks a worker runs first.
+    enum class TaskOrder
+    {
+        // Best cache locality; suits independent tasks.
+        NewestFirst,
+        // Suits callers that consume results in submission order, so the
+        // oldest task is not left waiting behind newer ones.
+        OldestFirst
+    };
+
+    // Fixed set of workers, each with its own deque. A worker takes its own
+    // tasks in the given order and, when empty, steals the oldest task from
+    // another worker. Tasks receive the index of the worker running them so callers
+    // can keep per-worker scratch state without locking.
+    class WorkPool final
+    {
+    public:
+        using Task = std::function<void(std::size_t worker)>;
+
+        WorkPool() = delete;
+        WorkPool(const WorkPool&) = delete;
+        WorkPool& operator=(const WorkPool&) = delete;
+        WorkPool(WorkPool&&) = delete;
+        WorkPool& operator=(WorkPool&&) = delete;
+
+        // Stops the workers; tasks that have not started are dropped.
+        ~WorkPool();
+
+        // A count of 0 uses the hardware concurrency.
+        WorkPool(std::size_t threads, TaskOrder order);
+
+        // Tasks must not throw; exceptions are swallowed to keep the worker
+        // alive.
+        void submit(Task task);
+
+        [[nodiscard]] std::size_t getThreadCount() const noexcept;
+
+    private:
+        struct queue_s
+        {
+            std::mutex mtx;
+            std::deque<Task> tasks;
+        };
+
+        void run(std::stop_token stop, std::size_t index);
+
+        bool tryTake(std::size_t index, Task& task);
+
+        std::vector<std::unique_ptr<queue_s>> m_queues;
+        const TaskOrder m_order;
+
+        // Idle workers sleep here until m_pending is non-zero.
+        std::mutex m_mtx;
+        std::condition_variable_any m_wake;
+        std::atomic<std::size_t> m_pending;
+        std::atomic<std::size_t> m_next;
+
+        // Threads must outlive resources used by run()
+        std::vector<std::jthread> m_threads;
+    };
+}
@@ -4,18 +4,75 @@
 #pragma once
 
 #include <memory>
-#include <fstream>
 #include <mutex>
 #include <filesystem>
+#include <string_view>
 #include <cstddef>
+#include <cstdint>
 #include <condition_variable>
 #include <thread>
 #include <stop_token>
 #include <exception>
+#include <chrono>
+
+#include "bitdiff/fd.hpp"
 
 namespace isaki::bitdiff
 {
-    class Reader final
+    struct read_options
+    {
+        // Capacity of each buffer; also the fill size unless adaptive.
+        std::size_t bufferSize;
+
+        // Start from a block-aligned default and let the consumer resize
+        // fills from measured throughput.
+        bool adaptive;
+
+        // Skip the page cache hints so the data stays cached.
+        bool keepCache;
+
+        // When non-zero, one thread reads both inputs in alternating extents
+        // of this many bytes instead of one thread per input.
+        std::size_t extentSize;
+
+        // Where reading begins in both inputs (non-zero when resuming).
+        std::uintmax_t startOffset;
+    };
+
+    // Reads from fd until len bytes or end of file. Throws std::system_error.
+    std::size_t read_fully(int fd, unsigned char* buffer, std::size_t len);
+
+    // As read_fully, from offset and without moving the file position.
+    std::size_t pread_fully(int fd, unsigned char* buffer, std::size_t len, std::uintmax_t offset);
+
+    // Sequential chunks of one input. Sources that are compared against each
+    // other must produce chunks of the same size.
+    class ChunkSource
+    {
+    public:
+        ChunkSource(const ChunkSource&) = delete;
+        ChunkSource& operator=(const ChunkSource&) = delete;
+        ChunkSource(ChunkSource&&) = delete;
+        ChunkSource& operator=(ChunkSource&&) = delete;
+
+        virtual ~ChunkSource();
+
+        // Copies the next chunk into buffer, which must hold a full chunk.
+        // Returns 0 at end of input.
+        virtual std::size_t read(unsigned char* buffer) = 0;
+
+        // Applies to the next fill started after the next call to read().
+        virtual void setFillSize(std::size_t fillSize) = 0;
+
+        // Bytes per second spent reading so far; 0 until known or when the
+        // source cannot be resized.
+        [[nodiscard]] virtual double getFillRate() = 0;
+
+    protected:
+        ChunkSource() = default;
+    };
+
+    class Reader final : public ChunkSource
     {
     public:
         Reader() = delete;
@@ -24,37 +81,84 @@ namespace isaki::bitdiff
         Reader(Reader&&) = delete;
         Reader& operator=(Reader&&) = delete;
 
-        ~Reader();
+        ~Reader() override;
+
+        // This creates a reader based on a file, positioned at startOffset.
+        // The buffer is borrowed and must outlive the reader. Fills start at
+        // fillSize, which may not exceed bufferSize.
+        Reader(
+            const std::filesystem::path& file,
+            unsigned char* buffer,
+            std::size_t bufferSize,
+            std::size_t fillSize,
+            bool keepCache,
+            std::uintmax_t startOffset);
+
+        // As above, but idle until open() is called. The thread is named
+        // after name.
+        Reader(
+            std::string_view name,
+            unsigned char* buffer,
+            std::size_t bufferSize,
+            std::size_t fillSize,
+            bool keepCache);
 
-        // This creates a reader based on a file.
-        Reader(const std::filesystem::path& file, std::size_t bufferSize);
+        // Starts reading file from startOffset on the same thread and
+        // buffer, dropping whatever is left of the previous file. Throws if
+        // file cannot be opened, leaving the reader idle.
+        void open(const std::filesystem::path& file, std::uintmax_t startOffset);
 
         // Buffer must be at least as big as the bufferSize used on
         // construction.
-        std::size_t read(unsigned char * buffer);
+        std::size_t read(unsigned char * buffer) override;
+
+        // Readers that are compared against each other must be resized
+        // together to keep their chunks aligned. Takes effect on the fill
+        // after the next read() or open(), never on one already started.
+        void setFillSize(std::size_t fillSize) override;
+
+        [[nodiscard]] double getFillRate() override;
 
     private:
 
         void run(std::stop_token stop);
 
+        void dropCache(std::uintmax_t end, bool force) noexcept;
+
+        void closeFile() noexcept;
+
         void cleanup() noexcept;
 
         const std::size_t m_bsize;
+        std::size_t m_fsize;
+
+        // Fill size set by setFillSize(), applied by read() or open().
+        std::size_t m_nextFsize;
+
+        // Page cache management
+        std::uintmax_t m_offset;
+        std::uintmax_t m_dropped;
+        bool m_keepCache;
+
+        // Throughput accounting for adaptive sizing
+        std::uintmax_t m_fillBytes;
+        std::chrono::steady_clock::duration m_fillTime;
 
         // Additional error tracking
         std::exception_ptr m_error;
 
-        // Thread control; this is NOT reentrant.
+        // Thread control; this is NOT reentrant. m_eos is also set while
+        // idle between files.
         std::mutex m_mtx;
         std::condition_variable m_bufferFull;
         std::condition_variable_any m_bufferFree;
-        std::streamsize m_read;
+        std::size_t m_read;
         bool m_eos;
 
-        // The stream
-        std::ifstream* m_is;
+        // The file; -1 while idle.
+        FileDescriptor m_fd;
 
-        // The data
+        // The data (not owned)
         unsigned char* m_buffer;
 
         // Thread must outlive resources used by run()
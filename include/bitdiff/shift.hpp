@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+#include "bitdiff/bitdiff.hpp"
+#include "bitdiff/dataout.hpp"
+#include "bitdiff/sink.hpp"
+
+namespace isaki::bitdiff
+{
+    struct shift_count
+    {
+        // Bytes found in both inputs out of order. Data that is only
+        // displaced by insertions or deletions before it is not counted.
+        std::uintmax_t moved;
+
+        // Bytes only in B, and only in A.
+        std::uintmax_t inserted;
+        std::uintmax_t deleted;
+
+        // Byte differences within changed regions.
+        diff_count changed;
+    };
+
+    // Compares two files that may have had data inserted or removed. Both
+    // are cut into content-defined chunks (FastCDC gear hash), so a boundary
+    // depends only on the bytes just before it and chunking resynchronizes
+    // shortly after an edit. Chunks are matched across the inputs by length
+    // and XXH64, and the unmatched stretches between matches are reported as
+    // inserted, deleted or changed regions. Only changed regions are
+    // compared byte by byte.
+    class ShiftDiff final
+    {
+    public:
+        ShiftDiff() = delete;
+        ShiftDiff(const ShiftDiff&) = delete;
+        ShiftDiff& operator=(const ShiftDiff&) = delete;
+        ShiftDiff(ShiftDiff&&) = delete;
+        ShiftDiff& operator=(ShiftDiff&&) = delete;
+
+        ShiftDiff(std::string_view a, std::string_view b, bool keepCache, bool fastMode);
+        ~ShiftDiff();
+
+        // Region records give both offsets and a length; each changed region
+        // is followed by its byte records, addressed by offset in A.
+        [[nodiscard]] shift_count process(Sink& output, bool printHeader, DataOutType type);
+
+        [[nodiscard]] std::uintmax_t getFileASize() const noexcept;
+        [[nodiscard]] std::uintmax_t getFileBSize() const noexcept;
+
+    private:
+        std::filesystem::path m_path_a;
+        std::filesystem::path m_path_b;
+
+        std::uintmax_t m_fsize_a;
+        std::uintmax_t m_fsize_b;
+
+        bool m_keepCache;
+        bool m_fast;
+        bool m_valid;
+    };
+}
@@ -0,0 +1,197 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <filesystem>
+
+namespace isaki::bitdiff
+{
+    // Output sink for diff records. The fast path is a non-virtual copy into a
+    // staging buffer; derived classes only see full buffers (or oversized
+    // writes) through commit(). Errors are reported by throwing
+    // std::ios_base::failure, the same as an ostream with failbit | badbit set.
+    class Sink
+    {
+    public:
+        Sink(const Sink&) = delete;
+        Sink& operator=(const Sink&) = delete;
+        Sink(Sink&&) = delete;
+        Sink& operator=(Sink&&) = delete;
+
+        virtual ~Sink();
+
+        void write(const char* data, const std::size_t len)
+        {
+            if (len <= static_cast<std::size_t>(m_end - m_pos)) [[likely]]
+            {
+                std::memcpy(m_pos, data, len);
+                m_pos += len;
+            }
+            else
+            {
+                overflow(data, len);
+            }
+        }
+
+        // Pushes all staged data to the underlying device.
+        void flush();
+
+        // Flushes and waits until the data is on stable storage, where that
+        // means anything for the device.
+        void persist();
+
+        // Bytes accepted so far, including the starting position of a
+        // resumed output.
+        [[nodiscard]] std::uintmax_t tell() const noexcept;
+
+    protected:
+        Sink() noexcept;
+
+        // Sets the position reported by tell() for an output that does not
+        // start empty. Only call it before anything is written.
+        void setPosition(std::uintmax_t position) noexcept;
+
+        // The buffer is owned by the derived class. This discards anything
+        // currently staged, so only call it when the buffer is empty.
+        void setBuffer(char* buffer, std::size_t len) noexcept;
+
+        // Emits the staged bytes followed by data. Either range may be empty.
+        virtual void commit(const char* staged, std::size_t stagedLen, const char* data, std::size_t len) = 0;
+
+        virtual void sync();
+
+        virtual void syncData();
+
+    private:
+        void overflow(const char* data, std::size_t len);
+
+        std::uintmax_t m_committed;
+
+        char* m_begin;
+        char* m_pos;
+        char* m_end;
+    };
+
+    // Adapter for callers that still hand us a stream; unbuffered on our side
+    // since the stream has its own buffer.
+    class OStreamSink final : public Sink
+    {
+    public:
+        OStreamSink() = delete;
+        OStreamSink(const OStreamSink&) = delete;
+        OStreamSink& operator=(const OStreamSink&) = delete;
+        OStreamSink(OStreamSink&&) = delete;
+        OStreamSink& operator=(OStreamSink&&) = delete;
+
+        ~OStreamSink() override;
+
+        explicit OStreamSink(std::ostream& os);
+
+    protected:
+        void commit(const char* staged, std::size_t stagedLen, const char* data, std::size_t len) override;
+
+        void sync() override;
+
+    private:
+        std::ostream& m_os;
+    };
+
+    // Collects output in memory so it can be emitted later, in order.
+    class BufferSink final : public Sink
+    {
+    public:
+        BufferSink(const BufferSink&) = delete;
+        BufferSink& operator=(const BufferSink&) = delete;
+        BufferSink(BufferSink&&) = delete;
+        BufferSink& operator=(BufferSink&&) = delete;
+
+        ~BufferSink() override;
+
+        BufferSink();
+
+        // Flushes and hands over everything written so far, leaving the sink
+        // empty.
+        [[nodiscard]] std::string take();
+
+    protected:
+        void commit(const char* staged, std::size_t stagedLen, const char* data, std::size_t len) override;
+
+    private:
+        std::string m_data;
+        char* m_buffer;
+    };
+
+    // Raw file descriptor sink using write(2)/writev(2).
+    class FdSink final : public Sink
+    {
+    public:
+        FdSink() = delete;
+        FdSink(const FdSink&) = delete;
+        FdSink& operator=(const FdSink&) = delete;
+        FdSink(FdSink&&) = delete;
+        FdSink& operator=(FdSink&&) = delete;
+
+        // Best effort flush and close; call close() to observe errors.
+        ~FdSink() override;
+
+        // Wraps an existing descriptor (e.g. STDOUT_FILENO) without taking
+        // ownership. When useVmsplice is set and fd is a pipe, full buffers
+        // are handed to the pipe with vmsplice(2) instead of copied. The
+        // pipe is resized to bound how many buffers it holds at once, so
+        // the reader must copy data out of it; one that splices the pages
+        // onward could see them reused.
+        FdSink(int fd, bool useVmsplice);
+
+        // Creates or truncates file. Space is reserved ahead of the write
+        // position with fallocate(2) where the filesystem supports it.
+        explicit FdSink(const std::filesystem::path& file);
+
+        // Reopens file, discards everything past position and continues
+        // writing from there. The file must be at least position bytes long.
+        FdSink(const std::filesystem::path& file, std::uintmax_t position);
+
+        // Flushes, releases any unused reservation and closes an owned
+        // descriptor.
+        void close();
+
+    protected:
+        void commit(const char* staged, std::size_t stagedLen, const char* data, std::size_t len) override;
+
+        void syncData() override;
+
+    private:
+        void open(const std::filesystem::path& file, int flags);
+
+        void allocateBuffer();
+
+        void releaseBuffer() noexcept;
+
+        void reserve(std::size_t len);
+
+        void writeAll(const char* staged, std::size_t stagedLen, const char* data, std::size_t len);
+
+        void spliceAll(const char* staged, std::size_t stagedLen);
+
+        void cleanup() noexcept;
+
+        std::uintmax_t m_offset;
+        std::uintmax_t m_reserved;
+
+        char* m_buffer;
+
+        // Buffer of the vmsplice ring being filled.
+        std::size_t m_spliceIndex;
+
+        int m_fd;
+        bool m_owned;
+        bool m_bad;
+        bool m_vmsplice;
+        bool m_preallocate;
+    };
+}
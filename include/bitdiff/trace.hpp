@@ -0,0 +1,96 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace isaki::bitdiff
+{
+    // Records spans into per-thread rings and writes them as Chrome trace
+    // event JSON (chrome://tracing, Perfetto). Each thread owns its ring, so
+    // recording takes no lock; a thread locks once, to register. When a ring
+    // wraps, the oldest spans are overwritten.
+    class Tracer final
+    {
+    public:
+        Tracer() = delete;
+        Tracer(const Tracer&) = delete;
+        Tracer& operator=(const Tracer&) = delete;
+        Tracer(Tracer&&) = delete;
+        Tracer& operator=(Tracer&&) = delete;
+
+        // Uninstalls the tracer.
+        ~Tracer();
+
+        // Installs this as the process tracer. Only one may exist, and it
+        // must be created before the threads it should see.
+        explicit Tracer(std::size_t eventsPerThread);
+
+        // Every traced thread must have finished (been joined) first.
+        void write(const std::filesystem::path& file) const;
+
+    private:
+        friend class TraceSpan;
+        friend void trace_thread_name(std::string_view name) noexcept;
+
+        struct event_s
+        {
+            const char* name;
+            std::uint64_t begin;
+            std::uint64_t end;
+        };
+
+        struct ring_s
+        {
+            std::unique_ptr<event_s[]> events;
+            std::uint64_t count;
+            std::string thread;
+        };
+
+        static Tracer* getActive() noexcept;
+
+        // Nanoseconds since the tracer was created.
+        [[nodiscard]] std::uint64_t now() const noexcept;
+
+        // This thread's ring, registering it on first use. Null if the
+        // ring cannot be allocated; the thread then goes untraced.
+        ring_s* getRing() noexcept;
+
+        const std::size_t m_capacity;
+        const std::uint64_t m_epoch;
+
+        std::mutex m_mtx;
+        std::vector<std::unique_ptr<ring_s>> m_rings;
+    };
+
+    // Times its own lifetime as a span called name, which must be a string
+    // literal. Costs one branch when no tracer is installed.
+    class TraceSpan final
+    {
+    public:
+        TraceSpan() = delete;
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+        TraceSpan(TraceSpan&&) = delete;
+        TraceSpan& operator=(TraceSpan&&) = delete;
+
+        explicit TraceSpan(const char* name) noexcept;
+        ~TraceSpan();
+
+    private:
+        Tracer* m_tracer;
+        const char* m_name;
+        std::uint64_t m_begin;
+    };
+
+    // Labels the calling thread in the trace. Ignored without a tracer.
+    void trace_thread_name(std::string_view name) noexcept;
+}
@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bitdiff/bitdiff.hpp"
+#include "bitdiff/compare.hpp"
+#include "bitdiff/dataout.hpp"
+#include "bitdiff/sink.hpp"
+
+namespace isaki::bitdiff
+{
+    // Compares two directory trees file by file. Files are paired by path
+    // relative to each root; pairs are cut into tasks (small files batched,
+    // large files split) and run on a work-stealing pool. Records carry the
+    // relative path as an extra leading column and are emitted in path order.
+    class TreeDiff final
+    {
+    public:
+        TreeDiff() = delete;
+        TreeDiff(const TreeDiff&) = delete;
+        TreeDiff& operator=(const TreeDiff&) = delete;
+        TreeDiff(TreeDiff&&) = delete;
+        TreeDiff& operator=(TreeDiff&&) = delete;
+
+        ~TreeDiff();
+
+        // Walks both trees. A thread count of 0 uses the hardware concurrency.
+        TreeDiff(std::string_view a, std::string_view b, std::size_t threads, bool fastMode);
+
+        // Returns the number of differences across all paired files. Files
+        // present in only one tree are reported on stderr.
+        [[nodiscard]] diff_count process(Sink& output, bool printHeader, DataOutType type, const word_format_s& word);
+
+        [[nodiscard]] std::size_t getPairedCount() const noexcept;
+        [[nodiscard]] std::size_t getUnpairedCount() const noexcept;
+
+    private:
+        struct pair_s
+        {
+            std::string relative;
+            std::uintmax_t sizeA;
+            std::uintmax_t sizeB;
+        };
+
+        std::filesystem::path m_root_a;
+        std::filesystem::path m_root_b;
+
+        std::vector<pair_s> m_pairs;
+        std::vector<std::string> m_only_a;
+        std::vector<std::string> m_only_b;
+
+        std::size_t m_threads;
+        bool m_fast;
+        bool m_valid;
+    };
+}
@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+#include "bitdiff/sink.hpp"
+
+namespace isaki::bitdiff
+{
+    struct vote_count
+    {
+        // Offsets where the replicas do not all agree.
+        std::uintmax_t bytes;
+
+        // Offsets where replica A, B or C alone disagrees with the other two.
+        std::array<std::uintmax_t, 3> outliers;
+
+        // Offsets where all three bytes differ; the majority is then taken
+        // bit by bit and no replica is singled out.
+        std::uintmax_t split;
+    };
+
+    // Reads three replicas of the same data in one pass and reports every
+    // offset where they disagree, with the bitwise majority and the replica
+    // that is out of line. The majority may also be written out as a
+    // repaired copy.
+    class VoteDiff final
+    {
+    public:
+        VoteDiff() = delete;
+        VoteDiff(const VoteDiff&) = delete;
+        VoteDiff& operator=(const VoteDiff&) = delete;
+        VoteDiff(VoteDiff&&) = delete;
+        VoteDiff& operator=(VoteDiff&&) = delete;
+
+        // All three inputs must be the same size.
+        VoteDiff(std::string_view a, std::string_view b, std::string_view c, bool keepCache, bool fastMode);
+        ~VoteDiff();
+
+        // Records are offset, the byte from each replica, the majority and
+        // the outlier (A, B, C, or - when all three differ). When repair is
+        // not null it receives the majority of every byte.
+        [[nodiscard]] vote_count process(Sink& output, bool printHeader, Sink* repair);
+
+        [[nodiscard]] std::uintmax_t getFileSize() const noexcept;
+
+    private:
+        std::filesystem::path m_path_a;
+        std::filesystem::path m_path_b;
+        std::filesystem::path m_path_c;
+
+        std::uintmax_t m_fsize;
+
+        bool m_keepCache;
+        bool m_fast;
+        bool m_valid;
+    };
+}
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+#include "bitdiff/bitdiff.hpp"
+#include "bitdiff/compare.hpp"
+#include "bitdiff/dataout.hpp"
+#include "bitdiff/mask.hpp"
+#include "bitdiff/sink.hpp"
+
+namespace isaki::bitdiff
+{
+    // Keeps comparing two files while they are written. The first pass
+    // diffs everything; afterwards inotify wakes a pass whenever either
+    // file changes, and only blocks whose length or XXH64 changed since the
+    // last pass are compared and printed again. A file that did not change
+    // is not read except for the blocks being compared.
+    class WatchDiff final
+    {
+    public:
+        WatchDiff() = delete;
+        WatchDiff(const WatchDiff&) = delete;
+        WatchDiff& operator=(const WatchDiff&) = delete;
+        WatchDiff(WatchDiff&&) = delete;
+        WatchDiff& operator=(WatchDiff&&) = delete;
+
+        WatchDiff(std::string_view a, std::string_view b, bool fastMode);
+        ~WatchDiff();
+
+        // Runs passes until SIGINT or SIGTERM and returns the differences in
+        // the last compared state. Each pass prints the records of every
+        // block it compared, superseding earlier records in that block. The
+        // mask, when not null, must outlive the call.
+        [[nodiscard]] diff_count process(Sink& output, bool printHeader, DataOutType type, const word_format_s& word, const Mask* mask);
+
+    private:
+        struct block_s
+        {
+            std::uint64_t hashA;
+            std::uint64_t hashB;
+            std::size_t length;
+            diff_count count;
+        };
+
+        std::filesystem::path m_path_a;
+        std::filesystem::path m_path_b;
+
+        // State after the last pass, one entry per compared block.
+        std::vector<block_s> m_blocks;
+        diff_count m_total;
+
+        bool m_fast;
+        bool m_valid;
+    };
+}
@@ -0,0 +1,121 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <new>
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/mman.h>
+
+#include "bitdiff/arena.hpp"
+#include "bitdiff/placement.hpp"
+
+namespace bd = isaki::bitdiff;
+
+namespace
+{
+    constexpr std::size_t HUGE_PAGE_LENGTH = 2 * 1024 * 1024;
+
+    // Below this a huge page would mostly be padding; scratch arenas of a few
+    // KiB would otherwise each pin 2 MiB.
+    constexpr std::size_t HUGE_PAGE_THRESHOLD = 1024 * 1024;
+
+    constexpr std::size_t round_up(const std::size_t len, const std::size_t align) noexcept
+    {
+        return (len + align - 1) & ~(align - 1);
+    }
+
+    void* map_anonymous(const std::size_t len, const int extra) noexcept
+    {
+        void* ptr = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extra, -1, 0);
+        return (ptr == MAP_FAILED) ? nullptr : ptr;
+    }
+}
+
+bd::Arena::~Arena()
+{
+    if (m_base != nullptr)
+    {
+        ::munmap(m_base, m_mapped);
+    }
+}
+
+bd::Arena::Arena(const std::size_t capacity) :
+    m_base(nullptr),
+    m_mapped(round_up(capacity, (capacity < HUGE_PAGE_THRESHOLD) ? bd::IO_ALIGNMENT : HUGE_PAGE_LENGTH)),
+    m_used(0),
+    m_hugetlb(false)
+{
+    if (capacity < HUGE_PAGE_THRESHOLD)
+    {
+        m_base = static_cast<unsigned char*>(map_anonymous(m_mapped, 0));
+        if (m_base == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+
+        place_memory(m_base, m_mapped);
+        return;
+    }
+
+#ifdef MAP_HUGETLB
+    // Only succeeds when the administrator has reserved huge pages.
+    if (void* ptr = map_anonymous(m_mapped, MAP_HUGETLB); ptr != nullptr)
+    {
+        m_base = static_cast<unsigned char*>(ptr);
+        m_hugetlb = true;
+        place_memory(m_base, m_mapped);
+        return;
+    }
+#endif
+
+    // Over-map so the start can be moved to a huge page boundary, then trim.
+    const std::size_t padded = m_mapped + HUGE_PAGE_LENGTH;
+    auto* raw = static_cast<unsigned char*>(map_anonymous(padded, 0));
+    if (raw == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    const auto addr = reinterpret_cast<std::uintptr_t>(raw);
+    const std::size_t head = round_up(addr, HUGE_PAGE_LENGTH) - addr;
+    const std::size_t tail = padded - head - m_mapped;
+
+    if (head > 0)
+    {
+        ::munmap(raw, head);
+    }
+
+    if (tail > 0)
+    {
+        ::munmap(raw + head + m_mapped, tail);
+    }
+
+    m_base = raw + head;
+
+#ifdef MADV_HUGEPAGE
+    // Advisory; transparent huge pages may be disabled.
+    ::madvise(m_base, m_mapped, MADV_HUGEPAGE);
+#endif
+
+    place_memory(m_base, m_mapped);
+}
+
+void* bd::Arena::allocate(const std::size_t len, const std::size_t alignment)
+{
+    // The base is page aligned (huge page aligned for large arenas), so
+    // aligning the offset is enough.
+    const std::size_t start = round_up(m_used, alignment);
+    if (start > m_mapped || len > m_mapped - start)
+    {
+        throw std::bad_alloc();
+    }
+
+    m_used = start + len;
+    return m_base + start;
+}
+
+bool bd::Arena::isHugeTlb() const noexcept
+{
+    return m_hugetlb;
+}
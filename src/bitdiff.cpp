@@ -2,8 +2,11 @@
 /* Copyright 2025-2026 isaki */
 
 #include <ostream>
+#include <sstream>
 #include <stdexcept>
 #include <algorithm>
+#include <numeric>
+#include <bit>
 
 #include <cstdint>
 #include <cstddef>
@@ -12,10 +15,26 @@
 #include <string_view>
 
 #include <memory>
+#include <chrono>
 
+#include <sys/stat.h>
+
+#include "bitdiff/arena.hpp"
 #include "bitdiff/reader.hpp"
+#include "bitdiff/interleave.hpp"
+#include "bitdiff/kernel.hpp"
 #include "bitdiff/dataout.hpp"
+#include "bitdiff/format.hpp"
+#include "bitdiff/compare.hpp"
+#include "bitdiff/checkpoint.hpp"
+#include "bitdiff/mask.hpp"
+#include "bitdiff/placement.hpp"
+#include "bitdiff/trace.hpp"
+#include "bitdiff/sink.hpp"
 #include "bitdiff/bitdiff.hpp"
+#include "bitdiff/patch.hpp"
+#include "bitdiff/blockmap.hpp"
+#include "bitdiff/index.hpp"
 
 namespace bd = isaki::bitdiff;
 namespace fs = std::filesystem;
@@ -24,6 +43,47 @@ namespace
 {
     constexpr char OUT_DELIM = '\t';
 
+    // Room for the DataOut record; far larger than any record format.
+    constexpr std::size_t SCRATCH_LENGTH = 4096;
+
+    // Adaptive read sizing: start at the historical default, then after a few
+    // fills pick a size that keeps each fill around FILL_TARGET long.
+    constexpr std::size_t INITIAL_FILL_LENGTH = 2 * 1024 * 1024;
+    constexpr std::size_t MIN_FILL_LENGTH = 256 * 1024;
+    constexpr std::size_t PROBE_FILLS = 4;
+    constexpr double FILL_TARGET = 0.02;
+
+    std::size_t block_size(const fs::path& p)
+    {
+        struct stat st{};
+        if (::stat(p.c_str(), &st) == 0 && st.st_blksize > 0)
+        {
+            return static_cast<std::size_t>(st.st_blksize);
+        }
+
+        return 1;
+    }
+
+    // Rounds len up to a multiple of block, capped at the largest multiple
+    // that fits in limit.
+    std::size_t align_fill(const std::size_t len, const std::size_t block, const std::size_t limit)
+    {
+        const std::size_t up = ((len + block - 1) / block) * block;
+        if (up <= limit)
+        {
+            return up;
+        }
+
+        const std::size_t down = (limit / block) * block;
+        return (down == 0) ? limit : down;
+    }
+
+    // Buffer length padded for O_DIRECT style alignment.
+    std::size_t io_length(const std::size_t len)
+    {
+        return ((len + bd::IO_ALIGNMENT - 1) / bd::IO_ALIGNMENT) * bd::IO_ALIGNMENT;
+    }
+
     struct ostream_state_cache_s
     {
         std::ostream* s;
@@ -46,25 +106,197 @@ namespace
     };
 
     template<bool Fast>
-    void newline(std::ostream& os)
+    void newline(bd::Sink& os)
     {
-        if constexpr (Fast)
+        os.write("\n", 1);
+
+        if constexpr (!Fast)
         {
-            os.write("\n", 1);
+            os.flush();
         }
-        else
+    }
+
+    // Sets both readers to a fill that takes about FILL_TARGET at the slower
+    // reader's rate, aligned to block and capped at limit. Returns the size
+    // before alignment, or 0 when no rate was measured yet.
+    std::size_t resize_fills(bd::ChunkSource& readerA, bd::ChunkSource& readerB, const std::size_t block, const std::size_t limit)
+    {
+        const double rate = std::min(readerA.getFillRate(), readerB.getFillRate());
+        if (rate <= 0.0)
         {
-            os << std::endl;
+            return 0;
         }
+
+        const auto target = static_cast<std::size_t>(std::min(rate * FILL_TARGET, static_cast<double>(limit)));
+        const std::size_t size = std::max(target, MIN_FILL_LENGTH);
+        const std::size_t fillSize = align_fill(size, block, limit);
+
+        readerA.setFillSize(fillSize);
+        readerB.setFillSize(fillSize);
+
+        std::cerr << "Read size set to " << (fillSize >> 10) << " KiB" << std::endl;
+        return size;
     }
+
+    // One lockstep pass over a pair of inputs.
+    struct chunk_pass_s
+    {
+        bd::ChunkSource& readerA;
+        bd::ChunkSource& readerB;
+        unsigned char* bufferA;
+        unsigned char* bufferB;
+
+        // Applied to every fill when set; bufferMask takes the masked copy.
+        const bd::Mask* mask;
+        unsigned char* bufferMask;
+        bd::IndexWriter* index;
+
+        // Offset of the first fill, and where the shorter input ends.
+        std::uintmax_t start;
+        std::uintmax_t expected;
+    };
+
+    // Calls beforeFill() ahead of each fill, onChunk(base, compareB, len)
+    // with the compared length of each fill and onBoundary(bytesRead) after
+    // every full one. compareB is bufferB, or its masked copy when the mask
+    // covers part of the fill. Throws if the inputs end early or out of
+    // step.
+    template<typename R, typename F, typename G>
+    void for_each_chunk(const chunk_pass_s& pass, R&& beforeFill, F&& onChunk, G&& onBoundary)
+    {
+        std::uintmax_t bytesRead = pass.start;
+
+        while (true)
+        {
+            beforeFill();
+
+            const std::size_t tmpA = pass.readerA.read(pass.bufferA);
+            const std::size_t tmpB = pass.readerB.read(pass.bufferB);
+
+            const std::size_t tmpX = std::min(tmpA, tmpB);
+
+            {
+                const bd::TraceSpan span("compare");
+                bd::place_sample();
+
+                const unsigned char* compareB = (pass.mask != nullptr)
+                    ? pass.mask->apply(bytesRead, pass.bufferA, pass.bufferB, pass.bufferMask, tmpX)
+                    : pass.bufferB;
+
+                if (pass.index != nullptr)
+                {
+                    pass.index->update(bytesRead, pass.bufferA, compareB, tmpX);
+                }
+
+                onChunk(bytesRead, compareB, tmpX);
+            }
+
+            bytesRead += static_cast<std::uintmax_t>(tmpX);
+
+            // Unequal reads are only expected where the shorter input ends.
+            if (tmpA == 0 || tmpB == 0 || (tmpA != tmpB && bytesRead == pass.expected))
+            {
+                break;
+            }
+
+            if (tmpA != tmpB)
+            {
+                throw std::runtime_error("Read mismatch encountered before end of file reached");
+            }
+
+            onBoundary(bytesRead);
+        }
+
+        if (bytesRead != pass.expected)
+        {
+            std::string err;
+            err.append("Bytes read ");
+            err.append(std::to_string(bytesRead));
+            err.append(" not equal to expected ");
+            err.append(std::to_string(pass.expected));
+
+            throw std::runtime_error(err);
+        }
+    }
+
+    // Counts and writes the records of one chunk, through pipeline when it
+    // is set and with out otherwise. Masked bits are not counted, but
+    // records show B as read.
+    struct record_writer_s
+    {
+        const bd::word_format_s& word;
+        bd::Sink& output;
+        std::string_view prefix;
+        bd::DataOut& out;
+        bd::FormatPipeline* pipeline;
+        void (*newline)(bd::Sink&);
+        bd::diff_count& count;
+
+        void chunk(const std::uintmax_t base, const unsigned char* a, const unsigned char* b,
+            const unsigned char* compareB, const std::size_t len) const
+        {
+            const auto shown = [&](const std::size_t i, const std::uint64_t wordB)
+            {
+                return (compareB == b) ? wordB : bd::read_word(word, b + i, len - i);
+            };
+
+            if (pipeline != nullptr)
+            {
+                bd::for_each_word_difference(word, a, compareB, len, [&](const std::size_t i, const std::uint64_t wordA, const std::uint64_t wordB)
+                {
+                    const std::uint64_t x = wordA ^ wordB;
+                    count.bytes += static_cast<std::uintmax_t>(bd::nonzero_bytes(x));
+                    count.bits += static_cast<std::uintmax_t>(bd::count_bits(x));
+
+                    pipeline->add(base + static_cast<std::uintmax_t>(i), wordA, shown(i, wordB));
+                });
+
+                return;
+            }
+
+            bd::for_each_word_difference(word, a, compareB, len, [&](const std::size_t i, const std::uint64_t wordA, const std::uint64_t wordB)
+            {
+                out.init(base + static_cast<std::uintmax_t>(i), wordA, shown(i, wordB));
+
+                // Counters
+                const std::uint64_t x = wordA ^ wordB;
+                count.bytes += static_cast<std::uintmax_t>(bd::nonzero_bytes(x));
+                count.bits += static_cast<std::uintmax_t>(bd::count_bits(x));
+
+                if (!prefix.empty())
+                {
+                    output.write(prefix.data(), prefix.size());
+                }
+
+                out.print(output);
+                newline(output);
+            });
+        }
+    };
 }
 
-bd::BitDiff::BitDiff(std::string_view a, std::string_view b, std::size_t bufferSize, bool fastMode) :
+bd::BitDiff::BitDiff(std::string_view a, std::string_view b, const read_options& readOptions, bool fastMode) :
+    m_bsize(readOptions.bufferSize),
+    m_blksize(1),
+    m_start(readOptions.startOffset),
+    m_start_count{ .bytes = 0, .bits = 0 },
+    m_start_type(DataOutType::Bits),
+    m_start_word(BYTE_FORMAT),
+    m_resumed(false),
+    m_checkpoint(nullptr),
+    m_mask(nullptr),
+    m_index(nullptr),
+    m_formatThreads(1),
+    m_arena(nullptr),
     m_buffer_a(nullptr),
     m_buffer_b(nullptr),
+    m_buffer_mask(nullptr),
     m_reader_a(nullptr),
     m_reader_b(nullptr),
+    m_interleaved(nullptr),
     m_newline((fastMode) ? newline<true> : newline<false>),
+    m_fast(fastMode),
+    m_adaptive(readOptions.adaptive && readOptions.extentSize == 0),
     m_valid(true)
 {
     // Temp values
@@ -76,12 +308,56 @@ bd::BitDiff::BitDiff(std::string_view a, std::string_view b, std::size_t bufferS
         m_fsize_a = fs::file_size(m_path_a);
         m_fsize_b = fs::file_size(m_path_b);
 
-        m_reader_a = new Reader(m_path_a, bufferSize);
+        // Both readers must fill in lockstep, so they share one fill size.
+        std::size_t fillSize = m_bsize;
+        if (readOptions.adaptive)
+        {
+            // Whole words per fill, so no word straddles two chunks.
+            m_blksize = std::lcm(std::max(block_size(m_path_a), block_size(m_path_b)), MAX_WORD_LENGTH);
+            fillSize = align_fill(INITIAL_FILL_LENGTH, m_blksize, m_bsize);
+        }
+
+        if (readOptions.extentSize > 0)
+        {
+            // Chunks are fixed, so the consumer buffers only need one chunk.
+            m_bsize = fillSize;
+        }
+
+        // Two consumer buffers and the record scratch, plus either two reader
+        // buffers or the interleaved ring.
+        const std::size_t ioLength = io_length(m_bsize);
+        const std::size_t readLength = (readOptions.extentSize > 0)
+            ? InterleavedReader::getPoolSize(fillSize, readOptions.extentSize)
+            : 2 * ioLength;
 
-        m_reader_b = new Reader(m_path_b, bufferSize);
+        m_arena = new Arena((2 * ioLength) + readLength + SCRATCH_LENGTH);
 
-        m_buffer_a = new unsigned char[bufferSize]();
-        m_buffer_b = new unsigned char[bufferSize]();
+        m_buffer_a = m_arena->allocate<unsigned char>(m_bsize, IO_ALIGNMENT);
+        m_buffer_b = m_arena->allocate<unsigned char>(m_bsize, IO_ALIGNMENT);
+
+        if (readOptions.extentSize > 0)
+        {
+            m_interleaved = new InterleavedReader(
+                m_path_a,
+                m_path_b,
+                *m_arena,
+                fillSize,
+                readOptions.extentSize,
+                readOptions.keepCache,
+                m_start);
+
+            m_reader_a = &m_interleaved->getSourceA();
+            m_reader_b = &m_interleaved->getSourceB();
+        }
+        else
+        {
+            unsigned char* readBufferA = m_arena->allocate<unsigned char>(m_bsize, IO_ALIGNMENT);
+            unsigned char* readBufferB = m_arena->allocate<unsigned char>(m_bsize, IO_ALIGNMENT);
+
+            m_reader_a = new Reader(m_path_a, readBufferA, m_bsize, fillSize, readOptions.keepCache, m_start);
+
+            m_reader_b = new Reader(m_path_b, readBufferB, m_bsize, fillSize, readOptions.keepCache, m_start);
+        }
     }
     catch (const std::exception& e)
     {
@@ -108,7 +384,94 @@ std::uintmax_t bd::BitDiff::getFileBSize() const noexcept
     return m_fsize_b;
 }
 
-bd::diff_count bd::BitDiff::process(std::ostream& output, const bool printHeader, const DataOutType type)
+void bd::BitDiff::setCheckpoint(const Checkpoint* checkpoint) noexcept
+{
+    m_checkpoint = checkpoint;
+}
+
+void bd::BitDiff::setMask(const Mask* mask)
+{
+    if (mask != nullptr && !m_maskArena)
+    {
+        m_maskArena = std::make_unique<Arena>(io_length(m_bsize));
+        m_buffer_mask = m_maskArena->allocate<unsigned char>(m_bsize, IO_ALIGNMENT);
+    }
+
+    m_mask = mask;
+}
+
+void bd::BitDiff::setIndex(IndexWriter* index) noexcept
+{
+    m_index = index;
+}
+
+void bd::BitDiff::setFormatThreads(const std::size_t threads) noexcept
+{
+    m_formatThreads = threads;
+}
+
+void bd::BitDiff::resume(const checkpoint_s& state)
+{
+    const input_identity_s inputA = identify_input(m_path_a);
+    const input_identity_s inputB = identify_input(m_path_b);
+
+    if (state.inputA.path != inputA.path || state.inputB.path != inputB.path)
+    {
+        throw std::runtime_error("Checkpoint was written for other input files");
+    }
+
+    // Records before the offset would describe the old contents.
+    if (state.inputA != inputA || state.inputB != inputB)
+    {
+        throw std::runtime_error("An input changed since the checkpoint was written");
+    }
+
+    if (state.maskDigest != mask_digest(m_mask))
+    {
+        throw std::runtime_error("Checkpoint was written with a different mask");
+    }
+
+    if (state.offset != m_start)
+    {
+        throw std::runtime_error("Checkpoint offset does not match the read position");
+    }
+
+    m_start_count = { .bytes = state.diffBytes, .bits = state.diffBits };
+    m_start_type = state.type;
+    m_start_word = state.word;
+    m_resumed = true;
+}
+
+template<typename F, typename G>
+void bd::BitDiff::forEachChunk(F&& onChunk, G&& onBoundary)
+{
+    const chunk_pass_s pass = {
+        .readerA = *m_reader_a,
+        .readerB = *m_reader_b,
+        .bufferA = m_buffer_a,
+        .bufferB = m_buffer_b,
+        .mask = m_mask,
+        .bufferMask = m_buffer_mask,
+        .index = m_index,
+        .start = m_start,
+        .expected = std::min(m_fsize_a, m_fsize_b)
+    };
+
+    std::size_t fills = 0;
+    const auto beforeFill = [&]()
+    {
+        if (m_adaptive && fills++ == PROBE_FILLS)
+        {
+            resize_fills(*m_reader_a, *m_reader_b, m_blksize, m_bsize);
+        }
+    };
+
+    for_each_chunk(pass, beforeFill, onChunk, onBoundary);
+
+    std::cerr << "End of one or both files reached" << std::endl;
+}
+
+bd::diff_count bd::BitDiff::process(std::ostream& output, const bool printHeader, const DataOutType type, const word_format_s& word)
 {
     if (!m_valid)
     {
@@ -123,6 +486,17 @@ bd::diff_count bd::BitDiff::process(std::ostream& output, const bool printHeader
 
     output.exceptions(std::ostream::failbit | std::ostream::badbit);
 
+    OStreamSink sink(output);
+    return process(sink, printHeader, type, word);
+}
+
+bd::diff_count bd::BitDiff::process(Sink& output, const bool printHeader, const DataOutType type, const word_format_s& word)
+{
+    if (!m_valid)
+    {
+        throw std::runtime_error("Attempt to use invalid object");
+    }
+
     m_valid = false;
 
     if (m_fsize_a != m_fsize_b)
@@ -135,86 +509,183 @@ bd::diff_count bd::BitDiff::process(std::ostream& output, const bool printHeader
             << std::endl;
     }
 
-    // First, we need to read from each buffer.
-    std::uintmax_t bytesRead = 0;
-    bd::diff_count ret = { .bytes = 0, .bits = 0 };
+    bd::diff_count ret = m_start_count;
 
-    if (printHeader)
+    if (m_resumed && (m_start_type != type || m_start_word.size != word.size || m_start_word.endian != word.endian))
     {
-        output << "Offset\tByte in " << m_path_a << "\tByte in " << m_path_b;
-        m_newline(output);
+        throw std::runtime_error("Checkpoint was written with a different output mode");
     }
 
-    // Setup for output.
-    std::unique_ptr<bd::DataOut> optr;
-    switch (type)
-    {
-        case bd::DataOutType::Hex :
-            optr = std::make_unique<bd::HexDataOut>(OUT_DELIM);
-            break;
+    auto lastCheckpoint = std::chrono::steady_clock::now();
 
-        case bd::DataOutType::Binary :
-            optr = std::make_unique<bd::BinaryDataOut>(OUT_DELIM);
-            break;
-
-        default:
-            optr = std::make_unique<bd::BitDataOut>(OUT_DELIM);
-            break;
+    // Taken before the first read, so a resume sees any later change.
+    bd::input_identity_s inputA;
+    bd::input_identity_s inputB;
+    std::uint64_t maskDigest = 0;
+    if (m_checkpoint != nullptr)
+    {
+        inputA = identify_input(m_path_a);
+        inputB = identify_input(m_path_b);
+        maskDigest = mask_digest(m_mask);
     }
 
-    for (;;)
+    // A resumed output already has its header.
+    if (printHeader && !m_resumed)
     {
-        const std::size_t tmpA = m_reader_a->read(m_buffer_a);
-        const std::size_t tmpB = m_reader_b->read(m_buffer_b);
+        // Paths are quoted the same way operator<< would.
+        std::ostringstream header;
+        const char* unit = (word.size > 1) ? "Word" : "Byte";
+        header << "Offset\t" << unit << " in " << m_path_a << "\t" << unit << " in " << m_path_b;
 
-        const std::size_t tmpX = std::min(tmpA, tmpB);
+        const std::string tmp = header.str();
+        output.write(tmp.data(), tmp.size());
+        m_newline(output);
+    }
 
-        for (std::size_t i = 0; i < tmpX; ++i)
-        {
-            if (const unsigned char a = m_buffer_a[i], b = m_buffer_b[i]; a != b)
-            {
-                optr->init(bytesRead + static_cast<std::uintmax_t>(i), a, b);
+    // Setup for output.
+    const std::unique_ptr<bd::DataOut> optr = bd::make_data_out(type, OUT_DELIM, word.size, *m_arena);
 
-                // Counters
-                ++ret.bytes;
-                ret.bits += static_cast<std::uintmax_t>(optr->getDiffPopCount());
+    std::unique_ptr<FormatPipeline> pipeline;
+    if (m_fast && m_formatThreads > 1)
+    {
+        pipeline = std::make_unique<FormatPipeline>(output, type, word.size, m_formatThreads);
+    }
 
-                // We could use the stream operator, but a raw write is faster.
-                optr->print(output);
-                m_newline(output);
-            }
-        }
+    const record_writer_s records = {
+        .word = word,
+        .output = output,
+        .prefix = {},
+        .out = *optr,
+        .pipeline = pipeline.get(),
+        .newline = m_newline,
+        .count = ret
+    };
 
-        bytesRead += static_cast<std::uintmax_t>(tmpX);
+    const auto onChunk = [&](const std::uintmax_t base, const unsigned char* compareB, const std::size_t len)
+    {
+        records.chunk(base, m_buffer_a, m_buffer_b, compareB, len);
+    };
 
-        if (tmpA == 0 || tmpB == 0)
+    // Chunk boundaries are the only consistent points to save.
+    const auto onBoundary = [&](const std::uintmax_t bytesRead)
+    {
+        if (m_checkpoint == nullptr)
         {
-            std::cerr << "End of one or both files reached" << std::endl;
-            break;
+            return;
         }
 
-        if (tmpA != tmpB)
+        if (const auto now = std::chrono::steady_clock::now(); now - lastCheckpoint >= m_checkpoint->getInterval())
         {
-            throw std::runtime_error("Read mismatch encountered before end of file reached");
+            // Records must be durable before the checkpoint claims them.
+            if (pipeline)
+            {
+                pipeline->drain();
+            }
+
+            output.persist();
+
+            m_checkpoint->save({
+                .inputA = inputA,
+                .inputB = inputB,
+                .type = type,
+                .word = word,
+                .maskDigest = maskDigest,
+                .offset = bytesRead,
+                .diffBytes = ret.bytes,
+                .diffBits = ret.bits,
+                .outputOffset = output.tell()
+            });
+
+            lastCheckpoint = now;
         }
+    };
+
+    forEachChunk(onChunk, onBoundary);
+
+    if (pipeline)
+    {
+        pipeline->drain();
+    }
+
+    output.flush();
+
+    return ret;
+}
+
+bd::diff_count bd::BitDiff::writePatch(Sink& output)
+{
+    if (!m_valid)
+    {
+        throw std::runtime_error("Attempt to use invalid object");
     }
 
-    if (const std::uintmax_t expected = std::min(m_fsize_a, m_fsize_b); bytesRead != expected)
+    m_valid = false;
+
+    if (m_fsize_a != m_fsize_b)
     {
-        std::string err;
-        err.append("Bytes read ");
-        err.append(std::to_string(bytesRead));
-        err.append(" not equal to expected ");
-        err.append(std::to_string(expected));
+        throw std::runtime_error("Patch mode requires inputs of equal size");
+    }
 
-        throw std::runtime_error(err);
+    if (m_resumed || m_checkpoint != nullptr || m_start != 0)
+    {
+        throw std::runtime_error("Patch mode cannot be checkpointed");
     }
 
-    return ret;
+    // A masked patch would not rebuild B, yet its B hash would verify.
+    if (m_mask != nullptr)
+    {
+        throw std::runtime_error("Patch mode cannot apply a mask");
+    }
+
+    PatchWriter patch(output, m_fsize_a);
+
+    forEachChunk(
+        [&](const std::uintmax_t base, const unsigned char*, const std::size_t len) { patch.update(base, m_buffer_a, m_buffer_b, len); },
+        [](std::uintmax_t) {});
+
+    return patch.finish();
+}
+
+std::uint64_t bd::BitDiff::writeBlockMap(Sink& output, const std::size_t blockSize, const bool list)
+{
+    if (!m_valid)
+    {
+        throw std::runtime_error("Attempt to use invalid object");
+    }
+
+    m_valid = false;
+
+    if (m_fsize_a != m_fsize_b)
+    {
+        throw std::runtime_error("Block maps require inputs of equal size");
+    }
+
+    if (m_resumed || m_checkpoint != nullptr || m_start != 0)
+    {
+        throw std::runtime_error("Block maps cannot be checkpointed");
+    }
+
+    BlockMapWriter map(output, m_fsize_a, blockSize, list);
+
+    forEachChunk(
+        [&](const std::uintmax_t base, const unsigned char* compareB, const std::size_t len) { map.update(base, m_buffer_a, compareB, len); },
+        [](std::uintmax_t) {});
+
+    return map.finish();
 }
 
 void bd::BitDiff::cleanup() noexcept
 {
+    if (m_interleaved != nullptr)
+    {
+        delete m_interleaved;
+        m_interleaved = nullptr;
+
+        // These were its ports.
+        m_reader_a = nullptr;
+        m_reader_b = nullptr;
+    }
+
     if (m_reader_a != nullptr)
     {
         delete m_reader_a;
@@ -227,17 +698,207 @@ void bd::BitDiff::cleanup() noexcept
         m_reader_b = nullptr;
     }
 
-    if (m_buffer_a != nullptr)
+    // Readers are gone, so nothing references the arena anymore.
+    m_buffer_a = nullptr;
+    m_buffer_b = nullptr;
+
+    if (m_arena != nullptr)
+    {
+        delete m_arena;
+        m_arena = nullptr;
+    }
+
+    m_valid = false;
+}
+
+//
+// SESSION
+//
+
+bd::DiffSession::~DiffSession() = default;
+
+bd::DiffSession::DiffSession(const read_options& readOptions, const bool fastMode) :
+    m_bsize(readOptions.bufferSize),
+    m_fillSize(readOptions.adaptive ? std::min(INITIAL_FILL_LENGTH, readOptions.bufferSize) : readOptions.bufferSize),
+    m_fills(0),
+    m_pairs(0),
+    m_mask(nullptr),
+    m_formatThreads(1),
+    m_arena((4 * io_length(readOptions.bufferSize)) + (FORMATTERS * SCRATCH_LENGTH)),
+    m_buffer_a(m_arena.allocate<unsigned char>(m_bsize, IO_ALIGNMENT)),
+    m_buffer_b(m_arena.allocate<unsigned char>(m_bsize, IO_ALIGNMENT)),
+    m_buffer_mask(nullptr),
+    m_pipelineOutput(nullptr),
+    m_pipelineType(DataOutType::Hex),
+    m_pipelineWord(0),
+    m_newline((fastMode) ? newline<true> : newline<false>),
+    m_fast(fastMode),
+    m_adaptive(readOptions.adaptive)
+{
+    if (readOptions.extentSize != 0 || readOptions.startOffset != 0)
+    {
+        throw std::runtime_error("Diff sessions do not support extents or a start offset");
+    }
+
+    unsigned char* readBufferA = m_arena.allocate<unsigned char>(m_bsize, IO_ALIGNMENT);
+    unsigned char* readBufferB = m_arena.allocate<unsigned char>(m_bsize, IO_ALIGNMENT);
+
+    m_reader_a = std::make_unique<Reader>("read A", readBufferA, m_bsize, m_fillSize, readOptions.keepCache);
+    m_reader_b = std::make_unique<Reader>("read B", readBufferB, m_bsize, m_fillSize, readOptions.keepCache);
+}
+
+std::uintmax_t bd::DiffSession::getPairCount() const noexcept
+{
+    return m_pairs;
+}
+
+void bd::DiffSession::setMask(const Mask* mask)
+{
+    if (mask != nullptr && !m_maskArena)
     {
-        delete[] m_buffer_a;
-        m_buffer_a = nullptr;
+        m_maskArena = std::make_unique<Arena>(io_length(m_bsize));
+        m_buffer_mask = m_maskArena->allocate<unsigned char>(m_bsize, IO_ALIGNMENT);
     }
 
-    if (m_buffer_b != nullptr)
+    m_mask = mask;
+}
+
+void bd::DiffSession::setFormatThreads(const std::size_t threads) noexcept
+{
+    m_formatThreads = threads;
+}
+
+bd::DataOut& bd::DiffSession::getOut(const DataOutType type, const std::size_t wordSize)
+{
+    static_assert(FORMATTERS == 3 * 4);
+
+    const std::size_t i = (static_cast<std::size_t>(type) * 4) + static_cast<std::size_t>(std::countr_zero(wordSize));
+
+    if (!m_outs[i])
     {
-        delete[] m_buffer_b;
-        m_buffer_b = nullptr;
+        m_outs[i] = make_data_out(type, OUT_DELIM, wordSize, m_arena);
     }
 
-    m_valid = false;
+    return *m_outs[i];
+}
+
+bd::FormatPipeline* bd::DiffSession::getPipeline(Sink& output, const DataOutType type, const std::size_t wordSize)
+{
+    if (!m_fast || m_formatThreads <= 1)
+    {
+        return nullptr;
+    }
+
+    // Every pair drains it, so only its threads are carried over.
+    if (!m_pipeline || m_pipelineOutput != &output || m_pipelineType != type || m_pipelineWord != wordSize)
+    {
+        m_pipeline.reset();
+        m_pipeline = std::make_unique<FormatPipeline>(output, type, wordSize, m_formatThreads);
+        m_pipelineOutput = &output;
+        m_pipelineType = type;
+        m_pipelineWord = wordSize;
+    }
+
+    return m_pipeline.get();
+}
+
+bd::diff_count bd::DiffSession::diff(
+    const std::string_view a,
+    const std::string_view b,
+    Sink& output,
+    const std::string_view prefix,
+    const DataOutType type,
+    const word_format_s& word)
+{
+    const fs::path pathA(a);
+    const fs::path pathB(b);
+
+    const std::uintmax_t sizeA = fs::file_size(pathA);
+    const std::uintmax_t sizeB = fs::file_size(pathB);
+
+    if (sizeA != sizeB)
+    {
+        std::cerr
+            << pathA << " (" << sizeA << ")"
+            << " and "
+            << pathB << " (" << sizeB << ")"
+            << " differ in size; diff will end at smaller size"
+            << std::endl;
+    }
+
+    // Whole words per fill, so no word straddles two chunks.
+    const std::size_t block = (m_adaptive) ? std::lcm(std::max(block_size(pathA), block_size(pathB)), MAX_WORD_LENGTH) : 1;
+    const std::size_t fillSize = (m_adaptive) ? align_fill(m_fillSize, block, m_bsize) : m_bsize;
+
+    m_reader_a->setFillSize(fillSize);
+    m_reader_b->setFillSize(fillSize);
+
+    m_reader_a->open(pathA, 0);
+    m_reader_b->open(pathB, 0);
+
+    FormatPipeline* pipeline = getPipeline(output, type, word.size);
+    if (pipeline != nullptr)
+    {
+        pipeline->setPrefix(prefix);
+    }
+
+    diff_count ret = { .bytes = 0, .bits = 0 };
+
+    const record_writer_s records = {
+        .word = word,
+        .output = output,
+        .prefix = prefix,
+        .out = getOut(type, word.size),
+        .pipeline = pipeline,
+        .newline = m_newline,
+        .count = ret
+    };
+
+    // Offsets restart with every pair, which an index cannot represent.
+    const chunk_pass_s pass = {
+        .readerA = *m_reader_a,
+        .readerB = *m_reader_b,
+        .bufferA = m_buffer_a,
+        .bufferB = m_buffer_b,
+        .mask = m_mask,
+        .bufferMask = m_buffer_mask,
+        .index = nullptr,
+        .start = 0,
+        .expected = std::min(sizeA, sizeB)
+    };
+
+    // The read size is measured once, over the first fills of the session.
+    const auto beforeFill = [&]()
+    {
+        if (m_adaptive && m_fills++ == PROBE_FILLS)
+        {
+            if (const std::size_t size = resize_fills(*m_reader_a, *m_reader_b, block, m_bsize); size > 0)
+            {
+                m_fillSize = size;
+            }
+        }
+    };
+
+    try
+    {
+        for_each_chunk(pass, beforeFill,
+            [&](const std::uintmax_t base, const unsigned char* compareB, const std::size_t len) { records.chunk(base, m_buffer_a, m_buffer_b, compareB, len); },
+            [](std::uintmax_t) {});
+
+        if (pipeline != nullptr)
+        {
+            pipeline->drain();
+        }
+    }
+    catch (...)
+    {
+        // Like BitDiff::process, a failed pair drops the records still
+        // being formatted; the next pair starts a new pipeline.
+        m_pipeline.reset();
+        throw;
+    }
+
+    ++m_pairs;
+
+    return ret;
 }
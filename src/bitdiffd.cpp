@@ -0,0 +1,126 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+#include <boost/program_options.hpp>
+
+#include "bitdiff/daemon.hpp"
+#include "bitdiff/fd.hpp"
+#include "bitdiff/kernel.hpp"
+#include "bitdiff/version.hpp"
+
+namespace po = boost::program_options;
+namespace bd = isaki::bitdiff;
+namespace fs = std::filesystem;
+
+namespace
+{
+    // Default bytes of baselines kept mapped, in MiB.
+    constexpr std::size_t CACHE_MIB = 4096;
+
+    std::string argv_basename(const char* name)
+    {
+        const std::string_view tmp(name);
+        const fs::path p(tmp);
+        return p.filename().string();
+    }
+
+    void print_help(std::ostream& os, const std::string_view name, const po::options_description& desc)
+    {
+        os << name << " --socket <path>\n" << std::endl;
+        os << "Serves bitdiff --daemon requests, keeping baseline files mapped between them." << std::endl;
+        os << desc << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        po::options_description desc("Options");
+        desc.add_options()
+            ("help,h", "Print this message.")
+            ("version,v", "Display version information.")
+            ("socket,s", po::value<std::string>(), "Unix domain socket to listen on.")
+            ("threads,j", po::value<std::size_t>(), "Requests served at once (default: one per CPU).")
+            ("cache-size", po::value<std::size_t>(), "MiB of baseline files kept mapped between requests (default: 4096).")
+        ;
+
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
+        po::notify(vm);
+
+        if (vm.contains("version"))
+        {
+            const std::string name = argv_basename(argv[0]);
+            bd::print_version(std::cout, name);
+            return 0;
+        }
+
+        if (vm.contains("help")) {
+            const std::string name = argv_basename(argv[0]);
+            print_help(std::cout, name, desc);
+            return 0;
+        }
+
+        if (!vm.contains("socket"))
+        {
+            std::cerr << "Invalid usage; please run with --help" << std::endl;
+            return 1;
+        }
+
+        // Blocked before any thread starts so every thread inherits the mask
+        // and the signals only arrive through the signalfd.
+        sigset_t stopSignals;
+        sigemptyset(&stopSignals);
+        sigaddset(&stopSignals, SIGINT);
+        sigaddset(&stopSignals, SIGTERM);
+
+        if (::sigprocmask(SIG_BLOCK, &stopSignals, nullptr) != 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "Unable to block signals");
+        }
+
+        const bd::FileDescriptor stop(::signalfd(-1, &stopSignals, SFD_CLOEXEC));
+        if (stop.get() < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "Unable to create signalfd");
+        }
+
+        // A client that disconnects early fails its own request only.
+        std::signal(SIGPIPE, SIG_IGN);
+
+        const std::size_t threads = vm.contains("threads") ? vm["threads"].as<std::size_t>() : 0;
+        const std::size_t cacheMiB = vm.contains("cache-size") ? vm["cache-size"].as<std::size_t>() : CACHE_MIB;
+
+        const fs::path socket(vm["socket"].as<std::string>());
+        bd::DiffDaemon daemon(socket, threads, static_cast<std::uintmax_t>(cacheMiB) << 20);
+
+        std::cerr << "Listening on " << socket << " with the " << bd::get_kernel_name() << " compare and "
+            << bd::get_bit_kernel_name() << " bit kernels" << std::endl;
+
+        daemon.serve(stop.get());
+
+        std::cerr << "Served " << daemon.getServedCount() << " request" << ((daemon.getServedCount() != 1) ? "s" : "") << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 10;
+    }
+
+    return 0;
+}
@@ -0,0 +1,228 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <iostream>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <boost/program_options.hpp>
+
+#include "bitdiff/fd.hpp"
+#include "bitdiff/hash.hpp"
+#include "bitdiff/patch.hpp"
+#include "bitdiff/version.hpp"
+
+namespace po = boost::program_options;
+namespace bd = isaki::bitdiff;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr std::size_t HASH_BUFFER_LENGTH = 16 * 1024 * 1024;
+
+    std::string argv_basename(const char* name)
+    {
+        const std::string_view tmp(name);
+        const fs::path p(tmp);
+        return p.filename().string();
+    }
+
+    void print_help(std::ostream& os, const std::string_view name, const po::options_description& desc)
+    {
+        os << name << " <file> <patch>\n" << std::endl;
+        os << "Applies a patch written by bitdiff -m p to file, in place." << std::endl;
+        os << desc << std::endl;
+    }
+
+    std::uint64_t hash_file(const int fd)
+    {
+#ifdef POSIX_FADV_SEQUENTIAL
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+        const std::unique_ptr<unsigned char[]> buffer(new unsigned char[HASH_BUFFER_LENGTH]);
+
+        bd::Hash64 hash;
+        off_t offset = 0;
+
+        for (;;)
+        {
+            const ssize_t got = ::pread(fd, buffer.get(), HASH_BUFFER_LENGTH, offset);
+            if (got < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                throw std::system_error(errno, std::generic_category(), "Read failure");
+            }
+
+            if (got == 0)
+            {
+                break;
+            }
+
+            hash.update(buffer.get(), static_cast<std::size_t>(got));
+            offset += got;
+        }
+
+        return hash.digest();
+    }
+
+    void pwrite_all(const int fd, const unsigned char* data, const std::size_t len, const std::uint64_t offset)
+    {
+        std::size_t done = 0;
+        while (done < len)
+        {
+            const ssize_t n = ::pwrite(fd, data + done, len - done, static_cast<off_t>(offset + done));
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                throw std::system_error(errno, std::generic_category(), "Write failure");
+            }
+
+            done += static_cast<std::size_t>(n);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::ios_base::sync_with_stdio(false);
+
+    try
+    {
+        po::options_description desc("Options");
+        desc.add_options()
+            ("help,h", "Print this message.")
+            ("version,v", "Display version information.")
+            ("skip-source-check", "Do not verify file against the patch before writing. Saves a full read.")
+        ;
+
+        po::options_description hidden("Hidden options");
+        hidden.add_options()
+            ("file", po::value<std::string>(), "The file to patch")
+            ("patch", po::value<std::string>(), "The patch to apply")
+        ;
+
+        po::options_description all;
+        all.add(desc).add(hidden);
+
+        po::positional_options_description posdesc;
+        posdesc.add("file", 1);
+        posdesc.add("patch", 2);
+
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(all).positional(posdesc).run(), vm);
+        po::notify(vm);
+
+        if (vm.contains("version"))
+        {
+            const std::string name = argv_basename(argv[0]);
+            bd::print_version(std::cout, name);
+            return 0;
+        }
+
+        if (vm.contains("help")) {
+            const std::string name = argv_basename(argv[0]);
+            print_help(std::cout, name, desc);
+            return 0;
+        }
+
+        if (!vm.contains("file") || !vm.contains("patch"))
+        {
+            std::cerr << "Invalid usage; please run with --help" << std::endl;
+            return 1;
+        }
+
+        const fs::path file(vm["file"].as<std::string>());
+
+        bd::PatchReader patch(vm["patch"].as<std::string>());
+        const bd::patch_trailer_s& trailer = patch.getTrailer();
+
+        if (fs::file_size(file) != patch.getSize())
+        {
+            std::cerr << file << " is not " << patch.getSize() << " bytes long" << std::endl;
+            return 10;
+        }
+
+        const bd::FileDescriptor target(::open(file.c_str(), O_RDWR | O_CLOEXEC));
+        if (target.get() < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "Unable to open " + file.string());
+        }
+
+        if (!vm.contains("skip-source-check"))
+        {
+            std::cerr << "Verifying " << file << std::endl;
+
+            if (const std::uint64_t hash = hash_file(target.get()); hash != trailer.hashA)
+            {
+                if (hash == trailer.hashB)
+                {
+                    std::cerr << "Patch is already applied" << std::endl;
+                    return 0;
+                }
+
+                std::cerr << file << " does not match the patch source" << std::endl;
+                return 10;
+            }
+        }
+
+        std::cerr << "Applying " << trailer.records << " record";
+        if (trailer.records != 1)
+        {
+            std::cerr << "s";
+        }
+
+        std::cerr << std::endl;
+
+        std::vector<unsigned char> data;
+        std::uint64_t offset = 0;
+        std::uintmax_t written = 0;
+
+        while (patch.next(offset, data))
+        {
+            pwrite_all(target.get(), data.data(), data.size(), offset);
+            written += data.size();
+        }
+
+        if (::fdatasync(target.get()) != 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "Unable to sync " + file.string());
+        }
+
+        std::cerr << "Wrote " << written << " bytes; verifying result" << std::endl;
+
+        if (hash_file(target.get()) != trailer.hashB)
+        {
+            std::cerr << "Patched file does not match the patch target" << std::endl;
+            return 10;
+        }
+
+        std::cerr << "Patch applied" << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 10;
+    }
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+#include "bitdiff/endian.hpp"
+#include "bitdiff/kernel.hpp"
+#include "bitdiff/sink.hpp"
+#include "bitdiff/blockmap.hpp"
+
+namespace bd = isaki::bitdiff;
+
+namespace
+{
+    constexpr std::string_view MAGIC = "BITBLOCK";
+    constexpr std::uint32_t FORMAT_VERSION = 1;
+
+    constexpr std::size_t HEADER_LENGTH = 40;
+
+    void write_bytes(bd::Sink& output, const unsigned char* data, const std::size_t len)
+    {
+        output.write(reinterpret_cast<const char*>(data), len);
+    }
+}
+
+bd::BlockMapWriter::~BlockMapWriter() = default;
+
+std::uint64_t bd::BlockMapWriter::validateBlockSize(const std::size_t blockSize)
+{
+    if (blockSize == 0)
+    {
+        throw std::runtime_error("Block size must not be zero");
+    }
+
+    return blockSize;
+}
+
+bd::BlockMapWriter::BlockMapWriter(Sink& output, const std::uintmax_t size, const std::size_t blockSize, const bool list) :
+    m_output(output),
+    m_blockSize(validateBlockSize(blockSize)),
+    m_blocks((size / m_blockSize) + ((size % m_blockSize != 0) ? 1 : 0)),
+    m_list(list),
+    m_block(0),
+    m_dirty(false),
+    m_bits(0),
+    m_count(0)
+{
+    if (m_list)
+    {
+        return;
+    }
+
+    unsigned char header[HEADER_LENGTH];
+    std::memcpy(header, MAGIC.data(), MAGIC.size());
+    bd::store_le32(header + 8, FORMAT_VERSION);
+    bd::store_le32(header + 12, 0);
+    bd::store_le64(header + 16, size);
+    bd::store_le64(header + 24, m_blockSize);
+    bd::store_le64(header + 32, m_blocks);
+
+    write_bytes(m_output, header, sizeof(header));
+}
+
+void bd::BlockMapWriter::update(const std::uintmax_t base, const unsigned char* a, const unsigned char* b, const std::size_t len)
+{
+    std::size_t pos = 0;
+    while (pos < len)
+    {
+        const std::uintmax_t blockEnd = (m_block + 1) * m_blockSize;
+        const auto take = static_cast<std::size_t>(std::min<std::uintmax_t>(len - pos, blockEnd - (base + pos)));
+
+        if (!m_dirty && find_difference(a + pos, b + pos, take) < take)
+        {
+            m_dirty = true;
+        }
+
+        pos += take;
+
+        if (base + pos == blockEnd)
+        {
+            close(m_dirty);
+        }
+    }
+}
+
+void bd::BlockMapWriter::close(const bool dirty)
+{
+    if (dirty)
+    {
+        ++m_count;
+
+        if (m_list)
+        {
+            char line[24];
+            char* end = std::to_chars(line, line + sizeof(line) - 1, m_block).ptr;
+            *end++ = '\n';
+            m_output.write(line, static_cast<std::size_t>(end - line));
+        }
+        else
+        {
+            m_bits |= static_cast<unsigned char>(1U << (m_block % 8));
+        }
+    }
+
+    if (!m_list && m_block % 8 == 7)
+    {
+        write_bytes(m_output, &m_bits, 1);
+        m_bits = 0;
+    }
+
+    ++m_block;
+    m_dirty = false;
+}
+
+std::uint64_t bd::BlockMapWriter::finish()
+{
+    // A short last block never reaches its end in update().
+    if (m_block + 1 == m_blocks)
+    {
+        close(m_dirty);
+    }
+
+    if (m_block != m_blocks)
+    {
+        throw std::runtime_error("Block map input ended early");
+    }
+
+    if (!m_list)
+    {
+        if (m_blocks % 8 != 0)
+        {
+            write_bytes(m_output, &m_bits, 1);
+        }
+
+        unsigned char trailer[8];
+        bd::store_le64(trailer, m_count);
+        write_bytes(m_output, trailer, sizeof(trailer));
+    }
+
+    m_output.flush();
+
+    return m_count;
+}
@@ -0,0 +1,244 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bitdiff/fd.hpp"
+#include "bitdiff/checkpoint.hpp"
+
+namespace bd = isaki::bitdiff;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr std::string_view MAGIC = "bitdiff-checkpoint";
+    // 2 added the input and mask identities.
+    constexpr int FORMAT_VERSION = 2;
+
+    constexpr std::uintmax_t NANOS_PER_SECOND = 1000000000;
+
+    void write_all(const int fd, const std::string& data)
+    {
+        std::size_t done = 0;
+        while (done < data.size())
+        {
+            const ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                throw std::system_error(errno, std::generic_category(), "Unable to write checkpoint");
+            }
+
+            done += static_cast<std::size_t>(n);
+        }
+    }
+
+    void append_field(std::string& out, const std::string_view key, const std::uintmax_t value)
+    {
+        out.append(key);
+        out.push_back(' ');
+        out.append(std::to_string(value));
+        out.push_back('\n');
+    }
+
+    // Quoted, so paths may hold spaces and newlines.
+    void append_field(std::string& out, const std::string_view key, const std::string& value)
+    {
+        std::ostringstream field;
+        field << key << ' ' << std::quoted(value) << '\n';
+        out.append(field.str());
+    }
+
+    [[noreturn]] void malformed(const std::string_view key)
+    {
+        std::string err;
+        err.append("Malformed checkpoint; expected ");
+        err.append(key);
+        throw std::runtime_error(err);
+    }
+
+    std::uintmax_t read_field(std::istream& in, const std::string_view key)
+    {
+        std::string name;
+        std::uintmax_t value = 0;
+
+        if (!(in >> name >> value) || name != key)
+        {
+            malformed(key);
+        }
+
+        return value;
+    }
+
+    std::string read_text_field(std::istream& in, const std::string_view key)
+    {
+        std::string name;
+        std::string value;
+
+        if (!(in >> name >> std::quoted(value)) || name != key)
+        {
+            malformed(key);
+        }
+
+        return value;
+    }
+
+    void append_input(std::string& out, const char suffix, const bd::input_identity_s& input)
+    {
+        const auto key = [suffix](const std::string_view name) { return std::string(name) + '_' + suffix; };
+
+        append_field(out, key("path"), input.path);
+        append_field(out, key("size"), input.size);
+        append_field(out, key("device"), input.device);
+        append_field(out, key("inode"), input.inode);
+        append_field(out, key("mtime"), input.mtime);
+    }
+
+    bd::input_identity_s read_input(std::istream& in, const char suffix)
+    {
+        const auto key = [suffix](const std::string_view name) { return std::string(name) + '_' + suffix; };
+
+        bd::input_identity_s ret;
+        ret.path = read_text_field(in, key("path"));
+        ret.size = read_field(in, key("size"));
+        ret.device = read_field(in, key("device"));
+        ret.inode = read_field(in, key("inode"));
+        ret.mtime = read_field(in, key("mtime"));
+
+        return ret;
+    }
+}
+
+bd::input_identity_s bd::identify_input(const fs::path& file)
+{
+    struct stat st{};
+    if (::stat(file.c_str(), &st) != 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Unable to stat " + file.string());
+    }
+
+    return {
+        .path = fs::absolute(file).lexically_normal().string(),
+        .size = static_cast<std::uintmax_t>(st.st_size),
+        .device = static_cast<std::uintmax_t>(st.st_dev),
+        .inode = static_cast<std::uintmax_t>(st.st_ino),
+        .mtime = (static_cast<std::uintmax_t>(st.st_mtim.tv_sec) * NANOS_PER_SECOND) + static_cast<std::uintmax_t>(st.st_mtim.tv_nsec)
+    };
+}
+
+bd::Checkpoint::~Checkpoint() = default;
+
+bd::Checkpoint::Checkpoint(const fs::path& file, const std::chrono::seconds interval) :
+    m_file(file),
+    m_temp(file),
+    m_interval(interval)
+{
+    m_temp += ".tmp";
+}
+
+bd::checkpoint_s bd::Checkpoint::load() const
+{
+    std::ifstream in(m_file);
+    if (!in.is_open())
+    {
+        std::string err;
+        err.append("Unable to open checkpoint ");
+        err.append(m_file.string());
+        throw std::runtime_error(err);
+    }
+
+    if (read_field(in, MAGIC) != FORMAT_VERSION)
+    {
+        throw std::runtime_error("Unsupported checkpoint version");
+    }
+
+    checkpoint_s ret{};
+    ret.inputA = read_input(in, 'a');
+    ret.inputB = read_input(in, 'b');
+    ret.type = static_cast<DataOutType>(read_field(in, "mode"));
+    ret.word.size = static_cast<std::size_t>(read_field(in, "word_size"));
+    ret.word.endian = static_cast<Endian>(read_field(in, "endian"));
+    ret.maskDigest = static_cast<std::uint64_t>(read_field(in, "mask_digest"));
+    ret.offset = read_field(in, "offset");
+    ret.diffBytes = read_field(in, "diff_bytes");
+    ret.diffBits = read_field(in, "diff_bits");
+    ret.outputOffset = read_field(in, "output_offset");
+
+    return ret;
+}
+
+void bd::Checkpoint::save(const checkpoint_s& state) const
+{
+    std::string data;
+    append_field(data, MAGIC, FORMAT_VERSION);
+    append_input(data, 'a', state.inputA);
+    append_input(data, 'b', state.inputB);
+    append_field(data, "mode", static_cast<std::uintmax_t>(state.type));
+    append_field(data, "word_size", state.word.size);
+    append_field(data, "endian", static_cast<std::uintmax_t>(state.word.endian));
+    append_field(data, "mask_digest", state.maskDigest);
+    append_field(data, "offset", state.offset);
+    append_field(data, "diff_bytes", state.diffBytes);
+    append_field(data, "diff_bits", state.diffBits);
+    append_field(data, "output_offset", state.outputOffset);
+
+    bd::FileDescriptor out(::open(m_temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666));
+    if (out.get() < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Unable to create checkpoint");
+    }
+
+    write_all(out.get(), data);
+
+    // The contents must be durable before the rename makes them visible.
+    if (::fsync(out.get()) != 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Unable to sync checkpoint");
+    }
+
+    if (out.close() != 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Unable to close checkpoint");
+    }
+
+    fs::rename(m_temp, m_file);
+
+    // Persist the rename itself.
+    const fs::path parent = m_file.has_parent_path() ? m_file.parent_path() : fs::path(".");
+    if (const bd::FileDescriptor dir(::open(parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)); dir.get() >= 0)
+    {
+        ::fsync(dir.get());
+    }
+}
+
+void bd::Checkpoint::remove() const
+{
+    std::error_code ec;
+    fs::remove(m_file, ec);
+    fs::remove(m_temp, ec);
+}
+
+std::chrono::seconds bd::Checkpoint::getInterval() const noexcept
+{
+    return m_interval;
+}
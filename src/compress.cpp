@@ -0,0 +1,247 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <zlib.h>
+
+#ifdef BITDIFF_HAVE_ZSTD
+    #include <zstd.h>
+#endif
+
+#include "bitdiff/pool.hpp"
+#include "bitdiff/sink.hpp"
+#include "bitdiff/trace.hpp"
+#include "bitdiff/compress.hpp"
+
+namespace bd = isaki::bitdiff;
+
+namespace
+{
+    // Compression unit. Large enough that the per block header and the
+    // cold dictionary cost nothing measurable.
+    constexpr std::size_t BLOCK_LENGTH = 4 * 1024 * 1024;
+
+    constexpr std::size_t STAGING_LENGTH = 256 * 1024;
+
+    // Blocks allowed in flight per worker; bounds memory to a few blocks
+    // per thread.
+    constexpr std::size_t WINDOW_PER_THREAD = 2;
+
+    // Diff text is repetitive; the fast levels already get most of the
+    // ratio and keep the workers ahead of the compare loop.
+    constexpr int GZIP_LEVEL = 3;
+    constexpr int ZSTD_LEVEL = 3;
+
+    // gzip wrapper rather than raw zlib.
+    constexpr int GZIP_WINDOW_BITS = MAX_WBITS + 16;
+    constexpr int GZIP_MEM_LEVEL = 8;
+
+    void gzip_block(const std::string& in, std::string& out)
+    {
+        z_stream z{};
+        if (::deflateInit2(&z, GZIP_LEVEL, Z_DEFLATED, GZIP_WINDOW_BITS, GZIP_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            throw std::runtime_error("Unable to initialize gzip");
+        }
+
+        out.resize(::deflateBound(&z, static_cast<uLong>(in.size())));
+
+        z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+        z.avail_in = static_cast<uInt>(in.size());
+        z.next_out = reinterpret_cast<Bytef*>(out.data());
+        z.avail_out = static_cast<uInt>(out.size());
+
+        const int rc = ::deflate(&z, Z_FINISH);
+        const auto written = static_cast<std::size_t>(z.total_out);
+        ::deflateEnd(&z);
+
+        if (rc != Z_STREAM_END)
+        {
+            throw std::runtime_error("gzip compression failed");
+        }
+
+        out.resize(written);
+    }
+
+#ifdef BITDIFF_HAVE_ZSTD
+    void zstd_block(const std::string& in, std::string& out)
+    {
+        out.resize(::ZSTD_compressBound(in.size()));
+
+        const std::size_t written = ::ZSTD_compress(out.data(), out.size(), in.data(), in.size(), ZSTD_LEVEL);
+        if (::ZSTD_isError(written))
+        {
+            std::string err;
+            err.append("zstd compression failed: ");
+            err.append(::ZSTD_getErrorName(written));
+            throw std::runtime_error(err);
+        }
+
+        out.resize(written);
+    }
+#endif
+}
+
+bool bd::codec_available(const Codec codec) noexcept
+{
+    switch (codec)
+    {
+        case Codec::Gzip:
+            return true;
+
+        case Codec::Zstd:
+#ifdef BITDIFF_HAVE_ZSTD
+            return true;
+#else
+            return false;
+#endif
+    }
+
+    return false;
+}
+
+bd::CompressSink::~CompressSink() = default;
+
+bd::CompressSink::CompressSink(Sink& output, const Codec codec, const std::size_t threads) :
+    m_output(output),
+    m_codec(codec),
+    m_buffer(new char[STAGING_LENGTH]),
+    m_window(0),
+    m_pool(threads, TaskOrder::OldestFirst)
+{
+    if (!codec_available(codec))
+    {
+        throw std::runtime_error("This build does not support the requested compression");
+    }
+
+    m_window = m_pool.getThreadCount() * WINDOW_PER_THREAD;
+    m_pending.reserve(BLOCK_LENGTH + STAGING_LENGTH);
+
+    setBuffer(m_buffer.get(), STAGING_LENGTH);
+}
+
+void bd::CompressSink::commit(const char* staged, const std::size_t stagedLen, const char* data, const std::size_t len)
+{
+    m_pending.append(staged, stagedLen);
+    m_pending.append(data, len);
+
+    if (m_pending.size() >= BLOCK_LENGTH)
+    {
+        submit();
+    }
+}
+
+void bd::CompressSink::syncData()
+{
+    if (!m_pending.empty())
+    {
+        submit();
+    }
+
+    drain(true);
+    m_output.persist();
+}
+
+void bd::CompressSink::close()
+{
+    flush();
+
+    // Nothing written means nothing to compress; no empty member either.
+    if (!m_pending.empty())
+    {
+        submit();
+    }
+
+    drain(true);
+    m_output.flush();
+}
+
+void bd::CompressSink::submit()
+{
+    auto block = std::make_unique<block_s>();
+    block->in.swap(m_pending);
+    block->done = false;
+
+    m_pending.reserve(BLOCK_LENGTH + STAGING_LENGTH);
+
+    block_s* b = block.get();
+    {
+        std::scoped_lock<std::mutex> lock(m_mtx);
+        m_blocks.push_back(std::move(block));
+    }
+
+    m_pool.submit([this, b](std::size_t)
+    {
+        try
+        {
+            const TraceSpan span("compress");
+
+            if (m_codec == Codec::Gzip)
+            {
+                gzip_block(b->in, b->out);
+            }
+#ifdef BITDIFF_HAVE_ZSTD
+            else
+            {
+                zstd_block(b->in, b->out);
+            }
+#endif
+        }
+        catch (...)
+        {
+            b->error = std::current_exception();
+        }
+
+        // The input is no longer needed; release it before the write.
+        std::string().swap(b->in);
+
+        std::scoped_lock<std::mutex> lock(m_mtx);
+        b->done = true;
+        m_done.notify_all();
+    });
+
+    drain(false);
+}
+
+void bd::CompressSink::drain(const bool all)
+{
+    while (true)
+    {
+        std::unique_ptr<block_s> block;
+        {
+            std::unique_lock<std::mutex> lock(m_mtx);
+            if (m_blocks.empty())
+            {
+                return;
+            }
+
+            if (!m_blocks.front()->done)
+            {
+                if (!all && m_blocks.size() <= m_window)
+                {
+                    return;
+                }
+
+                const TraceSpan span("wait");
+                m_done.wait(lock, [this] { return m_blocks.front()->done; });
+            }
+
+            block = std::move(m_blocks.front());
+            m_blocks.pop_front();
+        }
+
+        if (block->error)
+        {
+            std::rethrow_exception(block->error);
+        }
+
+        m_output.write(block->out.data(), block->out.size());
+    }
+}
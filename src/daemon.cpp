@@ -0,0 +1,628 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "bitdiff/fd.hpp"
+#include "bitdiff/reader.hpp"
+#include "bitdiff/trace.hpp"
+#include "bitdiff/daemon.hpp"
+
+namespace bd = isaki::bitdiff;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr char OUT_DELIM = '\t';
+
+    // File B is read in pieces of this size and compared against the
+    // mapped baseline; a multiple of every word size.
+    constexpr std::size_t READ_LENGTH = 1024 * 1024;
+
+    // Room for one DataOut record, for each formatter a worker may make.
+    constexpr std::size_t SCRATCH_LENGTH = 4096;
+    constexpr std::size_t FORMATTERS = 12;
+
+    // Two paths and a few short fields.
+    constexpr std::size_t MAX_REQUEST_LENGTH = 16 * 1024;
+
+    constexpr int LISTEN_BACKLOG = 128;
+
+    // A client that neither sends its request nor reads the reply for
+    // this long is dropped, freeing its worker.
+    constexpr time_t IO_TIMEOUT_S = 30;
+
+    // How often serve() wakes while draining to check for idle workers.
+    constexpr int DRAIN_POLL_MS = 10;
+
+    constexpr std::string_view END_TAG = "#end";
+    constexpr std::string_view ERROR_TAG = "#error";
+
+    sockaddr_un make_address(const fs::path& socket)
+    {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+
+        const std::string& p = socket.native();
+        if (p.size() >= sizeof(addr.sun_path))
+        {
+            std::string err;
+            err.append("Socket path is too long: ");
+            err.append(p);
+            throw std::runtime_error(err);
+        }
+
+        std::memcpy(addr.sun_path, p.data(), p.size());
+        return addr;
+    }
+
+    std::vector<std::string_view> split(std::string_view line, const char delim)
+    {
+        std::vector<std::string_view> ret;
+        while (true)
+        {
+            const std::size_t pos = line.find(delim);
+            ret.push_back(line.substr(0, pos));
+            if (pos == std::string_view::npos)
+            {
+                return ret;
+            }
+
+            line.remove_prefix(pos + 1);
+        }
+    }
+
+    void write_line(bd::Sink& output, const std::string_view tag, const std::string_view rest)
+    {
+        output.write(tag.data(), tag.size());
+        output.write(&OUT_DELIM, 1);
+        output.write(rest.data(), rest.size());
+        output.write("\n", 1);
+    }
+
+    bool same_mtime(const timespec& a, const timespec& b) noexcept
+    {
+        return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+    }
+}
+
+bd::DiffDaemon::baseline_s::~baseline_s()
+{
+    if (data != nullptr)
+    {
+        ::munmap(const_cast<unsigned char*>(data), length);
+    }
+}
+
+void bd::DiffDaemon::baseline_s::checkLength() const
+{
+    struct stat st{};
+    if (::fstat(fd.get(), &st) != 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Unable to stat baseline");
+    }
+
+    // Touching a mapped page past the end of the file raises SIGBUS.
+    if (static_cast<std::uintmax_t>(st.st_size) < length)
+    {
+        throw std::runtime_error("Baseline was truncated during the request");
+    }
+}
+
+bd::DiffDaemon::worker_s::worker_s() :
+    arena(READ_LENGTH + (FORMATTERS * SCRATCH_LENGTH)),
+    buffer(arena.allocate<unsigned char>(READ_LENGTH, IO_ALIGNMENT)) {}
+
+bd::DataOut& bd::DiffDaemon::worker_s::getOut(const DataOutType type, const std::size_t wordSize)
+{
+    static_assert(FORMATTERS == 3 * 4);
+
+    const std::size_t i = (static_cast<std::size_t>(type) * 4) + static_cast<std::size_t>(std::countr_zero(wordSize));
+
+    if (!outs[i])
+    {
+        outs[i] = make_data_out(type, OUT_DELIM, wordSize, arena);
+    }
+
+    return *outs[i];
+}
+
+bd::DiffDaemon::~DiffDaemon()
+{
+    m_listen.close();
+
+    std::error_code ec;
+    fs::remove(m_socket, ec);
+}
+
+bd::DiffDaemon::DiffDaemon(const fs::path& socket, const std::size_t threads, const std::uintmax_t cacheBytes) :
+    m_socket(socket),
+    m_cacheBytes(0),
+    m_cacheLimit(cacheBytes),
+    m_served(0),
+    m_active(0),
+    m_pool(threads, TaskOrder::OldestFirst)
+{
+    const sockaddr_un addr = make_address(m_socket);
+
+    bd::FileDescriptor fd(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+    if (fd.get() < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Unable to create socket");
+    }
+
+    // A socket file left by a daemon that did not exit cleanly refuses
+    // connections; anything else at the path is left alone.
+    if (std::error_code ec; fs::is_socket(m_socket, ec))
+    {
+        const bd::FileDescriptor probe(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (probe.get() >= 0 && ::connect(probe.get(), reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0)
+        {
+            std::string err;
+            err.append("A daemon is already listening on ");
+            err.append(m_socket.string());
+            throw std::runtime_error(err);
+        }
+
+        fs::remove(m_socket, ec);
+    }
+
+    if (::bind(fd.get(), reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd.get(), LISTEN_BACKLOG) != 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Unable to listen on " + m_socket.string());
+    }
+
+    m_listen = std::move(fd);
+
+    for (std::size_t i = 0; i < m_pool.getThreadCount(); ++i)
+    {
+        m_workers.push_back(std::make_unique<worker_s>());
+    }
+}
+
+std::uintmax_t bd::DiffDaemon::getServedCount() const noexcept
+{
+    return m_served.load(std::memory_order_relaxed);
+}
+
+void bd::DiffDaemon::serve(const int stopFd)
+{
+    while (true)
+    {
+        pollfd fds[2] = {
+            { .fd = m_listen.get(), .events = POLLIN, .revents = 0 },
+            { .fd = stopFd, .events = POLLIN, .revents = 0 }
+        };
+
+        if (::poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            throw std::system_error(errno, std::generic_category(), "poll failure");
+        }
+
+        if ((fds[1].revents & POLLIN) != 0)
+        {
+            break;
+        }
+
+        const int conn = ::accept4(m_listen.get(), nullptr, nullptr, SOCK_CLOEXEC);
+        if (conn < 0)
+        {
+            // The client may give up before the accept; keep serving.
+            if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN)
+            {
+                continue;
+            }
+
+            throw std::system_error(errno, std::generic_category(), "accept failure");
+        }
+
+        // Owned by the task so a dropped task still closes it.
+        const auto guard = std::make_shared<bd::FileDescriptor>(conn);
+
+        const timeval timeout{ .tv_sec = IO_TIMEOUT_S, .tv_usec = 0 };
+        if (::setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0
+            || ::setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0)
+        {
+            // Without a timeout one client could hold a worker forever.
+            std::cerr << "Request dropped: " << std::error_code(errno, std::generic_category()).message() << std::endl;
+            continue;
+        }
+
+        m_active.fetch_add(1, std::memory_order_relaxed);
+        m_pool.submit([this, guard](const std::size_t w)
+        {
+            handle(guard->get(), w);
+            m_active.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    // Let accepted requests finish; the pool drops tasks on destruction.
+    while (m_active.load(std::memory_order_acquire) > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(DRAIN_POLL_MS));
+    }
+}
+
+std::shared_ptr<const bd::DiffDaemon::baseline_s> bd::DiffDaemon::acquire(const fs::path& file)
+{
+    bd::FileDescriptor in = bd::open_read(file);
+
+    struct stat st{};
+    if (::fstat(in.get(), &st) != 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Unable to stat " + file.string());
+    }
+
+    const std::string key = file.string();
+
+    {
+        std::scoped_lock<std::mutex> lock(m_cacheMtx);
+        if (const auto it = m_index.find(key); it != m_index.end())
+        {
+            const baseline_s& cached = *it->second->second;
+            if (cached.dev == st.st_dev && cached.ino == st.st_ino && cached.length == static_cast<std::size_t>(st.st_size)
+                && same_mtime(cached.mtime, st.st_mtim))
+            {
+                m_cache.splice(m_cache.begin(), m_cache, it->second);
+                return m_cache.front().second;
+            }
+
+            // Stale; requests still using the old mapping keep it alive.
+            m_cacheBytes -= cached.length;
+            m_cache.erase(it->second);
+            m_index.erase(it);
+        }
+    }
+
+    const TraceSpan span("map");
+
+    auto baseline = std::make_shared<baseline_s>();
+    baseline->data = nullptr;
+    baseline->length = static_cast<std::size_t>(st.st_size);
+    baseline->dev = st.st_dev;
+    baseline->ino = st.st_ino;
+    baseline->mtime = st.st_mtim;
+
+    if (baseline->length > 0)
+    {
+        void* ptr = ::mmap(nullptr, baseline->length, PROT_READ, MAP_SHARED, in.get(), 0);
+        if (ptr == MAP_FAILED)
+        {
+            throw std::system_error(errno, std::generic_category(), "Unable to map " + file.string());
+        }
+
+        baseline->data = static_cast<const unsigned char*>(ptr);
+
+        // Later requests should not fault the baseline in again.
+        ::madvise(ptr, baseline->length, MADV_WILLNEED);
+    }
+
+    baseline->fd = std::move(in);
+
+    std::scoped_lock<std::mutex> lock(m_cacheMtx);
+
+    // Another request may have mapped it meanwhile; either copy will do.
+    if (!m_index.contains(key))
+    {
+        m_cache.emplace_front(key, baseline);
+        m_index.emplace(key, m_cache.begin());
+        m_cacheBytes += baseline->length;
+
+        // Always keep the newest entry, even when it alone is over budget.
+        while (m_cacheBytes > m_cacheLimit && m_cache.size() > 1)
+        {
+            m_cacheBytes -= m_cache.back().second->length;
+            m_index.erase(m_cache.back().first);
+            m_cache.pop_back();
+        }
+    }
+
+    return baseline;
+}
+
+bd::diff_count bd::DiffDaemon::diff(Sink& output, const baseline_s& a, const fs::path& b,
+    const DataOutType type, const word_format_s& word, worker_s& scratch)
+{
+    const bd::FileDescriptor in = bd::open_read(b);
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    ::posix_fadvise(in.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    DataOut& out = scratch.getOut(type, word.size);
+
+    diff_count ret{ .bytes = 0, .bits = 0 };
+    std::uintmax_t offset = 0;
+
+    while (offset < a.length)
+    {
+        const std::size_t want = static_cast<std::size_t>(std::min<std::uintmax_t>(READ_LENGTH, a.length - offset));
+        const std::size_t got = pread_fully(in.get(), scratch.buffer, want, offset);
+
+        // Checked on both sides of each piece so a baseline truncated
+        // mid-request ends it with an error rather than a fault; only a
+        // truncation inside one piece's compare can still fault.
+        a.checkLength();
+
+        {
+            const TraceSpan span("compare");
+
+            for_each_word_difference(word, a.data + offset, scratch.buffer, got, [&](const std::size_t i, const std::uint64_t wordA, const std::uint64_t wordB)
+            {
+                out.init(offset + static_cast<std::uintmax_t>(i), wordA, wordB);
+
+                ret.bytes += static_cast<std::uintmax_t>(nonzero_bytes(wordA ^ wordB));
+                ret.bits += static_cast<std::uintmax_t>(out.getDiffPopCount());
+
+                out.print(output);
+                output.write("\n", 1);
+            });
+        }
+
+        a.checkLength();
+
+        offset += got;
+        if (got < want)
+        {
+            break;
+        }
+    }
+
+    return ret;
+}
+
+void bd::DiffDaemon::handle(const int fd, const std::size_t worker)
+{
+    const TraceSpan span("request");
+
+    try
+    {
+        std::string request;
+        while (request.find('\n') == std::string::npos)
+        {
+            char buf[4096];
+            const ssize_t got = ::read(fd, buf, sizeof(buf));
+            if (got < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                throw std::system_error(errno, std::generic_category(), "Request read failure");
+            }
+
+            if (got == 0 || request.size() + static_cast<std::size_t>(got) > MAX_REQUEST_LENGTH)
+            {
+                // Nothing useful can be said to a client that sent no
+                // request.
+                return;
+            }
+
+            request.append(buf, static_cast<std::size_t>(got));
+        }
+
+        request.resize(request.find('\n'));
+
+        FdSink output(fd, false);
+
+        try
+        {
+            const std::vector<std::string_view> fields = split(request, OUT_DELIM);
+            if (fields.size() != 6 || fields[0] != "diff")
+            {
+                throw std::runtime_error("Malformed request");
+            }
+
+            DataOutType type;
+            if (fields[1] == "a")
+            {
+                type = DataOutType::Bits;
+            }
+            else if (fields[1] == "b")
+            {
+                type = DataOutType::Binary;
+            }
+            else if (fields[1] == "x")
+            {
+                type = DataOutType::Hex;
+            }
+            else
+            {
+                throw std::runtime_error("Invalid output mode");
+            }
+
+            word_format_s word = BYTE_FORMAT;
+            if (fields[2] == "1" || fields[2] == "2" || fields[2] == "4" || fields[2] == "8")
+            {
+                word.size = static_cast<std::size_t>(fields[2][0] - '0');
+            }
+            else
+            {
+                throw std::runtime_error("Invalid word size");
+            }
+
+            if (fields[3] == "be")
+            {
+                word.endian = Endian::Big;
+            }
+            else if (fields[3] != "le")
+            {
+                throw std::runtime_error("Invalid byte order");
+            }
+
+            const fs::path pathA(fields[4]);
+            const fs::path pathB(fields[5]);
+            if (!pathA.is_absolute() || !pathB.is_absolute())
+            {
+                throw std::runtime_error("Paths must be absolute");
+            }
+
+            const std::shared_ptr<const baseline_s> baseline = acquire(pathA);
+            const diff_count count = diff(output, *baseline, pathB, type, word, *m_workers[worker]);
+
+            const std::string totals = std::to_string(count.bytes) + OUT_DELIM + std::to_string(count.bits);
+            write_line(output, END_TAG, totals);
+        }
+        catch (const std::exception& e)
+        {
+            // Records already sent stay; the status line tells the client
+            // they are incomplete.
+            write_line(output, ERROR_TAG, e.what());
+        }
+
+        output.close();
+        m_served.fetch_add(1, std::memory_order_relaxed);
+    }
+    catch (const std::exception& e)
+    {
+        // The client went away; nothing to report it to.
+        std::cerr << "Request failed: " << e.what() << std::endl;
+    }
+}
+
+bd::diff_count bd::daemon_request(const fs::path& socket, const fs::path& a, const fs::path& b,
+    const DataOutType type, const word_format_s& word, Sink& output)
+{
+    const sockaddr_un addr = make_address(socket);
+
+    const bd::FileDescriptor conn(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+    if (conn.get() < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Unable to create socket");
+    }
+
+    if (::connect(conn.get(), reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Unable to connect to " + socket.string());
+    }
+
+    std::string request("diff");
+    request.push_back(OUT_DELIM);
+    request.push_back((type == DataOutType::Hex) ? 'x' : (type == DataOutType::Binary) ? 'b' : 'a');
+    request.push_back(OUT_DELIM);
+    request.append(std::to_string(word.size));
+    request.push_back(OUT_DELIM);
+    request.append((word.endian == Endian::Big) ? "be" : "le");
+    request.push_back(OUT_DELIM);
+    request.append(fs::absolute(a).string());
+    request.push_back(OUT_DELIM);
+    request.append(fs::absolute(b).string());
+    request.push_back('\n');
+
+    for (std::size_t sent = 0; sent < request.size();)
+    {
+        const ssize_t n = ::send(conn.get(), request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            throw std::system_error(errno, std::generic_category(), "Request write failure");
+        }
+
+        sent += static_cast<std::size_t>(n);
+    }
+
+    // Records are passed through whole lines at a time; a line starting
+    // with '#' is the status and ends the reply.
+    std::vector<char> buf(READ_LENGTH);
+    std::size_t fill = 0;
+
+    while (true)
+    {
+        const ssize_t got = ::read(conn.get(), buf.data() + fill, buf.size() - fill);
+        if (got < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            throw std::system_error(errno, std::generic_category(), "Reply read failure");
+        }
+
+        if (got == 0)
+        {
+            throw std::runtime_error("Daemon closed the connection without a status");
+        }
+
+        fill += static_cast<std::size_t>(got);
+
+        std::size_t line = 0;
+        while (true)
+        {
+            const char* nl = static_cast<const char*>(std::memchr(buf.data() + line, '\n', fill - line));
+            if (nl == nullptr)
+            {
+                break;
+            }
+
+            const std::size_t end = static_cast<std::size_t>(nl - buf.data());
+            if (buf[line] == '#')
+            {
+                output.write(buf.data(), line);
+
+                const std::string_view status(buf.data() + line, end - line);
+                const std::vector<std::string_view> fields = split(status, OUT_DELIM);
+
+                if (fields[0] == END_TAG && fields.size() == 3)
+                {
+                    return {
+                        .bytes = std::stoull(std::string(fields[1])),
+                        .bits = std::stoull(std::string(fields[2]))
+                    };
+                }
+
+                std::string err;
+                err.append("Daemon: ");
+                err.append((fields.size() > 1) ? status.substr(ERROR_TAG.size() + 1) : status);
+                throw std::runtime_error(err);
+            }
+
+            line = end + 1;
+        }
+
+        // Pass on the whole lines and keep the partial one.
+        output.write(buf.data(), line);
+        std::memmove(buf.data(), buf.data() + line, fill - line);
+        fill -= line;
+
+        if (fill == buf.size())
+        {
+            throw std::runtime_error("Daemon reply line is too long");
+        }
+    }
+}
@@ -4,98 +4,37 @@
 #include <iostream>
 #include <cstddef>
 #include <cstdint>
-#include <charconv>
 #include <stdexcept>
-#include <system_error>
 #include <string_view>
-#include <cassert>
+#include <memory>
 
 // We need to be able to move memory as required
 #include <cstring>
 
-// replace GCC built in popcount with C++ 20 version
-#include <bit>
-
-// Compile time safety
-#include <type_traits>
-
+#include "bitdiff/kernel.hpp"
 #include "bitdiff/dataout.hpp"
 
 namespace bd = isaki::bitdiff;
 
 namespace
 {
-    constexpr int HEX_RADIX = 16;
-    constexpr int BIN_RADIX = 2;
+    constexpr std::uint64_t ALL_BITS = ~std::uint64_t(0);
 
-    constexpr char NO_DIFF = '.';
     constexpr std::string_view HEX_PREFIX = "0x";
     constexpr std::string_view BIN_PREFIX = "0b";
 
     constexpr std::size_t UCHAR_HEX_COUNT = sizeof(unsigned char) * (CHAR_BIT >> 2);
     constexpr std::size_t UCHAR_BIT_COUNT = sizeof(unsigned char) * CHAR_BIT;
     constexpr std::size_t UINTMAX_HEX_COUNT = sizeof(std::uintmax_t) * (CHAR_BIT >> 2);
-
-    void to_bitwise_string(char* buffer, const std::size_t tokenSize, const unsigned char value, const unsigned char x) noexcept
-    {
-        for (std::size_t i = 0; i < tokenSize; ++i)
-        {
-            const std::size_t shift = tokenSize - i - 1;
-
-            if (((x >> shift) & 1) == 0)
-            {
-                buffer[i] = NO_DIFF;
-            }
-            else if (((value >> shift) & 1) == 0)
-            {
-                buffer[i] = '0';
-            }
-            else
-            {
-                buffer[i] = '1';
-            }
-        }
-    }
-
-    template<typename T>
-    requires std::is_integral_v<T> && std::is_unsigned_v<T>
-    void to_chars(char* start, char* end, const T value, const int radix) noexcept
-    {
-        auto result = std::to_chars(start, end, value, radix);
-
-        assert(result.ec == std::errc());
-
-        if (result.ptr != end)
-        {
-            // We didn't fill. We can rely on filling the stream and have to
-            // manage the ostream flags, or, we can shift the data and pad in
-            // our own zeros (the character, not the number);
-
-             // How many characters we need to fill.
-            const std::ptrdiff_t offset = end - result.ptr;
-
-            // The full size of the buffer we need to fill.
-            const std::ptrdiff_t full = end - start;
-
-            // The number of characters we need to move.
-            const std::ptrdiff_t difference = full - offset;
-
-            std::memmove(start + offset, start, difference);
-            std::memset(start, '0', offset);
-        }
-    }
 }
 
 //
 // BASE CLASS
 //
 
-bd::DataOut::~DataOut()
-{
-    delete[] m_buffer;
-}
+bd::DataOut::~DataOut() = default;
 
-bd::DataOut::DataOut(std::string_view prefix, std::size_t tokenSize, char delim) :
+bd::DataOut::DataOut(std::string_view prefix, std::size_t tokenSize, char delim, Arena& arena) :
     m_tokenSize(tokenSize),
     m_recordSize(HEX_PREFIX.size() + UINTMAX_HEX_COUNT
         + 1
@@ -113,7 +52,7 @@ bd::DataOut::DataOut(std::string_view prefix, std::size_t tokenSize, char delim)
     // --- Allocate scratch space --- //
     //
 
-    m_buffer = new char[m_recordSize]; // memset no longer needed, raw buffer, not a string
+    m_buffer = arena.allocate<char>(m_recordSize, SIMD_ALIGNMENT); // raw buffer, not a string
 
     //
     // --- Cache mutable scratch regions of memory --- //
@@ -149,12 +88,14 @@ bd::DataOut::DataOut(std::string_view prefix, std::size_t tokenSize, char delim)
 
 int bd::DataOut::getDiffPopCount() const
 {
-    return std::popcount<unsigned char>(m_a ^ m_b);
+    return count_bits(m_a ^ m_b);
 }
 
-void bd::DataOut::init(std::uintmax_t address, unsigned char dataA, unsigned char dataB) noexcept
+void bd::DataOut::init(std::uintmax_t address, std::uint64_t dataA, std::uint64_t dataB) noexcept
 {
-    to_chars<std::uintmax_t>(m_posAddr, m_posAddr + UINTMAX_HEX_COUNT, address, HEX_RADIX);
+    static_assert(sizeof(std::uintmax_t) <= sizeof(std::uint64_t));
+
+    format_hex(m_posAddr, address, sizeof(std::uintmax_t));
     m_a = dataA;
     m_b = dataB;
 }
@@ -165,14 +106,14 @@ void bd::DataOut::init(std::uintmax_t address, unsigned char dataA, unsigned cha
 
 bd::HexDataOut::~HexDataOut() = default;
 
-bd::HexDataOut::HexDataOut(char delim) :
-    super(HEX_PREFIX, UCHAR_HEX_COUNT, delim) {}
+bd::HexDataOut::HexDataOut(char delim, std::size_t wordSize, Arena& arena) :
+    super(HEX_PREFIX, UCHAR_HEX_COUNT * wordSize, delim, arena) {}
 
-void bd::HexDataOut::print(std::ostream& os) const
+void bd::HexDataOut::print(Sink& os) const
 {
-    printBuffer(os, [](char* buff, std::size_t len, unsigned char value) noexcept
+    printBuffer(os, [](char* buff, std::size_t len, std::uint64_t value) noexcept
     {
-        to_chars<unsigned char>(buff, buff + len, value, HEX_RADIX);
+        format_hex(buff, value, len / UCHAR_HEX_COUNT);
     });
 }
 
@@ -182,14 +123,14 @@ void bd::HexDataOut::print(std::ostream& os) const
 
 bd::BinaryDataOut::~BinaryDataOut() = default;
 
-bd::BinaryDataOut::BinaryDataOut(char delim) :
-    super(BIN_PREFIX, UCHAR_BIT_COUNT, delim) {}
+bd::BinaryDataOut::BinaryDataOut(char delim, std::size_t wordSize, Arena& arena) :
+    super(BIN_PREFIX, UCHAR_BIT_COUNT * wordSize, delim, arena) {}
 
-void bd::BinaryDataOut::print(std::ostream& os) const
+void bd::BinaryDataOut::print(Sink& os) const
 {
-    printBuffer(os, [](char* buff, std::size_t len, unsigned char value) noexcept
+    printBuffer(os, [](char* buff, std::size_t len, std::uint64_t value) noexcept
     {
-        to_chars<unsigned char>(buff, buff + len, value, BIN_RADIX);
+        format_bits(buff, value, ALL_BITS, len / UCHAR_BIT_COUNT);
     });
 }
 
@@ -199,25 +140,45 @@ void bd::BinaryDataOut::print(std::ostream& os) const
 
 bd::BitDataOut::~BitDataOut() = default;
 
-bd::BitDataOut::BitDataOut(char delim) :
-    super(BIN_PREFIX, UCHAR_BIT_COUNT, delim),
+bd::BitDataOut::BitDataOut(char delim, std::size_t wordSize, Arena& arena) :
+    super(BIN_PREFIX, UCHAR_BIT_COUNT * wordSize, delim, arena),
     m_xor(0) {}
 
 int bd::BitDataOut::getDiffPopCount() const
 {
-    return std::popcount<unsigned char>(m_xor);
+    return count_bits(m_xor);
 }
 
-void bd::BitDataOut::init(std::uintmax_t address, unsigned char dataA, unsigned char dataB) noexcept
+void bd::BitDataOut::init(std::uintmax_t address, std::uint64_t dataA, std::uint64_t dataB) noexcept
 {
     super::init(address, dataA, dataB);
     m_xor = dataA ^ dataB;
 }
 
-void bd::BitDataOut::print(std::ostream& os) const
+void bd::BitDataOut::print(Sink& os) const
 {
-    printBuffer(os, [x = m_xor](char* buff, std::size_t len, unsigned char value) noexcept
+    // Bits that match print as '.'.
+    printBuffer(os, [x = m_xor](char* buff, std::size_t len, std::uint64_t value) noexcept
     {
-        to_bitwise_string(buff, len, value, x);
+        format_bits(buff, value, x, len / UCHAR_BIT_COUNT);
     });
 }
+
+//
+// FACTORY
+//
+
+std::unique_ptr<bd::DataOut> bd::make_data_out(const DataOutType type, const char delim, const std::size_t wordSize, Arena& arena)
+{
+    switch (type)
+    {
+        case DataOutType::Hex :
+            return std::make_unique<HexDataOut>(delim, wordSize, arena);
+
+        case DataOutType::Binary :
+            return std::make_unique<BinaryDataOut>(delim, wordSize, arena);
+
+        default:
+            return std::make_unique<BitDataOut>(delim, wordSize, arena);
+    }
+}
@@ -0,0 +1,147 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bitdiff/arena.hpp"
+#include "bitdiff/compare.hpp"
+#include "bitdiff/fd.hpp"
+#include "bitdiff/kernel.hpp"
+#include "bitdiff/mask.hpp"
+#include "bitdiff/reader.hpp"
+#include "bitdiff/estimate.hpp"
+
+namespace bd = isaki::bitdiff;
+namespace fs = std::filesystem;
+
+namespace
+{
+    // Long enough to amortize a seek, short enough for many strata.
+    constexpr std::size_t BLOCK_LENGTH = 64 * 1024;
+
+    // Two sided 95% normal quantile.
+    constexpr double Z_95 = 1.959964;
+
+    // Running mean and variance of per-block fractions (Welford).
+    struct moments_s
+    {
+        std::size_t n;
+        double mean;
+        double m2;
+
+        void add(const double x) noexcept
+        {
+            ++n;
+            const double delta = x - mean;
+            mean += delta / static_cast<double>(n);
+            m2 += delta * (x - mean);
+        }
+
+        // Half width of the 95% interval, with the finite population
+        // correction for drawing n of population blocks.
+        [[nodiscard]] double margin(const std::uintmax_t population) const noexcept
+        {
+            if (n < 2)
+            {
+                return 0.0;
+            }
+
+            const double variance = m2 / static_cast<double>(n - 1);
+            const double fpc = 1.0 - (static_cast<double>(n) / static_cast<double>(population));
+            return Z_95 * std::sqrt(std::max(0.0, variance * fpc) / static_cast<double>(n));
+        }
+    };
+}
+
+bd::estimate_s bd::estimate_difference(const fs::path& a, const fs::path& b, const std::uintmax_t budget, const Mask* mask)
+{
+    const std::uintmax_t size = std::min(fs::file_size(a), fs::file_size(b));
+    const std::uintmax_t population = (size + BLOCK_LENGTH - 1) / BLOCK_LENGTH;
+    const std::uintmax_t blocks = std::clamp<std::uintmax_t>(budget / BLOCK_LENGTH, 1, std::max<std::uintmax_t>(population, 1));
+
+    estimate_s ret{};
+    ret.size = size;
+
+    if (size == 0)
+    {
+        return ret;
+    }
+
+    const FileDescriptor inA = open_read(a);
+    const FileDescriptor inB = open_read(b);
+
+#ifdef POSIX_FADV_RANDOM
+    ::posix_fadvise(inA.get(), 0, 0, POSIX_FADV_RANDOM);
+    ::posix_fadvise(inB.get(), 0, 0, POSIX_FADV_RANDOM);
+#endif
+
+    Arena arena(3 * BLOCK_LENGTH);
+    unsigned char* bufferA = arena.allocate<unsigned char>(BLOCK_LENGTH, IO_ALIGNMENT);
+    unsigned char* bufferB = arena.allocate<unsigned char>(BLOCK_LENGTH, IO_ALIGNMENT);
+    unsigned char* bufferMask = arena.allocate<unsigned char>(BLOCK_LENGTH, IO_ALIGNMENT);
+
+    std::mt19937_64 rng(std::random_device{}());
+
+    moments_s byteMoments{};
+    moments_s bitMoments{};
+
+    // Strata are whole blocks so every sample stays block aligned, which
+    // keeps reads aligned for the device.
+    for (std::uintmax_t s = 0; s < blocks; ++s)
+    {
+        const std::uintmax_t first = (s * population) / blocks;
+        const std::uintmax_t last = ((s + 1) * population) / blocks;
+
+        std::uniform_int_distribution<std::uintmax_t> pick(first, last - 1);
+        const std::uintmax_t offset = pick(rng) * BLOCK_LENGTH;
+        const auto want = static_cast<std::size_t>(std::min<std::uintmax_t>(BLOCK_LENGTH, size - offset));
+
+        const std::size_t gotA = pread_fully(inA.get(), bufferA, want, offset);
+        const std::size_t gotB = pread_fully(inB.get(), bufferB, want, offset);
+        if (gotA != want || gotB != want)
+        {
+            throw std::runtime_error("Input changed size during estimate");
+        }
+
+        const unsigned char* compareB = (mask != nullptr) ? mask->apply(offset, bufferA, bufferB, bufferMask, want) : bufferB;
+
+        diff_count block = { .bytes = 0, .bits = 0 };
+        for_each_difference(bufferA, compareB, want, [&](const std::size_t i)
+        {
+            ++block.bytes;
+            block.bits += static_cast<std::uintmax_t>(count_bits(static_cast<unsigned char>(bufferA[i] ^ compareB[i])));
+        });
+
+        ret.sampled.bytes += block.bytes;
+        ret.sampled.bits += block.bits;
+        ret.sampledBytes += want;
+
+        byteMoments.add(static_cast<double>(block.bytes) / static_cast<double>(want));
+        bitMoments.add(static_cast<double>(block.bits) / static_cast<double>(want * 8));
+    }
+
+    ret.blocks = static_cast<std::size_t>(blocks);
+
+    // Ratio estimates; blocks differ in length only at the end of the input.
+    ret.byteFraction = static_cast<double>(ret.sampled.bytes) / static_cast<double>(ret.sampledBytes);
+    ret.bitFraction = static_cast<double>(ret.sampled.bits) / static_cast<double>(ret.sampledBytes * 8);
+    ret.byteMargin = byteMoments.margin(population);
+    ret.bitMargin = bitMoments.margin(population);
+
+    ret.projected = {
+        .bytes = static_cast<std::uintmax_t>(std::llround(ret.byteFraction * static_cast<double>(size))),
+        .bits = static_cast<std::uintmax_t>(std::llround(ret.bitFraction * static_cast<double>(size) * 8.0))
+    };
+
+    return ret;
+}
@@ -0,0 +1,182 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "bitdiff/arena.hpp"
+#include "bitdiff/dataout.hpp"
+#include "bitdiff/pool.hpp"
+#include "bitdiff/sink.hpp"
+#include "bitdiff/trace.hpp"
+#include "bitdiff/format.hpp"
+
+namespace bd = isaki::bitdiff;
+
+namespace
+{
+    constexpr char OUT_DELIM = '\t';
+
+    // Room for the DataOut record; far larger than any record format.
+    constexpr std::size_t SCRATCH_LENGTH = 4096;
+
+    // Batches allowed in flight per worker; bounds memory to a few batches
+    // per thread.
+    constexpr std::size_t WINDOW_PER_THREAD = 2;
+}
+
+bd::FormatPipeline::worker_s::worker_s(const DataOutType type, const std::size_t wordSize) :
+    arena(SCRATCH_LENGTH),
+    out(make_data_out(type, OUT_DELIM, wordSize, arena)) {}
+
+bd::FormatPipeline::~FormatPipeline() = default;
+
+bd::FormatPipeline::FormatPipeline(Sink& output, const DataOutType type, const std::size_t wordSize, const std::size_t threads) :
+    m_output(output),
+    m_fill(0),
+    m_window(0),
+    m_pool(threads, TaskOrder::OldestFirst)
+{
+    for (std::size_t i = 0; i < m_pool.getThreadCount(); ++i)
+    {
+        m_workers.push_back(std::make_unique<worker_s>(type, wordSize));
+    }
+
+    m_window = m_pool.getThreadCount() * WINDOW_PER_THREAD;
+
+    newBatch();
+}
+
+void bd::FormatPipeline::newBatch()
+{
+    m_batch = std::make_unique<batch_s>();
+
+    {
+        std::scoped_lock<std::mutex> lock(m_mtx);
+        if (!m_spare.empty())
+        {
+            m_batch->records = std::move(m_spare.back());
+            m_spare.pop_back();
+        }
+    }
+
+    // Every record is written before it is read; skip zeroing 1.5 MiB.
+    if (!m_batch->records)
+    {
+        m_batch->records = std::make_unique_for_overwrite<record_s[]>(BATCH_RECORDS);
+    }
+
+    m_batch->count = 0;
+    m_batch->prefix = m_prefix;
+    m_batch->done = false;
+    m_fill = 0;
+}
+
+void bd::FormatPipeline::setPrefix(const std::string_view prefix)
+{
+    // Each batch has one prefix.
+    if (m_fill > 0)
+    {
+        submit();
+    }
+
+    m_prefix.assign(prefix);
+    m_batch->prefix = m_prefix;
+}
+
+void bd::FormatPipeline::submit()
+{
+    m_batch->count = m_fill;
+
+    batch_s* b = m_batch.get();
+    {
+        std::scoped_lock<std::mutex> lock(m_mtx);
+        m_pending.push_back(std::move(m_batch));
+    }
+
+    m_pool.submit([this, b](const std::size_t w)
+    {
+        worker_s& worker = *m_workers[w];
+
+        try
+        {
+            const TraceSpan span("format");
+
+            for (std::size_t i = 0; i < b->count; ++i)
+            {
+                const record_s& r = b->records[i];
+                worker.out->init(r.offset, r.a, r.b);
+                worker.sink.write(b->prefix.data(), b->prefix.size());
+                worker.out->print(worker.sink);
+                worker.sink.write("\n", 1);
+            }
+
+            b->text = worker.sink.take();
+        }
+        catch (...)
+        {
+            b->error = std::current_exception();
+        }
+
+        // The records are no longer needed; hand them to the next batch.
+        std::scoped_lock<std::mutex> lock(m_mtx);
+        m_spare.push_back(std::move(b->records));
+        b->done = true;
+        m_done.notify_all();
+    });
+
+    newBatch();
+    write(false);
+}
+
+void bd::FormatPipeline::drain()
+{
+    if (m_fill > 0)
+    {
+        submit();
+    }
+
+    write(true);
+}
+
+void bd::FormatPipeline::write(const bool all)
+{
+    while (true)
+    {
+        std::unique_ptr<batch_s> batch;
+        {
+            std::unique_lock<std::mutex> lock(m_mtx);
+            if (m_pending.empty())
+            {
+                return;
+            }
+
+            if (!m_pending.front()->done)
+            {
+                if (!all && m_pending.size() <= m_window)
+                {
+                    return;
+                }
+
+                const TraceSpan span("wait");
+                m_done.wait(lock, [this] { return m_pending.front()->done; });
+            }
+
+            batch = std::move(m_pending.front());
+            m_pending.pop_front();
+        }
+
+        if (batch->error)
+        {
+            std::rethrow_exception(batch->error);
+        }
+
+        m_output.write(batch->text.data(), batch->text.size());
+    }
+}
@@ -0,0 +1,133 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "bitdiff/endian.hpp"
+#include "bitdiff/hash.hpp"
+
+namespace bd = isaki::bitdiff;
+
+namespace
+{
+    constexpr std::uint64_t PRIME_1 = 0x9E3779B185EBCA87ULL;
+    constexpr std::uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr std::uint64_t PRIME_3 = 0x165667B19E3779F9ULL;
+    constexpr std::uint64_t PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+    constexpr std::uint64_t PRIME_5 = 0x27D4EB2F165667C5ULL;
+
+    std::uint64_t round(std::uint64_t acc, const std::uint64_t input) noexcept
+    {
+        acc += input * PRIME_2;
+        acc = std::rotl(acc, 31);
+        return acc * PRIME_1;
+    }
+
+    std::uint64_t merge(std::uint64_t acc, const std::uint64_t value) noexcept
+    {
+        acc ^= round(0, value);
+        return (acc * PRIME_1) + PRIME_4;
+    }
+
+    // Consumes whole stripes; returns the bytes used.
+    std::size_t stripes(std::uint64_t* acc, const unsigned char* data, const std::size_t len) noexcept
+    {
+        std::size_t pos = 0;
+        for (; len - pos >= 32; pos += 32)
+        {
+            acc[0] = round(acc[0], bd::load_le64(data + pos));
+            acc[1] = round(acc[1], bd::load_le64(data + pos + 8));
+            acc[2] = round(acc[2], bd::load_le64(data + pos + 16));
+            acc[3] = round(acc[3], bd::load_le64(data + pos + 24));
+        }
+
+        return pos;
+    }
+}
+
+bd::Hash64::Hash64() noexcept :
+    m_acc{ PRIME_1 + PRIME_2, PRIME_2, 0, 0 - PRIME_1 },
+    m_total(0),
+    m_tail{},
+    m_tailLen(0) {}
+
+bd::Hash64::~Hash64() = default;
+
+void bd::Hash64::update(const unsigned char* data, std::size_t len) noexcept
+{
+    m_total += len;
+
+    if (m_tailLen > 0)
+    {
+        const std::size_t take = std::min(len, STRIPE_LENGTH - m_tailLen);
+        std::memcpy(m_tail + m_tailLen, data, take);
+
+        m_tailLen += take;
+        data += take;
+        len -= take;
+
+        if (m_tailLen < STRIPE_LENGTH)
+        {
+            return;
+        }
+
+        stripes(m_acc, m_tail, STRIPE_LENGTH);
+        m_tailLen = 0;
+    }
+
+    const std::size_t used = stripes(m_acc, data, len);
+
+    m_tailLen = len - used;
+    std::memcpy(m_tail, data + used, m_tailLen);
+}
+
+std::uint64_t bd::Hash64::digest() const noexcept
+{
+    std::uint64_t h;
+    if (m_total >= STRIPE_LENGTH)
+    {
+        h = std::rotl(m_acc[0], 1) + std::rotl(m_acc[1], 7) + std::rotl(m_acc[2], 12) + std::rotl(m_acc[3], 18);
+        h = merge(h, m_acc[0]);
+        h = merge(h, m_acc[1]);
+        h = merge(h, m_acc[2]);
+        h = merge(h, m_acc[3]);
+    }
+    else
+    {
+        h = PRIME_5;
+    }
+
+    h += m_total;
+
+    std::size_t pos = 0;
+    for (; m_tailLen - pos >= 8; pos += 8)
+    {
+        h ^= round(0, bd::load_le64(m_tail + pos));
+        h = (std::rotl(h, 27) * PRIME_1) + PRIME_4;
+    }
+
+    if (m_tailLen - pos >= 4)
+    {
+        h ^= static_cast<std::uint64_t>(bd::load_le32(m_tail + pos)) * PRIME_1;
+        h = (std::rotl(h, 23) * PRIME_2) + PRIME_3;
+        pos += 4;
+    }
+
+    for (; pos < m_tailLen; ++pos)
+    {
+        h ^= m_tail[pos] * PRIME_5;
+        h = std::rotl(h, 11) * PRIME_1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME_2;
+    h ^= h >> 29;
+    h *= PRIME_3;
+    h ^= h >> 32;
+
+    return h;
+}
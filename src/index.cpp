@@ -0,0 +1,441 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <zlib.h>
+
+#include "bitdiff/compare.hpp"
+#include "bitdiff/endian.hpp"
+#include "bitdiff/fd.hpp"
+#include "bitdiff/kernel.hpp"
+#include "bitdiff/sink.hpp"
+#include "bitdiff/trace.hpp"
+#include "bitdiff/index.hpp"
+
+namespace bd = isaki::bitdiff;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr std::string_view MAGIC = "BITINDEX";
+    constexpr std::uint32_t FORMAT_VERSION = 1;
+
+    constexpr std::size_t HEADER_LENGTH = 16;
+    constexpr std::size_t ENTRY_LENGTH = 48;
+    constexpr std::size_t TRAILER_LENGTH = 40;
+
+    // Fast levels already shrink the sparse offsets well; the index should
+    // not slow the diff down.
+    constexpr int ZLIB_LEVEL = 1;
+
+    // LEB128 offset delta plus the two bytes.
+    constexpr std::size_t MAX_RECORD_LENGTH = 10 + 2;
+
+    std::uintmax_t bit_count(const unsigned char a, const unsigned char b) noexcept
+    {
+        return static_cast<std::uintmax_t>(bd::count_bits(static_cast<unsigned int>(a ^ b)));
+    }
+
+    [[noreturn]] void corrupt(const fs::path& file, const std::string_view what)
+    {
+        std::string err;
+        err.append("Invalid index ");
+        err.append(file.string());
+        err.append(": ");
+        err.append(what);
+        throw std::runtime_error(err);
+    }
+}
+
+bd::IndexWriter::~IndexWriter() = default;
+
+bd::IndexWriter::IndexWriter(const fs::path& file) :
+    m_output(file),
+    m_total{ .bytes = 0, .bits = 0 }
+{
+    m_records.reserve(INDEX_BLOCK_RECORDS);
+
+    unsigned char header[HEADER_LENGTH];
+    std::memcpy(header, MAGIC.data(), MAGIC.size());
+    bd::store_le32(header + 8, FORMAT_VERSION);
+    bd::store_le32(header + 12, 0);
+    m_output.write(reinterpret_cast<const char*>(header), HEADER_LENGTH);
+}
+
+void bd::IndexWriter::update(const std::uintmax_t base, const unsigned char* a, const unsigned char* b, const std::size_t len)
+{
+    for_each_difference(a, b, len, [&](const std::size_t i)
+    {
+        m_records.push_back({ .offset = base + i, .a = a[i], .b = b[i] });
+        if (m_records.size() == INDEX_BLOCK_RECORDS)
+        {
+            emit();
+        }
+    });
+}
+
+void bd::IndexWriter::emit()
+{
+    const TraceSpan span("index");
+
+    m_raw.resize(m_records.size() * MAX_RECORD_LENGTH);
+
+    unsigned char* const start = reinterpret_cast<unsigned char*>(m_raw.data());
+    unsigned char* pos = start;
+
+    index_entry_s entry{
+        .first = m_records.front().offset,
+        .last = m_records.back().offset,
+        .position = m_output.tell(),
+        .length = 0,
+        .records = static_cast<std::uint32_t>(m_records.size()),
+        .bytesBefore = m_total.bytes,
+        .bitsBefore = m_total.bits
+    };
+
+    std::uint64_t previous = entry.first;
+    for (const index_record_s& r : m_records)
+    {
+        std::uint64_t delta = r.offset - previous;
+        previous = r.offset;
+
+        while (delta >= 0x80)
+        {
+            *pos++ = static_cast<unsigned char>(delta | 0x80);
+            delta >>= 7;
+        }
+
+        *pos++ = static_cast<unsigned char>(delta);
+        *pos++ = r.a;
+        *pos++ = r.b;
+
+        ++m_total.bytes;
+        m_total.bits += bit_count(r.a, r.b);
+    }
+
+    const uLong rawLength = static_cast<uLong>(pos - start);
+
+    m_packed.resize(::compressBound(rawLength));
+    uLongf packedLength = static_cast<uLongf>(m_packed.size());
+
+    if (::compress2(reinterpret_cast<Bytef*>(m_packed.data()), &packedLength, start, rawLength, ZLIB_LEVEL) != Z_OK)
+    {
+        throw std::runtime_error("Index block compression failed");
+    }
+
+    entry.length = static_cast<std::uint32_t>(packedLength);
+    m_output.write(m_packed.data(), packedLength);
+
+    m_entries.push_back(entry);
+    m_records.clear();
+}
+
+void bd::IndexWriter::finish()
+{
+    if (!m_records.empty())
+    {
+        emit();
+    }
+
+    const std::uint64_t directory = m_output.tell();
+
+    for (const index_entry_s& e : m_entries)
+    {
+        unsigned char raw[ENTRY_LENGTH];
+        bd::store_le64(raw, e.first);
+        bd::store_le64(raw + 8, e.last);
+        bd::store_le64(raw + 16, e.position);
+        bd::store_le32(raw + 24, e.length);
+        bd::store_le32(raw + 28, e.records);
+        bd::store_le64(raw + 32, e.bytesBefore);
+        bd::store_le64(raw + 40, e.bitsBefore);
+        m_output.write(reinterpret_cast<const char*>(raw), ENTRY_LENGTH);
+    }
+
+    unsigned char trailer[TRAILER_LENGTH];
+    bd::store_le64(trailer, directory);
+    bd::store_le64(trailer + 8, m_entries.size());
+    bd::store_le64(trailer + 16, m_total.bytes);
+    bd::store_le64(trailer + 24, m_total.bits);
+    std::memcpy(trailer + 32, MAGIC.data(), MAGIC.size());
+    m_output.write(reinterpret_cast<const char*>(trailer), TRAILER_LENGTH);
+
+    m_output.persist();
+    m_output.close();
+}
+
+bd::IndexReader::~IndexReader()
+{
+    cleanup();
+}
+
+bd::IndexReader::IndexReader(const fs::path& file) :
+    m_map(nullptr),
+    m_length(0),
+    m_directory(nullptr),
+    m_blocks(0),
+    m_total{ .bytes = 0, .bits = 0 }
+{
+    const bd::FileDescriptor in = bd::open_read(file);
+
+    struct stat st{};
+    if (::fstat(in.get(), &st) != 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Unable to stat " + file.string());
+    }
+
+    m_length = static_cast<std::size_t>(st.st_size);
+    if (m_length < HEADER_LENGTH + TRAILER_LENGTH)
+    {
+        corrupt(file, "too short");
+    }
+
+    // The mapping outlives the descriptor.
+    void* ptr = ::mmap(nullptr, m_length, PROT_READ, MAP_PRIVATE, in.get(), 0);
+    if (ptr == MAP_FAILED)
+    {
+        throw std::system_error(errno, std::generic_category(), "Unable to map " + file.string());
+    }
+
+    m_map = static_cast<const unsigned char*>(ptr);
+
+    // Queries touch a few blocks spread over the file.
+    ::madvise(ptr, m_length, MADV_RANDOM);
+
+    try
+    {
+        if (std::memcmp(m_map, MAGIC.data(), MAGIC.size()) != 0)
+        {
+            corrupt(file, "bad magic");
+        }
+
+        if (bd::load_le32(m_map + 8) != FORMAT_VERSION)
+        {
+            corrupt(file, "unsupported version");
+        }
+
+        const unsigned char* trailer = m_map + m_length - TRAILER_LENGTH;
+        if (std::memcmp(trailer + 32, MAGIC.data(), MAGIC.size()) != 0)
+        {
+            corrupt(file, "bad trailer");
+        }
+
+        const std::uint64_t directory = bd::load_le64(trailer);
+        const std::uint64_t blocks = bd::load_le64(trailer + 8);
+
+        if (directory < HEADER_LENGTH || directory > m_length - TRAILER_LENGTH
+            || blocks != (m_length - TRAILER_LENGTH - directory) / ENTRY_LENGTH
+            || (m_length - TRAILER_LENGTH - directory) % ENTRY_LENGTH != 0)
+        {
+            corrupt(file, "bad directory");
+        }
+
+        m_directory = m_map + directory;
+        m_blocks = static_cast<std::size_t>(blocks);
+        m_total = { .bytes = bd::load_le64(trailer + 16), .bits = bd::load_le64(trailer + 24) };
+
+        for (std::size_t i = 0; i < m_blocks; ++i)
+        {
+            const index_entry_s e = getEntry(i);
+            if (e.position < HEADER_LENGTH || e.position + e.length > directory || e.records == 0 || e.first > e.last)
+            {
+                corrupt(file, "bad block entry");
+            }
+        }
+    }
+    catch (...)
+    {
+        cleanup();
+        throw;
+    }
+}
+
+void bd::IndexReader::cleanup() noexcept
+{
+    if (m_map != nullptr)
+    {
+        ::munmap(const_cast<unsigned char*>(m_map), m_length);
+        m_map = nullptr;
+    }
+}
+
+std::size_t bd::IndexReader::getBlockCount() const noexcept
+{
+    return m_blocks;
+}
+
+bd::diff_count bd::IndexReader::getTotal() const noexcept
+{
+    return m_total;
+}
+
+bd::index_entry_s bd::IndexReader::getEntry(const std::size_t block) const noexcept
+{
+    const unsigned char* raw = m_directory + (block * ENTRY_LENGTH);
+
+    return {
+        .first = bd::load_le64(raw),
+        .last = bd::load_le64(raw + 8),
+        .position = bd::load_le64(raw + 16),
+        .length = bd::load_le32(raw + 24),
+        .records = bd::load_le32(raw + 28),
+        .bytesBefore = bd::load_le64(raw + 32),
+        .bitsBefore = bd::load_le64(raw + 40)
+    };
+}
+
+std::size_t bd::IndexReader::findBlock(const std::uint64_t offset) const noexcept
+{
+    std::size_t lo = 0;
+    std::size_t hi = m_blocks;
+
+    while (lo < hi)
+    {
+        const std::size_t mid = lo + ((hi - lo) / 2);
+        if (getEntry(mid).last < offset)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+void bd::IndexReader::decode(const std::size_t block, std::vector<index_record_s>& records) const
+{
+    const index_entry_s e = getEntry(block);
+
+    std::vector<unsigned char> raw(static_cast<std::size_t>(e.records) * MAX_RECORD_LENGTH);
+    uLongf rawLength = static_cast<uLongf>(raw.size());
+
+    if (::uncompress(raw.data(), &rawLength, m_map + e.position, e.length) != Z_OK)
+    {
+        throw std::runtime_error("Index block decompression failed");
+    }
+
+    records.clear();
+    records.reserve(e.records);
+
+    const unsigned char* pos = raw.data();
+    const unsigned char* const end = pos + rawLength;
+
+    std::uint64_t offset = e.first;
+    for (std::uint32_t i = 0; i < e.records; ++i)
+    {
+        std::uint64_t delta = 0;
+        for (unsigned int shift = 0;; shift += 7)
+        {
+            if (pos == end || shift > 63)
+            {
+                throw std::runtime_error("Index block is truncated");
+            }
+
+            const unsigned char v = *pos++;
+            delta |= static_cast<std::uint64_t>(v & 0x7F) << shift;
+            if ((v & 0x80) == 0)
+            {
+                break;
+            }
+        }
+
+        if (end - pos < 2)
+        {
+            throw std::runtime_error("Index block is truncated");
+        }
+
+        offset += delta;
+        records.push_back({ .offset = offset, .a = pos[0], .b = pos[1] });
+        pos += 2;
+    }
+}
+
+bd::diff_count bd::IndexReader::countBlock(const std::size_t block, const std::uint64_t begin, const std::uint64_t end) const
+{
+    std::vector<index_record_s> records;
+    decode(block, records);
+
+    diff_count ret{ .bytes = 0, .bits = 0 };
+    for (const index_record_s& r : records)
+    {
+        if (r.offset >= begin && r.offset < end)
+        {
+            ++ret.bytes;
+            ret.bits += bit_count(r.a, r.b);
+        }
+    }
+
+    return ret;
+}
+
+std::uint64_t bd::IndexReader::bytesBefore(const std::size_t block) const noexcept
+{
+    return (block == m_blocks) ? m_total.bytes : getEntry(block).bytesBefore;
+}
+
+std::uint64_t bd::IndexReader::bitsBefore(const std::size_t block) const noexcept
+{
+    return (block == m_blocks) ? m_total.bits : getEntry(block).bitsBefore;
+}
+
+bd::diff_count bd::IndexReader::count(const std::uint64_t begin, const std::uint64_t end) const
+{
+    diff_count ret{ .bytes = 0, .bits = 0 };
+    if (begin >= end)
+    {
+        return ret;
+    }
+
+    // The block holding begin and the block holding end may be partial and
+    // are decoded; every block strictly between them lies inside the range
+    // and is summed from the directory prefix counts.
+    const std::size_t first = findBlock(begin);
+    const std::size_t last = findBlock(end);
+
+    if (first == m_blocks)
+    {
+        return ret;
+    }
+
+    if (first == last)
+    {
+        return (getEntry(first).first < end) ? countBlock(first, begin, end) : ret;
+    }
+
+    std::size_t whole = first;
+    if (getEntry(first).first < begin)
+    {
+        ret = countBlock(first, begin, end);
+        ++whole;
+    }
+
+    ret.bytes += bytesBefore(last) - bytesBefore(whole);
+    ret.bits += bitsBefore(last) - bitsBefore(whole);
+
+    if (last < m_blocks && getEntry(last).first < end)
+    {
+        const diff_count part = countBlock(last, begin, end);
+        ret.bytes += part.bytes;
+        ret.bits += part.bits;
+    }
+
+    return ret;
+}
@@ -0,0 +1,397 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <mutex>
+#include <thread>
+#include <stop_token>
+#include <algorithm>
+
+#include <condition_variable>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <exception>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+    #include <sys/sysmacros.h>
+#endif
+
+#include "bitdiff/arena.hpp"
+#include "bitdiff/reader.hpp"
+#include "bitdiff/placement.hpp"
+#include "bitdiff/trace.hpp"
+#include "bitdiff/interleave.hpp"
+
+namespace bd = isaki::bitdiff;
+namespace fs = std::filesystem;
+
+namespace
+{
+    // Ring depth per input, in extents.
+    constexpr std::size_t RING_EXTENTS = 2;
+
+    std::size_t round_up(const std::size_t len, const std::size_t align) noexcept
+    {
+        return ((len + align - 1) / align) * align;
+    }
+
+    std::size_t slots_per_extent(const std::size_t chunkSize, const std::size_t extentSize) noexcept
+    {
+        return std::max<std::size_t>(1, round_up(extentSize, chunkSize) / chunkSize);
+    }
+
+#ifdef __linux__
+    // Resolves the sysfs directory of the whole disk backing file.
+    fs::path disk_sysfs(const fs::path& file)
+    {
+        struct stat st{};
+        if (::stat(file.c_str(), &st) != 0)
+        {
+            return {};
+        }
+
+        std::string dev;
+        dev.append("/sys/dev/block/");
+        dev.append(std::to_string(major(st.st_dev)));
+        dev.append(":");
+        dev.append(std::to_string(minor(st.st_dev)));
+
+        std::error_code ec;
+        fs::path real = fs::canonical(dev, ec);
+        if (ec)
+        {
+            return {};
+        }
+
+        // Partitions have no queue of their own.
+        if (fs::exists(real / "partition", ec))
+        {
+            real = real.parent_path();
+        }
+
+        return real;
+    }
+#endif
+}
+
+bool bd::share_rotational_device(const fs::path& a, const fs::path& b) noexcept
+{
+#ifdef __linux__
+    try
+    {
+        const fs::path diskA = disk_sysfs(a);
+        if (diskA.empty() || diskA != disk_sysfs(b))
+        {
+            return false;
+        }
+
+        std::ifstream in(diskA / "queue" / "rotational");
+        int rotational = 0;
+        return (in >> rotational) && rotational == 1;
+    }
+    catch (...)
+    {
+        return false;
+    }
+#else
+    static_cast<void>(a);
+    static_cast<void>(b);
+    return false;
+#endif
+}
+
+//
+// PORT
+//
+
+bd::InterleavedReader::Port::Port(InterleavedReader& owner, const std::size_t lane) noexcept :
+    m_owner(owner),
+    m_lane(lane) {}
+
+bd::InterleavedReader::Port::~Port() = default;
+
+std::size_t bd::InterleavedReader::Port::read(unsigned char* buffer)
+{
+    return m_owner.take(m_lane, buffer);
+}
+
+void bd::InterleavedReader::Port::setFillSize(std::size_t)
+{
+    // Fixed geometry.
+}
+
+double bd::InterleavedReader::Port::getFillRate()
+{
+    return 0.0;
+}
+
+//
+// SCHEDULER
+//
+
+bd::InterleavedReader::~InterleavedReader()
+{
+    // Wakes the scheduler if it is waiting on free slots; it will mark both
+    // lanes finished before exiting.
+    m_thread.request_stop();
+    m_thread.join();
+
+    cleanup();
+}
+
+bd::InterleavedReader::InterleavedReader(
+    const fs::path& a,
+    const fs::path& b,
+    Arena& arena,
+    const std::size_t chunkSize,
+    const std::size_t extentSize,
+    const bool keepCache,
+    const std::uintmax_t startOffset) :
+    m_chunk(chunkSize),
+    m_slotsPerExtent(slots_per_extent(chunkSize, extentSize)),
+    m_slots(m_slotsPerExtent * RING_EXTENTS),
+    m_keepCache(keepCache),
+    m_lanes{},
+    m_portA(*this, 0),
+    m_portB(*this, 1),
+    m_error(nullptr)
+{
+    const fs::path* paths[2] = { &a, &b };
+
+    for (lane_s& lane : m_lanes)
+    {
+        lane.offset = startOffset;
+        lane.consumed = startOffset;
+        lane.dropped = startOffset;
+    }
+
+    try
+    {
+        for (std::size_t i = 0; i < 2; ++i)
+        {
+            lane_s& lane = m_lanes[i];
+
+            lane.fd = open_read(*paths[i]);
+
+            if (startOffset > 0 && ::lseek(lane.fd.get(), static_cast<off_t>(startOffset), SEEK_SET) < 0)
+            {
+                throw std::system_error(errno, std::generic_category(), "Unable to seek");
+            }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+            if (!m_keepCache)
+            {
+                ::posix_fadvise(lane.fd.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+            }
+#endif
+
+            lane.pool = arena.allocate<unsigned char>(m_slots * m_chunk, IO_ALIGNMENT);
+            lane.lengths = arena.allocate<std::size_t>(m_slots, alignof(std::size_t));
+        }
+
+        // This must be the last call before the end of the try block.
+        m_thread = std::jthread([this](std::stop_token stop)
+        {
+            trace_thread_name("interleave");
+            place_thread("interleave");
+            this->run(stop);
+        });
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "InterleavedReader initialization failure: " << e.what() << std::endl;
+        cleanup();
+        throw;
+    }
+}
+
+bd::ChunkSource& bd::InterleavedReader::getSourceA() noexcept
+{
+    return m_portA;
+}
+
+bd::ChunkSource& bd::InterleavedReader::getSourceB() noexcept
+{
+    return m_portB;
+}
+
+std::size_t bd::InterleavedReader::getPoolSize(const std::size_t chunkSize, const std::size_t extentSize) noexcept
+{
+    const std::size_t slots = slots_per_extent(chunkSize, extentSize) * RING_EXTENTS;
+
+    // Per lane: page aligned pool plus the length table.
+    const std::size_t lane = round_up(slots * chunkSize, IO_ALIGNMENT) + (slots * sizeof(std::size_t)) + IO_ALIGNMENT;
+    return 2 * lane;
+}
+
+std::size_t bd::InterleavedReader::take(const std::size_t index, unsigned char* buffer)
+{
+    lane_s& lane = m_lanes[index];
+
+    std::unique_lock<std::mutex> lock(m_mtx);
+
+    {
+        const TraceSpan span("wait");
+        m_slotFull.wait(lock, [&lane] { return lane.filled > 0 || lane.eos; });
+    }
+
+    if (m_error) [[unlikely]]
+    {
+        std::rethrow_exception(m_error);
+    }
+
+    if (lane.filled == 0)
+    {
+        return 0;
+    }
+
+    const std::size_t len = lane.lengths[lane.head];
+    std::memcpy(buffer, lane.pool + (lane.head * m_chunk), len);
+
+    lane.head = (lane.head + 1) % m_slots;
+    --lane.filled;
+    lane.consumed += len;
+
+    m_slotFree.notify_one();
+
+    return len;
+}
+
+void bd::InterleavedReader::run(std::stop_token stop)
+{
+    std::size_t current = 0;
+
+    try
+    {
+        while (!stop.stop_requested())
+        {
+            lane_s& lane = m_lanes[current];
+            const lane_s& other = m_lanes[current ^ 1];
+
+            std::size_t tail;
+            std::uintmax_t dropFrom;
+            std::uintmax_t dropTo;
+            {
+                std::unique_lock<std::mutex> lock(m_mtx);
+
+                // Only start an extent when all of it fits, so each switch
+                // between files covers a full extent.
+                const TraceSpan span("wait");
+                m_slotFree.wait(lock, stop, [this, &lane]
+                {
+                    return lane.eos || m_slots - lane.filled >= m_slotsPerExtent;
+                });
+
+                if (stop.stop_requested() || (lane.eos && other.eos))
+                {
+                    break;
+                }
+
+                if (lane.eos)
+                {
+                    current ^= 1;
+                    continue;
+                }
+
+                tail = (lane.head + lane.filled) % m_slots;
+                dropFrom = lane.dropped;
+                dropTo = lane.consumed;
+                lane.dropped = dropTo;
+            }
+
+#ifdef POSIX_FADV_DONTNEED
+            if (!m_keepCache && dropTo > dropFrom)
+            {
+                ::posix_fadvise(
+                    lane.fd.get(),
+                    static_cast<off_t>(dropFrom),
+                    static_cast<off_t>(dropTo - dropFrom),
+                    POSIX_FADV_DONTNEED);
+            }
+#else
+            static_cast<void>(dropFrom);
+            static_cast<void>(dropTo);
+#endif
+
+            // Slots past the ring tail belong to this thread until published.
+            for (std::size_t i = 0; i < m_slotsPerExtent && !stop.stop_requested(); ++i)
+            {
+                const std::size_t slot = (tail + i) % m_slots;
+                const std::size_t len = fillSlot(lane, slot);
+
+                std::scoped_lock<std::mutex> lock(m_mtx);
+                lane.lengths[slot] = len;
+                lane.offset += len;
+
+                if (len > 0)
+                {
+                    ++lane.filled;
+                }
+
+                if (len < m_chunk)
+                {
+                    lane.eos = true;
+                }
+
+                m_slotFull.notify_all();
+
+                if (lane.eos)
+                {
+                    break;
+                }
+            }
+
+            if (!other.eos)
+            {
+                current ^= 1;
+            }
+        }
+    }
+    catch (...)
+    {
+        std::scoped_lock<std::mutex> lock(m_mtx);
+        m_error = std::current_exception();
+    }
+
+    std::scoped_lock<std::mutex> lock(m_mtx);
+    m_lanes[0].eos = true;
+    m_lanes[1].eos = true;
+    m_slotFull.notify_all();
+
+    // End of thread reached.
+}
+
+std::size_t bd::InterleavedReader::fillSlot(lane_s& lane, const std::size_t slot)
+{
+    place_sample();
+
+    const TraceSpan span("fill");
+    return read_fully(lane.fd.get(), lane.pool + (slot * m_chunk), m_chunk);
+}
+
+// This is NOT thread safe.
+void bd::InterleavedReader::cleanup() noexcept
+{
+    for (lane_s& lane : m_lanes)
+    {
+        lane.fd.close();
+
+        // Pool memory belongs to the arena.
+        lane.pool = nullptr;
+        lane.lengths = nullptr;
+    }
+}
@@ -0,0 +1,441 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define BITDIFF_X86_KERNELS 1
+    #include <immintrin.h>
+#endif
+
+#include "bitdiff/kernel.hpp"
+
+namespace bd = isaki::bitdiff;
+
+namespace
+{
+    using FindFunc = std::size_t (*)(const unsigned char*, const unsigned char*, std::size_t) noexcept;
+
+    struct kernel_s
+    {
+        std::string_view name;
+        FindFunc find;
+        bool (*supported)() noexcept;
+    };
+
+    // Popcount and the record formatters run once per differing word, so
+    // they are chosen separately from the compare and by other features.
+    struct bit_kernel_s
+    {
+        std::string_view name;
+        int (*count)(std::uint64_t) noexcept;
+        void (*hex)(char*, std::uint64_t, std::size_t) noexcept;
+        void (*bits)(char*, std::uint64_t, std::uint64_t, std::size_t) noexcept;
+        bool (*supported)() noexcept;
+    };
+
+    std::size_t find_tail(const unsigned char* a, const unsigned char* b, std::size_t i, const std::size_t len) noexcept
+    {
+        for (; i < len; ++i)
+        {
+            if (a[i] != b[i])
+            {
+                return i;
+            }
+        }
+
+        return len;
+    }
+
+    // Eight bytes per step; portable to any target.
+    std::size_t find_generic(const unsigned char* a, const unsigned char* b, const std::size_t len) noexcept
+    {
+        std::size_t i = 0;
+        for (; i + 8 <= len; i += 8)
+        {
+            std::uint64_t x;
+            std::uint64_t y;
+            std::memcpy(&x, a + i, 8);
+            std::memcpy(&y, b + i, 8);
+
+            if (const std::uint64_t d = x ^ y; d != 0)
+            {
+                if constexpr (std::endian::native == std::endian::little)
+                {
+                    return i + static_cast<std::size_t>(std::countr_zero(d) >> 3);
+                }
+                else
+                {
+                    return i + static_cast<std::size_t>(std::countl_zero(d) >> 3);
+                }
+            }
+        }
+
+        return find_tail(a, b, i, len);
+    }
+
+    bool always() noexcept
+    {
+        return true;
+    }
+
+#ifdef BITDIFF_X86_KERNELS
+    // Each variant scans four vectors per step while the data is equal and
+    // drops to single vectors to locate a hit.
+
+    __attribute__((target("sse2")))
+    std::size_t find_sse2(const unsigned char* a, const unsigned char* b, const std::size_t len) noexcept
+    {
+        constexpr int EQUAL = 0xFFFF;
+
+        std::size_t i = 0;
+        for (; i + 64 <= len; i += 64)
+        {
+            __m128i eq = _mm_cmpeq_epi8(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+
+            for (std::size_t k = 16; k < 64; k += 16)
+            {
+                eq = _mm_and_si128(eq, _mm_cmpeq_epi8(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + k)),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + k))));
+            }
+
+            if (_mm_movemask_epi8(eq) != EQUAL)
+            {
+                break;
+            }
+        }
+
+        for (; i + 16 <= len; i += 16)
+        {
+            const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+
+            if (mask != EQUAL)
+            {
+                return i + static_cast<std::size_t>(std::countr_zero(static_cast<unsigned>(~mask & EQUAL)));
+            }
+        }
+
+        return find_tail(a, b, i, len);
+    }
+
+    __attribute__((target("avx2")))
+    std::size_t find_avx2(const unsigned char* a, const unsigned char* b, const std::size_t len) noexcept
+    {
+        constexpr int EQUAL = -1;
+
+        std::size_t i = 0;
+        for (; i + 128 <= len; i += 128)
+        {
+            __m256i eq = _mm256_cmpeq_epi8(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+
+            for (std::size_t k = 32; k < 128; k += 32)
+            {
+                eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + k)),
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + k))));
+            }
+
+            if (_mm256_movemask_epi8(eq) != EQUAL)
+            {
+                break;
+            }
+        }
+
+        for (; i + 32 <= len; i += 32)
+        {
+            const int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i))));
+
+            if (mask != EQUAL)
+            {
+                return i + static_cast<std::size_t>(std::countr_zero(~static_cast<unsigned>(mask)));
+            }
+        }
+
+        return find_tail(a, b, i, len);
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    std::size_t find_avx512(const unsigned char* a, const unsigned char* b, const std::size_t len) noexcept
+    {
+        std::size_t i = 0;
+        for (; i + 256 <= len; i += 256)
+        {
+            __mmask64 ne = 0;
+            for (std::size_t k = 0; k < 256; k += 64)
+            {
+                ne |= _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(a + i + k), _mm512_loadu_si512(b + i + k));
+            }
+
+            if (ne != 0)
+            {
+                break;
+            }
+        }
+
+        for (; i < len; i += 64)
+        {
+            // The final step masks off bytes past len.
+            const std::size_t rem = len - i;
+            const __mmask64 live = (rem >= 64) ? ~__mmask64(0) : ((__mmask64(1) << rem) - 1);
+
+            const __mmask64 ne = _mm512_mask_cmpneq_epi8_mask(
+                live,
+                _mm512_maskz_loadu_epi8(live, a + i),
+                _mm512_maskz_loadu_epi8(live, b + i));
+
+            if (ne != 0)
+            {
+                return i + static_cast<std::size_t>(std::countr_zero(static_cast<std::uint64_t>(ne)));
+            }
+        }
+
+        return len;
+    }
+
+    bool has_sse2() noexcept
+    {
+        return __builtin_cpu_supports("sse2");
+    }
+
+    bool has_avx2() noexcept
+    {
+        return __builtin_cpu_supports("avx2");
+    }
+
+    bool has_avx512() noexcept
+    {
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    }
+#endif
+
+    //
+    // Bit kernels. The formatters build eight characters at a time, one
+    // per byte of a word: byte i of a spread value holds nibble or bit i.
+    //
+
+    // Writes the first len characters of s, byte 7 first.
+    void store_chars(char* out, const std::uint64_t s, const std::size_t len) noexcept
+    {
+        std::uint64_t v = s;
+        if constexpr (std::endian::native == std::endian::little)
+        {
+            v = __builtin_bswap64(s);
+        }
+
+        std::memcpy(out, &v, len);
+    }
+
+    std::uint64_t hex_chars(const std::uint64_t nibbles) noexcept
+    {
+        // Digits past 9 move up by 'a' - '0' - 10.
+        const std::uint64_t letters = ((nibbles + 0x0606060606060606ULL) >> 4) & 0x0101010101010101ULL;
+        return nibbles + 0x3030303030303030ULL + (letters * 39);
+    }
+
+    std::uint64_t bit_chars(const std::uint64_t value, const std::uint64_t shown) noexcept
+    {
+        // '.' for hidden bits; '0' and '1' are two and three above it.
+        return 0x2E2E2E2E2E2E2E2EULL + (shown << 1) + (value & shown);
+    }
+
+    // Nibble i of the low 32 bits of v to byte i.
+    std::uint64_t spread_nibbles(const std::uint64_t v) noexcept
+    {
+        std::uint64_t x = v & 0xFFFFFFFFULL;
+        x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+        x = (x | (x << 8)) & 0x00FF00FF00FF00FFULL;
+        return (x | (x << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    }
+
+    // Bit i of the low byte of v to byte i.
+    std::uint64_t spread_bits(const std::uint64_t v) noexcept
+    {
+        const std::uint64_t y = ((v & 0xFF) * 0x0101010101010101ULL) & 0x8040201008040201ULL;
+        return ((y + 0x7F7F7F7F7F7F7F7FULL) >> 7) & 0x0101010101010101ULL;
+    }
+
+    int count_generic(const std::uint64_t x) noexcept
+    {
+        return std::popcount(x);
+    }
+
+    void hex_generic(char* out, const std::uint64_t value, const std::size_t bytes) noexcept
+    {
+        // Four bytes per step, moved to the top of the low 32 bits.
+        for (std::size_t done = 0; done < bytes; done += 4)
+        {
+            const std::size_t take = std::min<std::size_t>(bytes - done, 4);
+            const std::uint64_t part = (value >> (8 * (bytes - done - take))) << (8 * (4 - take));
+
+            store_chars(out + (2 * done), hex_chars(spread_nibbles(part)), 2 * take);
+        }
+    }
+
+    void bits_generic(char* out, const std::uint64_t value, const std::uint64_t shown, const std::size_t bytes) noexcept
+    {
+        for (std::size_t i = 0; i < bytes; ++i)
+        {
+            const std::size_t shift = 8 * (bytes - i - 1);
+            store_chars(out + (8 * i), bit_chars(spread_bits(value >> shift), spread_bits(shown >> shift)), 8);
+        }
+    }
+
+#ifdef BITDIFF_X86_KERNELS
+    __attribute__((target("popcnt")))
+    int count_popcnt(const std::uint64_t x) noexcept
+    {
+        return std::popcount(x);
+    }
+
+    // PDEP spreads in one instruction what the generic versions do in
+    // several.
+
+    __attribute__((target("bmi2")))
+    void hex_bmi2(char* out, const std::uint64_t value, const std::size_t bytes) noexcept
+    {
+        for (std::size_t done = 0; done < bytes; done += 4)
+        {
+            const std::size_t take = std::min<std::size_t>(bytes - done, 4);
+            const std::uint64_t part = (value >> (8 * (bytes - done - take))) << (8 * (4 - take));
+
+            const std::uint64_t nibbles = _pdep_u64(part & 0xFFFFFFFFULL, 0x0F0F0F0F0F0F0F0FULL);
+            store_chars(out + (2 * done), hex_chars(nibbles), 2 * take);
+        }
+    }
+
+    __attribute__((target("bmi2")))
+    void bits_bmi2(char* out, const std::uint64_t value, const std::uint64_t shown, const std::size_t bytes) noexcept
+    {
+        for (std::size_t i = 0; i < bytes; ++i)
+        {
+            const std::size_t shift = 8 * (bytes - i - 1);
+            const std::uint64_t v = _pdep_u64((value >> shift) & 0xFF, 0x0101010101010101ULL);
+            const std::uint64_t m = _pdep_u64((shown >> shift) & 0xFF, 0x0101010101010101ULL);
+
+            store_chars(out + (8 * i), bit_chars(v, m), 8);
+        }
+    }
+
+    bool has_popcnt() noexcept
+    {
+        return __builtin_cpu_supports("popcnt");
+    }
+
+    // PDEP is microcoded, and slower than the generic spread, on AMD
+    // before Zen 3.
+    bool has_fast_bmi2() noexcept
+    {
+        return __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("popcnt")
+            && !__builtin_cpu_is("amdfam15h") && !__builtin_cpu_is("amdfam17h");
+    }
+#endif
+
+    // Best first.
+    constexpr kernel_s KERNELS[] = {
+#ifdef BITDIFF_X86_KERNELS
+        { .name = "avx512", .find = find_avx512, .supported = has_avx512 },
+        { .name = "avx2", .find = find_avx2, .supported = has_avx2 },
+        { .name = "sse2", .find = find_sse2, .supported = has_sse2 },
+#endif
+        { .name = "generic", .find = find_generic, .supported = always }
+    };
+
+    constexpr bit_kernel_s BIT_KERNELS[] = {
+#ifdef BITDIFF_X86_KERNELS
+        { .name = "bmi2", .count = count_popcnt, .hex = hex_bmi2, .bits = bits_bmi2, .supported = has_fast_bmi2 },
+        { .name = "popcnt", .count = count_popcnt, .hex = hex_generic, .bits = bits_generic, .supported = has_popcnt },
+#endif
+        { .name = "generic", .count = count_generic, .hex = hex_generic, .bits = bits_generic, .supported = always }
+    };
+
+    template <typename K, std::size_t N>
+    const K* select_best(const K (&table)[N]) noexcept
+    {
+#ifdef BITDIFF_X86_KERNELS
+        // Required when called before main().
+        __builtin_cpu_init();
+#endif
+
+        for (const K& k : table)
+        {
+            if (k.supported())
+            {
+                return &k;
+            }
+        }
+
+        return &table[N - 1];
+    }
+
+    template <typename K, std::size_t N>
+    bool select_named(const K (&table)[N], const K*& active, const std::string_view name) noexcept
+    {
+        for (const K& k : table)
+        {
+            if (k.name == name && k.supported())
+            {
+                active = &k;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    const kernel_s* g_kernel = select_best(KERNELS);
+    const bit_kernel_s* g_bit_kernel = select_best(BIT_KERNELS);
+}
+
+std::size_t bd::find_difference(const unsigned char* a, const unsigned char* b, const std::size_t len) noexcept
+{
+    return g_kernel->find(a, b, len);
+}
+
+std::string_view bd::get_kernel_name() noexcept
+{
+    return g_kernel->name;
+}
+
+#ifndef __POPCNT__
+int bd::count_bits(const std::uint64_t x) noexcept
+{
+    return g_bit_kernel->count(x);
+}
+#endif
+
+void bd::format_hex(char* out, const std::uint64_t value, const std::size_t bytes) noexcept
+{
+    g_bit_kernel->hex(out, value, bytes);
+}
+
+void bd::format_bits(char* out, const std::uint64_t value, const std::uint64_t shown, const std::size_t bytes) noexcept
+{
+    g_bit_kernel->bits(out, value, shown, bytes);
+}
+
+std::string_view bd::get_bit_kernel_name() noexcept
+{
+    return g_bit_kernel->name;
+}
+
+bool bd::set_kernel(const std::string_view name) noexcept
+{
+    // Not short-circuited: "generic" is in both tables.
+    const bool compare = select_named(KERNELS, g_kernel, name);
+    const bool bits = select_named(BIT_KERNELS, g_bit_kernel, name);
+    return compare || bits;
+}
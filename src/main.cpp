@@ -5,14 +5,41 @@
 #include <filesystem>
 #include <string>
 #include <string_view>
+#include <memory>
+#include <system_error>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include <unistd.h>
 
 // ReSharper disable once CppUnusedIncludeDirective
 #include <cstddef>
 
 #include <boost/program_options.hpp>
 
+#include "bitdiff/arena.hpp"
+#include "bitdiff/compare.hpp"
 #include "bitdiff/dataout.hpp"
+#include "bitdiff/sink.hpp"
+#include "bitdiff/compress.hpp"
+#include "bitdiff/checkpoint.hpp"
+#include "bitdiff/daemon.hpp"
+#include "bitdiff/mask.hpp"
+#include "bitdiff/estimate.hpp"
+#include "bitdiff/interleave.hpp"
+#include "bitdiff/kernel.hpp"
+#include "bitdiff/placement.hpp"
+#include "bitdiff/trace.hpp"
 #include "bitdiff/bitdiff.hpp"
+#include "bitdiff/index.hpp"
+#include "bitdiff/shift.hpp"
+#include "bitdiff/vote.hpp"
+#include "bitdiff/tree.hpp"
+#include "bitdiff/watch.hpp"
 #include "bitdiff/version.hpp"
 
 namespace po = boost::program_options;
@@ -21,10 +48,97 @@ namespace fs = std::filesystem;
 
 namespace
 {
-    // Default to a 2 MiB
-    constexpr std::size_t READ_BUFFER_LENGTH = 2 * 1024 * 1024;
+    // Upper bound for automatic sizing; fills start at 2 MiB.
+    constexpr std::size_t READ_BUFFER_LENGTH = 16 * 1024 * 1024;
     constexpr std::size_t KIB_PER_GIB = 0x100000;
 
+    // Default seconds between checkpoints.
+    constexpr std::size_t CHECKPOINT_INTERVAL = 30;
+
+    // Default bytes read by --estimate, in MiB.
+    constexpr std::size_t SAMPLE_BUDGET_MIB = 64;
+
+    constexpr std::size_t MIB_PER_GIB = 0x400;
+
+    // Scratch for one DataOut record in query output.
+    constexpr std::size_t QUERY_SCRATCH_LENGTH = 4096;
+
+    // Spans kept per thread by --trace; older ones are overwritten.
+    constexpr std::size_t TRACE_EVENTS_PER_THREAD = 1 << 16;
+
+    // Writes the trace once every traced object is gone, including when
+    // the run fails; a partial timeline is what explains the failure.
+    struct trace_guard_s
+    {
+        std::unique_ptr<bd::Tracer> tracer;
+        fs::path file;
+
+        ~trace_guard_s()
+        {
+            if (!tracer)
+            {
+                return;
+            }
+
+            try
+            {
+                tracer->write(file);
+                std::cerr << "Wrote trace " << file << std::endl;
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << e.what() << std::endl;
+            }
+        }
+    };
+
+    // One line of a --pairs list.
+    struct pair_entry_s
+    {
+        std::size_t line;
+        std::string a;
+        std::string b;
+    };
+
+    // Reads a --pairs list: "fileA TAB fileB" per line. Blank lines and
+    // lines starting with '#' are skipped.
+    std::vector<pair_entry_s> read_pair_list(const fs::path& file)
+    {
+        std::ifstream in(file);
+        if (!in)
+        {
+            std::string err;
+            err.append("Unable to open ");
+            err.append(file.string());
+            throw std::runtime_error(err);
+        }
+
+        std::vector<pair_entry_s> ret;
+        std::string text;
+        for (std::size_t line = 1; std::getline(in, text); ++line)
+        {
+            if (text.empty() || text.front() == '#')
+            {
+                continue;
+            }
+
+            const std::size_t tab = text.find('\t');
+            if (tab == 0 || tab == std::string::npos || tab + 1 == text.size() || text.find('\t', tab + 1) != std::string::npos)
+            {
+                std::string err;
+                err.append("Invalid pair on line ");
+                err.append(std::to_string(line));
+                err.append(" of ");
+                err.append(file.string());
+                throw std::runtime_error(err);
+            }
+
+            ret.push_back({ .line = line, .a = text.substr(0, tab), .b = text.substr(tab + 1) });
+        }
+
+        return ret;
+    }
+
     std::string argv_basename(const char* name)
     {
         const std::string_view tmp(name);
@@ -32,15 +146,132 @@ namespace
         return p.filename().string();
     }
 
+    void print_fraction(std::ostream& os, const std::string_view what, const double fraction, const double margin, const std::uintmax_t projected)
+    {
+        os << what << ": "
+            << std::fixed << std::setprecision(4)
+            << (fraction * 100.0) << "% +/- " << (margin * 100.0) << "% (95% CI); about "
+            << projected << " total"
+            << std::endl;
+    }
+
     void print_help(std::ostream& os, const std::string_view name, const po::options_description& desc)
     {
-        os << name << " <fileA> <fileB>\n" << std::endl;
+        os << name << " <fileA> <fileB>\n";
+        os << name << " --vote <fileA> <fileB> <fileC>\n";
+        os << name << " -r <dirA> <dirB>\n";
+        os << name << " --pairs <list>\n";
+        os << name << " query [--count] <index> [<start> <end>]\n" << std::endl;
         os << desc << std::endl;
 
         os << "Output Modes:\n";
         os << "  a : Bit difference format (default).\n";
         os << "  b : Binary format.\n";
-        os << "  x : Hexadecimal format." << std::endl;
+        os << "  x : Hexadecimal format.\n";
+        os << "  p : Binary patch turning fileA into fileB; apply with bitpatch." << std::endl;
+    }
+
+    // Answers range questions from an --index file; argv[1] is "query".
+    int run_query(int argc, char** argv)
+    {
+        po::options_description desc("Query options");
+        desc.add_options()
+            ("help,h", "Print this message.")
+            ("count,c", "Print the number of differing bytes and bits in the range instead of records.")
+            ("output-mode,m", po::value<char>(), "Record format: a, b or x (default: a).")
+        ;
+
+        po::options_description hidden("Hidden options");
+        hidden.add_options()
+            ("index", po::value<std::string>(), "The index to query")
+            ("start", po::value<std::string>(), "First offset of the range")
+            ("end", po::value<std::string>(), "Offset one past the range")
+        ;
+
+        po::options_description all;
+        all.add(desc).add(hidden);
+
+        po::positional_options_description posdesc;
+        posdesc.add("index", 1);
+        posdesc.add("start", 1);
+        posdesc.add("end", 1);
+
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc - 1, argv + 1).options(all).positional(posdesc).run(), vm);
+        po::notify(vm);
+
+        if (vm.contains("help"))
+        {
+            const std::string name = argv_basename(argv[0]);
+            std::cout << name << " query [--count] <index> [<start> <end>]\n" << std::endl;
+            std::cout << desc << std::endl;
+            return 0;
+        }
+
+        if (!vm.contains("index") || vm.contains("start") != vm.contains("end"))
+        {
+            std::cerr << "Invalid usage; please run with query --help" << std::endl;
+            return 1;
+        }
+
+        bd::DataOutType dataType = bd::DataOutType::Bits;
+        if (vm.contains("output-mode"))
+        {
+            switch (const char mode = vm["output-mode"].as<char>())
+            {
+                case 'a':
+                    dataType = bd::DataOutType::Bits;
+                    break;
+
+                case 'b':
+                    dataType = bd::DataOutType::Binary;
+                    break;
+
+                case 'x':
+                    dataType = bd::DataOutType::Hex;
+                    break;
+
+                default:
+                    std::cerr << "Invalid output-mode: " << mode << std::endl;
+                    return 1;
+            }
+        }
+
+        const bd::IndexReader index(fs::path(vm["index"].as<std::string>()));
+
+        // Offsets take any base std::stoull does; 0x prefixes are common.
+        std::uint64_t start = 0;
+        std::uint64_t end = UINT64_MAX;
+        if (vm.contains("start"))
+        {
+            start = std::stoull(vm["start"].as<std::string>(), nullptr, 0);
+            end = std::stoull(vm["end"].as<std::string>(), nullptr, 0);
+        }
+
+        if (vm.contains("count"))
+        {
+            const bd::diff_count dcount = index.count(start, end);
+            std::cout << dcount.bytes << '\t' << dcount.bits << std::endl;
+            return (dcount.bytes == 0) ? 0 : 11;
+        }
+
+        bd::Arena arena(QUERY_SCRATCH_LENGTH);
+        const std::unique_ptr<bd::DataOut> out = bd::make_data_out(dataType, '\t', 1, arena);
+
+        bd::FdSink sink(STDOUT_FILENO, false);
+        std::uintmax_t found = 0;
+
+        index.forEach(start, end, [&](const bd::index_record_s& r)
+        {
+            out->init(r.offset, r.a, r.b);
+            out->print(sink);
+            sink.write("\n", 1);
+            ++found;
+        });
+
+        sink.close();
+
+        return (found == 0) ? 0 : 11;
     }
 }
 
@@ -48,11 +279,17 @@ int main(int argc, char** argv)
 {
     // Improve performance for high-volume output.
     // Safe because we only use C++ streams for output (no mixing with C stdio).
+    // Diff records bypass std::cout entirely and go through bd::FdSink.
     std::ios_base::sync_with_stdio(false);
     std::cout.tie(nullptr);
 
     try
     {
+        if (argc > 1 && std::string_view(argv[1]) == "query")
+        {
+            return run_query(argc, argv);
+        }
+
         // Declare the supported options.
         po::options_description desc("Options");
         desc.add_options()
@@ -61,13 +298,45 @@ int main(int argc, char** argv)
             ("print-header,p", "Add a header to the output.")
             ("fast,f", "Disable flushing after each result line. Improves throughput when redirecting output.")
             ("output-mode,m", po::value<char>(), "The operating mode.")
+            ("word", po::value<std::size_t>(), "Compare and print whole words of 1, 2, 4 or 8 bytes (default: 1).")
+            ("endian", po::value<std::string>(), "Byte order of --word values: le or be (default: le).")
+            ("estimate", "Estimate how much the files differ from a random sample instead of diffing them.")
+            ("sample-budget", po::value<std::size_t>(), "MiB read from each file by --estimate (default: 64).")
+            ("block-bitmap", po::value<std::size_t>(), "Write a bitmap of which blocks of this many bytes differ instead of records.")
+            ("block-list", "With --block-bitmap, write the indices of differing blocks as text instead of the bitmap.")
+            ("vote", "Compare three replicas fileA, fileB and fileC, reporting the majority and the outlier.")
+            ("repair", po::value<std::string>(), "With --vote, write the bitwise majority of the replicas to the given file.")
+            ("shift", "Match content-defined chunks so inserted or removed data does not misalign the rest of the diff.")
+            ("daemon", po::value<std::string>(), "Have the bitdiffd listening on the given socket run the diff, keeping fileA mapped for later requests.")
+            ("watch", "Keep running and re-diff the blocks that change each time either file is written; stop with Ctrl-C.")
+            ("mask", po::value<std::string>(), "Ignore the byte ranges and bits listed in the given file.")
+            ("index", po::value<std::string>(), "Also record every difference in the given file for later range queries with the query command.")
+            ("output,o", po::value<std::string>(), "Write results to the given file instead of standard output.")
+            ("compress", po::value<std::string>(), "Compress the output with gzip or zstd on worker threads.")
+            ("vmsplice", "Splice output pages into standard output when it is a pipe.")
+            ("keep-cache", "Leave input data in the page cache instead of dropping it once compared.")
+            ("trace", po::value<std::string>(), "Write a Chrome trace-event timeline of reads, compares and output to the given file.")
+            ("checkpoint", po::value<std::string>(), "Periodically save progress to the given file.")
+            ("resume", "Continue the run saved by --checkpoint; requires --output and unchanged inputs and mask.")
+            ("recursive,r", "Compare every file beneath directories fileA and fileB, paired by relative path.")
+            ("pairs", po::value<std::string>(), "Diff every pair of files listed in the given file, one tab separated pair per line, "
+                "reusing the same readers and buffers for all of them.")
+            ("threads,j", po::value<std::size_t>(), "Worker threads for --recursive, --compress and record formatting with --fast (default: one per CPU).")
+            ("cpus", po::value<std::string>(), "Pin the consumer, reader and worker threads to these CPUs in turn, e.g. 0-3,8.")
+            ("numa-node", po::value<int>(), "Allocate buffers on this NUMA node, and run threads on its CPUs unless --cpus is given.")
+            ("extent", po::value<std::size_t>(), "Read both files from one thread in alternating extents of this many "
+                "MiB (0 disables), buffering four extents in all. Enabled automatically, with extents the size of "
+                "the read buffer, when both files share a rotational disk.")
         ;
 
         po::options_description hidden("Hidden options");
         hidden.add_options()
             ("read-buffer", po::value<std::size_t>(), "The size of read buffer in KiB satisfying [1KiB, 1GiB]")
+            ("checkpoint-interval", po::value<std::size_t>(), "Seconds between checkpoints")
+            ("kernel", po::value<std::string>(), "Force a kernel: avx512, avx2, sse2, bmi2, popcnt or generic")
             ("fileA", po::value<std::string>(), "The file A to diff")
             ("fileB", po::value<std::string>(), "The file B to diff")
+            ("fileC", po::value<std::string>(), "The file C for --vote")
         ;
 
         po::options_description all;
@@ -75,12 +344,19 @@ int main(int argc, char** argv)
 
         po::positional_options_description posdesc;
         posdesc.add("fileA", 1);
-        posdesc.add("fileB", 2);
+        posdesc.add("fileB", 1);
+        posdesc.add("fileC", 1);
 
         po::variables_map vm;
         po::store(po::command_line_parser(argc, argv).options(all).positional(posdesc).run(), vm);
         po::notify(vm);
 
+        if (vm.contains("kernel") && !bd::set_kernel(vm["kernel"].as<std::string>()))
+        {
+            std::cerr << "Kernel " << vm["kernel"].as<std::string>() << " is not available" << std::endl;
+            return 1;
+        }
+
         if (vm.contains("version"))
         {
             const std::string name = argv_basename(argv[0]);
@@ -94,31 +370,37 @@ int main(int argc, char** argv)
             return 0;
         }
 
-        if (!vm.contains("fileA") || !vm.contains("fileB"))
+        const bool pairsMode = vm.contains("pairs");
+        if (pairsMode ? vm.contains("fileA") : (!vm.contains("fileA") || !vm.contains("fileB") || vm.contains("vote") != vm.contains("fileC")))
         {
             std::cerr << "Invalid usage; please run with --help" << std::endl;
             return 1;
         }
 
-        std::size_t readBufferLength;
+        bd::read_options readOptions = {
+            .bufferSize = READ_BUFFER_LENGTH,
+            .adaptive = true,
+            .keepCache = vm.contains("keep-cache"),
+            .extentSize = 0,
+            .startOffset = 0
+        };
+
         if (vm.contains("read-buffer"))
         {
-            readBufferLength = vm["read-buffer"].as<std::size_t>();
+            std::size_t readBufferLength = vm["read-buffer"].as<std::size_t>();
             if (readBufferLength == 0 || readBufferLength > KIB_PER_GIB)
             {
                 std::cerr << "Invalid --read-buffer; please run with --help" << std::endl;
                 return 1;
             }
 
-            // Convert KiB to bytes.
-            readBufferLength = readBufferLength << 10;
-        }
-        else
-        {
-            readBufferLength = READ_BUFFER_LENGTH;
+            // Convert KiB to bytes. An explicit size is used as-is.
+            readOptions.bufferSize = readBufferLength << 10;
+            readOptions.adaptive = false;
         }
 
         bd::DataOutType dataType;
+        bool patchMode = false;
         if (vm.contains("output-mode"))
         {
             switch (const char mode = vm["output-mode"].as<char>())
@@ -135,6 +417,11 @@ int main(int argc, char** argv)
                     dataType = bd::DataOutType::Hex;
                     break;
 
+                case 'p':
+                    dataType = bd::DataOutType::Hex;
+                    patchMode = true;
+                    break;
+
                 default:
                     std::cerr << "Invalid output-mode: " << mode << std::endl;
                     return 1;
@@ -145,39 +432,521 @@ int main(int argc, char** argv)
             dataType = bd::DataOutType::Bits;
         }
 
-        const std::string fileA = vm["fileA"].as<std::string>();
-        const std::string fileB = vm["fileB"].as<std::string>();
+        bd::word_format_s word = bd::BYTE_FORMAT;
+        if (vm.contains("word"))
+        {
+            word.size = vm["word"].as<std::size_t>();
+            if (word.size != 1 && word.size != 2 && word.size != 4 && word.size != 8)
+            {
+                std::cerr << "Invalid --word: " << word.size << std::endl;
+                return 1;
+            }
+        }
+
+        if (vm.contains("endian"))
+        {
+            const std::string endian = vm["endian"].as<std::string>();
+            if (endian == "le")
+            {
+                word.endian = bd::Endian::Little;
+            }
+            else if (endian == "be")
+            {
+                word.endian = bd::Endian::Big;
+            }
+            else
+            {
+                std::cerr << "Invalid --endian: " << endian << std::endl;
+                return 1;
+            }
+        }
+
+        // Empty with --pairs; the files come from the list.
+        const std::string fileA = pairsMode ? std::string() : vm["fileA"].as<std::string>();
+        const std::string fileB = pairsMode ? std::string() : vm["fileB"].as<std::string>();
 
-        if (fileA == fileB)
+        if (!pairsMode && fileA == fileB)
         {
             std::cerr << "File A and B are the same path" << std::endl;
             return 0;
         }
 
-        std::cerr << "Initializing diff object" << std::endl;
+        if (vm.contains("extent"))
+        {
+            const std::size_t extent = vm["extent"].as<std::size_t>();
+            if (extent > MIB_PER_GIB)
+            {
+                std::cerr << "Invalid --extent; please run with --help" << std::endl;
+                return 1;
+            }
+
+            readOptions.extentSize = extent << 20;
+        }
+        else if (!pairsMode && !vm.contains("recursive") && !vm.contains("estimate") && !vm.contains("shift") && !vm.contains("vote") && !vm.contains("watch") && !vm.contains("daemon") && bd::share_rotational_device(fileA, fileB))
+        {
+            // Four extents replace the four read-buffer sized buffers of a
+            // threaded read, so interleaving costs no extra memory.
+            const std::size_t extentMib = (readOptions.bufferSize + (1 << 20) - 1) >> 20;
+            std::cerr << "Inputs share a rotational disk; reading in " << extentMib << " MiB extents" << std::endl;
+            readOptions.extentSize = extentMib << 20;
+        }
+
+        // Patches are written uncompressed; bitpatch reads the trailer from
+        // the end of the file.
+        if (patchMode && (vm.contains("recursive") || vm.contains("checkpoint") || vm.contains("word") || vm.contains("compress") || vm.contains("mask")))
+        {
+            std::cerr << "Patch mode does not support --recursive, --checkpoint, --word, --compress or --mask" << std::endl;
+            return 1;
+        }
+
+        if (vm.contains("shift") && (patchMode || vm.contains("recursive") || vm.contains("checkpoint") || vm.contains("word") || vm.contains("mask")))
+        {
+            std::cerr << "--shift does not support patch mode, --recursive, --checkpoint, --word or --mask" << std::endl;
+            return 1;
+        }
+
+        if (vm.contains("vote"))
+        {
+            if (vm.contains("output-mode") || vm.contains("recursive") || vm.contains("checkpoint") || vm.contains("word")
+                || vm.contains("mask") || vm.contains("shift") || vm.contains("block-bitmap") || vm.contains("estimate"))
+            {
+                std::cerr << "--vote does not support --output-mode, --recursive, --checkpoint, --word, --mask, --shift, "
+                    "--block-bitmap or --estimate" << std::endl;
+                return 1;
+            }
+        }
+        else if (vm.contains("repair"))
+        {
+            std::cerr << "--repair requires --vote" << std::endl;
+            return 1;
+        }
+
+        if (vm.contains("daemon") && (patchMode || vm.contains("recursive") || vm.contains("checkpoint") || vm.contains("shift") || vm.contains("vote")
+            || vm.contains("block-bitmap") || vm.contains("estimate") || vm.contains("index") || vm.contains("watch") || vm.contains("mask")
+            || vm.contains("print-header") || vm.contains("trace")))
+        {
+            std::cerr << "--daemon supports only --output-mode, --word, --endian, --output, --compress and --fast" << std::endl;
+            return 1;
+        }
+
+        if (vm.contains("watch") && (patchMode || vm.contains("recursive") || vm.contains("checkpoint") || vm.contains("shift") || vm.contains("vote")
+            || vm.contains("block-bitmap") || vm.contains("estimate") || vm.contains("index")))
+        {
+            std::cerr << "--watch does not support patch mode, --recursive, --checkpoint, --shift, --vote, --block-bitmap, --estimate or --index" << std::endl;
+            return 1;
+        }
+
+        if (vm.contains("index") && (vm.contains("recursive") || vm.contains("shift") || vm.contains("vote") || vm.contains("checkpoint") || vm.contains("estimate")))
+        {
+            std::cerr << "--index does not support --recursive, --shift, --vote, --checkpoint or --estimate" << std::endl;
+            return 1;
+        }
+
+        if (pairsMode && (patchMode || vm.contains("recursive") || vm.contains("checkpoint") || vm.contains("shift") || vm.contains("vote")
+            || vm.contains("block-bitmap") || vm.contains("estimate") || vm.contains("index") || vm.contains("watch") || vm.contains("daemon")
+            || vm.contains("extent")))
+        {
+            std::cerr << "--pairs does not support patch mode, --recursive, --checkpoint, --shift, --vote, --block-bitmap, --estimate, "
+                "--index, --watch, --daemon or --extent" << std::endl;
+            return 1;
+        }
+
+        const std::string fileC = vm.contains("fileC") ? vm["fileC"].as<std::string>() : std::string();
+
+        const std::size_t blockSize = vm.contains("block-bitmap") ? vm["block-bitmap"].as<std::size_t>() : 0;
+        if (vm.contains("block-bitmap"))
+        {
+            if (blockSize == 0)
+            {
+                std::cerr << "Invalid --block-bitmap; please run with --help" << std::endl;
+                return 1;
+            }
+
+            if (patchMode || vm.contains("recursive") || vm.contains("checkpoint") || vm.contains("word") || vm.contains("shift"))
+            {
+                std::cerr << "--block-bitmap does not support patch mode, --recursive, --checkpoint, --word or --shift" << std::endl;
+                return 1;
+            }
+        }
+        else if (vm.contains("block-list"))
+        {
+            std::cerr << "--block-list requires --block-bitmap" << std::endl;
+            return 1;
+        }
+
+        bd::Codec codec = bd::Codec::Gzip;
+        if (vm.contains("compress"))
+        {
+            const std::string name = vm["compress"].as<std::string>();
+            if (name == "gzip")
+            {
+                codec = bd::Codec::Gzip;
+            }
+            else if (name == "zstd")
+            {
+                codec = bd::Codec::Zstd;
+            }
+            else
+            {
+                std::cerr << "Invalid --compress: " << name << std::endl;
+                return 1;
+            }
+
+            if (!bd::codec_available(codec))
+            {
+                std::cerr << "This build does not support --compress " << name << std::endl;
+                return 1;
+            }
+
+            // Checkpoints record an uncompressed output position.
+            if (vm.contains("checkpoint"))
+            {
+                std::cerr << "--compress is not supported with --checkpoint" << std::endl;
+                return 1;
+            }
+        }
+
+        const std::size_t threads = vm.contains("threads") ? vm["threads"].as<std::size_t>() : 0;
+
+        std::unique_ptr<bd::Mask> mask;
+        if (vm.contains("mask"))
+        {
+            if (vm.contains("recursive"))
+            {
+                std::cerr << "--mask is not supported with --recursive" << std::endl;
+                return 1;
+            }
+
+            mask = std::make_unique<bd::Mask>(vm["mask"].as<std::string>());
+            std::cerr << "Loaded " << mask->getRangeCount() << " mask ranges" << std::endl;
+        }
+
+        if (vm.contains("estimate"))
+        {
+            if (vm.contains("recursive"))
+            {
+                std::cerr << "--estimate is not supported with --recursive" << std::endl;
+                return 1;
+            }
+
+            const std::size_t budget = vm.contains("sample-budget") ? vm["sample-budget"].as<std::size_t>() : SAMPLE_BUDGET_MIB;
+            if (budget == 0)
+            {
+                std::cerr << "Invalid --sample-budget; please run with --help" << std::endl;
+                return 1;
+            }
+
+            const bd::estimate_s est = bd::estimate_difference(fileA, fileB, static_cast<std::uintmax_t>(budget) << 20, mask.get());
+
+            std::cout << "Sampled " << est.sampledBytes << " of " << est.size << " bytes in " << est.blocks << " blocks" << std::endl;
+            print_fraction(std::cout, "Differing bytes", est.byteFraction, est.byteMargin, est.projected.bytes);
+            print_fraction(std::cout, "Differing bits", est.bitFraction, est.bitMargin, est.projected.bits);
+
+            return (est.sampled.bytes == 0) ? 0 : 11;
+        }
+
+        std::unique_ptr<bd::Checkpoint> checkpoint;
+        bd::checkpoint_s resumeState{};
+        const bool resume = vm.contains("resume");
+
+        if (vm.contains("checkpoint"))
+        {
+            if (vm.contains("recursive"))
+            {
+                std::cerr << "--checkpoint is not supported with --recursive" << std::endl;
+                return 1;
+            }
+
+            const std::size_t interval = vm.contains("checkpoint-interval")
+                ? vm["checkpoint-interval"].as<std::size_t>()
+                : CHECKPOINT_INTERVAL;
+
+            checkpoint = std::make_unique<bd::Checkpoint>(
+                vm["checkpoint"].as<std::string>(),
+                std::chrono::seconds(interval));
+
+            if (resume)
+            {
+                resumeState = checkpoint->load();
+                readOptions.startOffset = resumeState.offset;
+
+                std::cerr << "Resuming at offset " << resumeState.offset << std::endl;
+            }
+        }
+
+        if (resume && (!checkpoint || !vm.contains("output")))
+        {
+            std::cerr << "--resume requires --checkpoint and --output" << std::endl;
+            return 1;
+        }
+
+        // Declared ahead of the sink and diff objects so it outlives their
+        // threads.
+        trace_guard_s trace;
+        if (vm.contains("trace"))
+        {
+            trace.file = vm["trace"].as<std::string>();
+            trace.tracer = std::make_unique<bd::Tracer>(TRACE_EVENTS_PER_THREAD);
+            bd::trace_thread_name("consumer");
+        }
 
-        bd::BitDiff diff(fileA, fileB, readBufferLength, vm.contains("fast"));
+        // Installed before any thread or buffer it should place.
+        std::unique_ptr<bd::Placement> placement;
+        if (vm.contains("cpus") || vm.contains("numa-node"))
+        {
+            const int node = vm.contains("numa-node") ? vm["numa-node"].as<int>() : -1;
+            if (vm.contains("numa-node") && node < 0)
+            {
+                std::cerr << "Invalid --numa-node; please run with --help" << std::endl;
+                return 1;
+            }
 
-        std::cerr << "Size " << fileA << ": " << diff.getFileASize() << std::endl;
-        std::cerr << "Size " << fileB << ": " << diff.getFileBSize() << std::endl;
+            placement = std::make_unique<bd::Placement>(vm.contains("cpus") ? vm["cpus"].as<std::string>() : std::string(), node);
+            bd::place_thread("consumer");
+        }
+
+        std::unique_ptr<bd::FdSink> sink;
+        if (resume)
+        {
+            sink = std::make_unique<bd::FdSink>(fs::path(vm["output"].as<std::string>()), resumeState.outputOffset);
+        }
+        else if (vm.contains("output"))
+        {
+            const fs::path outFile(vm["output"].as<std::string>());
 
-        const bd::diff_count dcount = diff.process(std::cout, vm.contains("print-header"), dataType);
+            // Opening the output truncates it; refuse to clobber an input.
+            std::error_code ec;
+            if (fs::equivalent(outFile, fileA, ec) || fs::equivalent(outFile, fileB, ec) || (!fileC.empty() && fs::equivalent(outFile, fileC, ec)))
+            {
+                std::cerr << "Output file is one of the inputs" << std::endl;
+                return 1;
+            }
 
-        std::cerr << "Found " << dcount.bits << " bit difference";
-        if (dcount.bits != 1)
+            sink = std::make_unique<bd::FdSink>(outFile);
+        }
+        else
         {
-            std::cerr << "s";
+            sink = std::make_unique<bd::FdSink>(STDOUT_FILENO, vm.contains("vmsplice"));
         }
 
-        std::cerr << " across " << dcount.bytes << " byte";
-        if (dcount.bytes != 1)
+        // Declared after the sink it writes to, so it is destroyed first.
+        std::unique_ptr<bd::CompressSink> compressed;
+        bd::Sink* out = sink.get();
+        if (vm.contains("compress"))
         {
-            std::cerr << "s";
+            compressed = std::make_unique<bd::CompressSink>(*sink, codec, threads);
+            out = compressed.get();
         }
 
-        std::cerr << std::endl;
+        bd::diff_count dcount;
+        std::size_t unpaired = 0;
+        std::uintmax_t shifted = 0;
+        std::uint64_t dirtyBlocks = 0;
+        bd::vote_count votes{ .bytes = 0, .outliers = { 0, 0, 0 }, .split = 0 };
+
+        if (pairsMode)
+        {
+            const std::vector<pair_entry_s> pairs = read_pair_list(vm["pairs"].as<std::string>());
+
+            std::cerr << "Initializing diff session for " << pairs.size() << " pair" << ((pairs.size() != 1) ? "s" : "") << std::endl;
+
+            bd::DiffSession session(readOptions, vm.contains("fast"));
+            session.setMask(mask.get());
+            session.setFormatThreads((threads == 0) ? std::thread::hardware_concurrency() : threads);
+
+            if (vm.contains("print-header"))
+            {
+                const std::string unit = (word.size > 1) ? "Word" : "Byte";
+                const std::string header = "Line\tOffset\t" + unit + " in fileA\t" + unit + " in fileB\n";
+                out->write(header.data(), header.size());
+            }
+
+            // Records carry the line of their pair in the list.
+            dcount = { .bytes = 0, .bits = 0 };
+            for (const pair_entry_s& pair : pairs)
+            {
+                const std::string prefix = std::to_string(pair.line) + '\t';
+                const bd::diff_count pcount = session.diff(pair.a, pair.b, *out, prefix, dataType, word);
+
+                dcount.bytes += pcount.bytes;
+                dcount.bits += pcount.bits;
+            }
+
+            out->flush();
+
+            std::cerr << "Diffed " << session.getPairCount() << " pair" << ((session.getPairCount() != 1) ? "s" : "") << std::endl;
+        }
+        else if (vm.contains("recursive"))
+        {
+            std::cerr << "Scanning directory trees" << std::endl;
+
+            bd::TreeDiff tree(fileA, fileB, threads, vm.contains("fast"));
+
+            unpaired = tree.getUnpairedCount();
+            std::cerr << "Paired " << tree.getPairedCount() << " files; " << unpaired << " in one tree only" << std::endl;
+
+            dcount = tree.process(*out, vm.contains("print-header"), dataType, word);
+        }
+        else if (vm.contains("vote"))
+        {
+            std::cerr << "Initializing vote object" << std::endl;
+
+            bd::VoteDiff vote(fileA, fileB, fileC, readOptions.keepCache, vm.contains("fast"));
+            std::cerr << "Size: " << vote.getFileSize() << std::endl;
+
+            std::unique_ptr<bd::FdSink> repair;
+            if (vm.contains("repair"))
+            {
+                const fs::path repairFile(vm["repair"].as<std::string>());
+
+                std::error_code ec;
+                if (fs::equivalent(repairFile, fileA, ec) || fs::equivalent(repairFile, fileB, ec) || fs::equivalent(repairFile, fileC, ec))
+                {
+                    std::cerr << "Repair file is one of the inputs" << std::endl;
+                    return 1;
+                }
+
+                repair = std::make_unique<bd::FdSink>(repairFile);
+            }
+
+            votes = vote.process(*out, vm.contains("print-header"), repair.get());
+
+            if (repair)
+            {
+                // Only a complete copy is useful, so make sure it is durable.
+                repair->persist();
+                repair->close();
+                std::cerr << "Wrote majority to " << fs::path(vm["repair"].as<std::string>()) << std::endl;
+            }
+
+            dcount = { .bytes = votes.bytes, .bits = 0 };
+        }
+        else if (vm.contains("daemon"))
+        {
+            dcount = bd::daemon_request(fs::path(vm["daemon"].as<std::string>()), fileA, fileB, dataType, word, *out);
+        }
+        else if (vm.contains("watch"))
+        {
+            std::cerr << "Initializing watch object" << std::endl;
+
+            bd::WatchDiff watch(fileA, fileB, vm.contains("fast"));
+            dcount = watch.process(*out, vm.contains("print-header"), dataType, word, mask.get());
+        }
+        else if (vm.contains("shift"))
+        {
+            std::cerr << "Initializing diff object" << std::endl;
+
+            bd::ShiftDiff diff(fileA, fileB, readOptions.keepCache, vm.contains("fast"));
+
+            std::cerr << "Size " << fileA << ": " << diff.getFileASize() << std::endl;
+            std::cerr << "Size " << fileB << ": " << diff.getFileBSize() << std::endl;
+
+            const bd::shift_count scount = diff.process(*out, vm.contains("print-header"), dataType);
+
+            std::cerr << "Moved " << scount.moved << ", inserted " << scount.inserted << " and deleted " << scount.deleted << " bytes" << std::endl;
+
+            dcount = scount.changed;
+            shifted = scount.moved + scount.inserted + scount.deleted;
+        }
+        else
+        {
+            std::cerr << "Initializing diff object" << std::endl;
+
+            bd::BitDiff diff(fileA, fileB, readOptions, vm.contains("fast"));
+
+            std::cerr << "Size " << fileA << ": " << diff.getFileASize() << std::endl;
+            std::cerr << "Size " << fileB << ": " << diff.getFileBSize() << std::endl;
+
+            diff.setCheckpoint(checkpoint.get());
+            diff.setMask(mask.get());
+            diff.setFormatThreads((threads == 0) ? std::thread::hardware_concurrency() : threads);
+            if (resume)
+            {
+                diff.resume(resumeState);
+            }
+
+            std::unique_ptr<bd::IndexWriter> index;
+            if (vm.contains("index"))
+            {
+                const fs::path indexFile(vm["index"].as<std::string>());
+
+                std::error_code ec;
+                if (fs::equivalent(indexFile, fileA, ec) || fs::equivalent(indexFile, fileB, ec))
+                {
+                    std::cerr << "Index file is one of the inputs" << std::endl;
+                    return 1;
+                }
+
+                index = std::make_unique<bd::IndexWriter>(indexFile);
+                diff.setIndex(index.get());
+            }
+
+            if (patchMode)
+            {
+                dcount = diff.writePatch(*sink);
+            }
+            else if (blockSize > 0)
+            {
+                dcount = { .bytes = 0, .bits = 0 };
+                dirtyBlocks = diff.writeBlockMap(*out, blockSize, vm.contains("block-list"));
+            }
+            else
+            {
+                dcount = diff.process(*out, vm.contains("print-header"), dataType, word);
+            }
+
+            if (index)
+            {
+                index->finish();
+                std::cerr << "Wrote index " << fs::path(vm["index"].as<std::string>()) << std::endl;
+            }
+        }
+
+        if (compressed)
+        {
+            compressed->close();
+        }
+
+        sink->close();
+
+        if (checkpoint)
+        {
+            checkpoint->remove();
+        }
+
+        if (placement)
+        {
+            placement->report(std::cerr);
+        }
+
+        if (vm.contains("vote"))
+        {
+            std::cerr << "Replicas disagree at " << votes.bytes << " offset" << ((votes.bytes != 1) ? "s" : "")
+                << "; outliers: A " << votes.outliers[0] << ", B " << votes.outliers[1] << ", C " << votes.outliers[2]
+                << "; no majority replica at " << votes.split << std::endl;
+        }
+        else if (blockSize > 0)
+        {
+            std::cerr << "Found " << dirtyBlocks << " differing block" << ((dirtyBlocks != 1) ? "s" : "") << std::endl;
+        }
+        else
+        {
+            std::cerr << "Found " << dcount.bits << " bit difference";
+            if (dcount.bits != 1)
+            {
+                std::cerr << "s";
+            }
+
+            std::cerr << " across " << dcount.bytes << " byte";
+            if (dcount.bytes != 1)
+            {
+                std::cerr << "s";
+            }
+
+            std::cerr << std::endl;
+        }
 
-        if (dcount.bytes == 0)
+        if (dcount.bytes == 0 && unpaired == 0 && shifted == 0 && dirtyBlocks == 0)
         {
             return 0;
         }
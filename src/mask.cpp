@@ -0,0 +1,251 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bitdiff/endian.hpp"
+#include "bitdiff/hash.hpp"
+#include "bitdiff/mask.hpp"
+
+namespace bd = isaki::bitdiff;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr unsigned char ALL_BITS = 0xFF;
+
+    struct event_s
+    {
+        std::uintmax_t pos;
+        unsigned char bits;
+        int delta;
+    };
+
+    void throw_line(const fs::path& file, const std::size_t line, const std::string_view what)
+    {
+        std::string err;
+        err.append(file.string());
+        err.append(":");
+        err.append(std::to_string(line));
+        err.append(": ");
+        err.append(what);
+        throw std::runtime_error(err);
+    }
+
+    bool parse_number(const std::string& token, std::uintmax_t& out)
+    {
+        if (token.empty() || token[0] == '-')
+        {
+            return false;
+        }
+
+        try
+        {
+            std::size_t used = 0;
+            out = std::stoull(token, &used, 0);
+            return used == token.size();
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+    }
+}
+
+bd::Mask::~Mask() = default;
+
+bd::Mask::Mask(const fs::path& file)
+{
+    std::ifstream in(file);
+    if (!in.is_open())
+    {
+        std::string err;
+        err.append("Unable to open mask ");
+        err.append(file.string());
+        throw std::runtime_error(err);
+    }
+
+    std::vector<event_s> events;
+
+    std::string text;
+    for (std::size_t line = 1; std::getline(in, text); ++line)
+    {
+        if (const std::size_t hash = text.find('#'); hash != std::string::npos)
+        {
+            text.erase(hash);
+        }
+
+        std::istringstream fields(text);
+
+        std::string kind;
+        if (!(fields >> kind))
+        {
+            continue;
+        }
+
+        std::string token;
+        std::uintmax_t offset = 0;
+        std::uintmax_t length = 0;
+        std::uintmax_t bits = ALL_BITS;
+
+        if (!(fields >> token) || !parse_number(token, offset) || !(fields >> token) || !parse_number(token, length))
+        {
+            throw_line(file, line, "expected an offset and a length");
+        }
+
+        if (kind == "bits")
+        {
+            if (!(fields >> token) || !parse_number(token, bits) || bits > ALL_BITS)
+            {
+                throw_line(file, line, "expected a byte mask");
+            }
+        }
+        else if (kind != "skip")
+        {
+            throw_line(file, line, "unknown entry " + kind);
+        }
+
+        if (fields >> token)
+        {
+            throw_line(file, line, "unexpected " + token);
+        }
+
+        if (length > UINTMAX_MAX - offset)
+        {
+            throw_line(file, line, "range overflows");
+        }
+
+        if (length == 0 || bits == 0)
+        {
+            continue;
+        }
+
+        events.push_back({ .pos = offset, .bits = static_cast<unsigned char>(bits), .delta = 1 });
+        events.push_back({ .pos = offset + length, .bits = static_cast<unsigned char>(bits), .delta = -1 });
+    }
+
+    std::sort(events.begin(), events.end(), [](const event_s& x, const event_s& y) { return x.pos < y.pos; });
+
+    // Sweep the entry boundaries, tracking how many entries cover each bit.
+    int cover[8] = {};
+
+    for (std::size_t i = 0; i < events.size();)
+    {
+        const std::uintmax_t pos = events[i].pos;
+        for (; i < events.size() && events[i].pos == pos; ++i)
+        {
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                if ((events[i].bits >> bit) & 1)
+                {
+                    cover[bit] += events[i].delta;
+                }
+            }
+        }
+
+        unsigned char ignore = 0;
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            if (cover[bit] > 0)
+            {
+                ignore |= static_cast<unsigned char>(1U << bit);
+            }
+        }
+
+        if (ignore == 0 || i == events.size())
+        {
+            continue;
+        }
+
+        const std::uintmax_t end = events[i].pos;
+        if (!m_ranges.empty() && m_ranges.back().end == pos && m_ranges.back().ignore == ignore)
+        {
+            m_ranges.back().end = end;
+        }
+        else
+        {
+            m_ranges.push_back({ .begin = pos, .end = end, .ignore = ignore });
+        }
+    }
+}
+
+const unsigned char* bd::Mask::apply(
+    const std::uintmax_t base,
+    const unsigned char* a,
+    const unsigned char* b,
+    unsigned char* scratch,
+    const std::size_t len) const noexcept
+{
+    const std::uintmax_t limit = base + len;
+
+    auto it = std::upper_bound(m_ranges.begin(), m_ranges.end(), base, [](const std::uintmax_t pos, const range_s& r)
+    {
+        return pos < r.end;
+    });
+
+    // Most chunks are untouched; only copy the ones a range covers.
+    if (it == m_ranges.end() || it->begin >= limit)
+    {
+        return b;
+    }
+
+    std::memcpy(scratch, b, len);
+
+    for (; it != m_ranges.end() && it->begin < limit; ++it)
+    {
+        const auto lo = static_cast<std::size_t>(std::max(it->begin, base) - base);
+        const auto hi = static_cast<std::size_t>(std::min(it->end, limit) - base);
+
+        if (it->ignore == ALL_BITS)
+        {
+            std::memcpy(scratch + lo, a + lo, hi - lo);
+            continue;
+        }
+
+        // Bit select; vectorizes.
+        const unsigned char ignore = it->ignore;
+        for (std::size_t i = lo; i < hi; ++i)
+        {
+            scratch[i] = static_cast<unsigned char>((scratch[i] & ~ignore) | (a[i] & ignore));
+        }
+    }
+
+    return scratch;
+}
+
+std::size_t bd::Mask::getRangeCount() const noexcept
+{
+    return m_ranges.size();
+}
+
+std::uint64_t bd::mask_digest(const Mask* mask) noexcept
+{
+    Hash64 hash;
+    if (mask == nullptr)
+    {
+        return hash.digest();
+    }
+
+    for (const Mask::range_s& r : mask->m_ranges)
+    {
+        unsigned char entry[17];
+        store_le64(entry, static_cast<std::uint64_t>(r.begin));
+        store_le64(entry + 8, static_cast<std::uint64_t>(r.end));
+        entry[16] = r.ignore;
+
+        hash.update(entry, sizeof(entry));
+    }
+
+    return hash.digest();
+}
@@ -0,0 +1,244 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bitdiff/bitdiff.hpp"
+#include "bitdiff/compare.hpp"
+#include "bitdiff/endian.hpp"
+#include "bitdiff/hash.hpp"
+#include "bitdiff/kernel.hpp"
+#include "bitdiff/sink.hpp"
+#include "bitdiff/patch.hpp"
+
+namespace bd = isaki::bitdiff;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr std::string_view MAGIC = "BITPATCH";
+    constexpr std::uint32_t FORMAT_VERSION = 1;
+
+    constexpr std::size_t HEADER_LENGTH = 24;
+    constexpr std::size_t RECORD_HEADER_LENGTH = 12;
+    constexpr std::size_t TRAILER_LENGTH = RECORD_HEADER_LENGTH + 24;
+
+    // Equal bytes worth carrying to join two differences; anything shorter
+    // than a record header is a saving.
+    constexpr std::uintmax_t COALESCE_GAP = RECORD_HEADER_LENGTH;
+
+    // Bounds the memory held by one record, on both sides.
+    constexpr std::size_t MAX_RECORD_LENGTH = 64 * 1024;
+
+    void write_bytes(bd::Sink& output, const unsigned char* data, const std::size_t len)
+    {
+        output.write(reinterpret_cast<const char*>(data), len);
+    }
+
+    void read_exact(std::ifstream& in, unsigned char* data, const std::size_t len)
+    {
+        if (!in.read(reinterpret_cast<char*>(data), static_cast<std::streamsize>(len)))
+        {
+            throw std::runtime_error("Patch file is truncated");
+        }
+    }
+}
+
+//
+// WRITER
+//
+
+bd::PatchWriter::~PatchWriter() = default;
+
+bd::PatchWriter::PatchWriter(Sink& output, const std::uintmax_t size) :
+    m_output(output),
+    m_pendingStart(0),
+    m_records(0),
+    m_count{ .bytes = 0, .bits = 0 }
+{
+    m_pending.reserve(MAX_RECORD_LENGTH);
+
+    unsigned char header[HEADER_LENGTH];
+    std::memcpy(header, MAGIC.data(), MAGIC.size());
+    bd::store_le32(header + 8, FORMAT_VERSION);
+    bd::store_le32(header + 12, 0);
+    bd::store_le64(header + 16, size);
+
+    write_bytes(m_output, header, sizeof(header));
+}
+
+void bd::PatchWriter::update(const std::uintmax_t base, const unsigned char* a, const unsigned char* b, const std::size_t len)
+{
+    m_hash_a.update(a, len);
+    m_hash_b.update(b, len);
+
+    for_each_difference(a, b, len, [&](const std::size_t i)
+    {
+        const std::uintmax_t offset = base + i;
+
+        ++m_count.bytes;
+        m_count.bits += static_cast<std::uintmax_t>(count_bits(static_cast<unsigned char>(a[i] ^ b[i])));
+
+        if (!m_pending.empty())
+        {
+            // The gap must still be in this chunk to be copied from B.
+            const std::uintmax_t end = m_pendingStart + m_pending.size();
+            if (end >= base && offset - end <= COALESCE_GAP && m_pending.size() + (offset - end) < MAX_RECORD_LENGTH)
+            {
+                m_pending.insert(m_pending.end(), b + (end - base), b + i + 1);
+                return;
+            }
+
+            emit();
+        }
+
+        m_pendingStart = offset;
+        m_pending.push_back(b[i]);
+    });
+
+    // Only a record that reaches the end of the chunk can grow into the next.
+    if (!m_pending.empty() && m_pendingStart + m_pending.size() != base + len)
+    {
+        emit();
+    }
+}
+
+bd::diff_count bd::PatchWriter::finish()
+{
+    if (!m_pending.empty())
+    {
+        emit();
+    }
+
+    unsigned char trailer[TRAILER_LENGTH];
+    bd::store_le64(trailer, PATCH_END);
+    bd::store_le32(trailer + 8, 0);
+    bd::store_le64(trailer + 12, m_records);
+    bd::store_le64(trailer + 20, m_hash_a.digest());
+    bd::store_le64(trailer + 28, m_hash_b.digest());
+
+    write_bytes(m_output, trailer, sizeof(trailer));
+    m_output.flush();
+
+    return m_count;
+}
+
+void bd::PatchWriter::emit()
+{
+    unsigned char header[RECORD_HEADER_LENGTH];
+    bd::store_le64(header, m_pendingStart);
+    bd::store_le32(header + 8, static_cast<std::uint32_t>(m_pending.size()));
+
+    write_bytes(m_output, header, sizeof(header));
+    write_bytes(m_output, m_pending.data(), m_pending.size());
+
+    m_pending.clear();
+    ++m_records;
+}
+
+//
+// READER
+//
+
+bd::PatchReader::~PatchReader() = default;
+
+bd::PatchReader::PatchReader(const fs::path& file) :
+    m_in(file, std::ios::in | std::ios::binary),
+    m_size(0),
+    m_seen(0),
+    m_trailer{}
+{
+    if (!m_in)
+    {
+        std::string err;
+        err.append("Unable to open ");
+        err.append(file.string());
+        throw std::runtime_error(err);
+    }
+
+    const std::uintmax_t length = fs::file_size(file);
+    if (length < HEADER_LENGTH + TRAILER_LENGTH)
+    {
+        throw std::runtime_error("Patch file is truncated");
+    }
+
+    unsigned char trailer[TRAILER_LENGTH];
+    m_in.seekg(static_cast<std::streamoff>(length - TRAILER_LENGTH));
+    read_exact(m_in, trailer, sizeof(trailer));
+
+    if (bd::load_le64(trailer) != PATCH_END || bd::load_le32(trailer + 8) != 0)
+    {
+        throw std::runtime_error("Patch file has no trailer");
+    }
+
+    m_trailer = {
+        .records = bd::load_le64(trailer + 12),
+        .hashA = bd::load_le64(trailer + 20),
+        .hashB = bd::load_le64(trailer + 28)
+    };
+
+    unsigned char header[HEADER_LENGTH];
+    m_in.seekg(0);
+    read_exact(m_in, header, sizeof(header));
+
+    if (std::memcmp(header, MAGIC.data(), MAGIC.size()) != 0)
+    {
+        throw std::runtime_error("Not a bitdiff patch");
+    }
+
+    if (bd::load_le32(header + 8) != FORMAT_VERSION)
+    {
+        throw std::runtime_error("Unsupported patch version");
+    }
+
+    m_size = bd::load_le64(header + 16);
+}
+
+std::uintmax_t bd::PatchReader::getSize() const noexcept
+{
+    return m_size;
+}
+
+const bd::patch_trailer_s& bd::PatchReader::getTrailer() const noexcept
+{
+    return m_trailer;
+}
+
+bool bd::PatchReader::next(std::uint64_t& offset, std::vector<unsigned char>& data)
+{
+    unsigned char header[RECORD_HEADER_LENGTH];
+    read_exact(m_in, header, sizeof(header));
+
+    offset = bd::load_le64(header);
+    const std::uint32_t len = bd::load_le32(header + 8);
+
+    if (offset == PATCH_END)
+    {
+        if (m_seen != m_trailer.records)
+        {
+            throw std::runtime_error("Patch record count does not match its trailer");
+        }
+
+        return false;
+    }
+
+    if (len == 0 || len > MAX_RECORD_LENGTH || offset > m_size || len > m_size - offset)
+    {
+        throw std::runtime_error("Patch record is out of range");
+    }
+
+    data.resize(len);
+    read_exact(m_in, data.data(), len);
+
+    ++m_seen;
+    return true;
+}
@@ -0,0 +1,339 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <linux/mempolicy.h>
+
+#include "bitdiff/placement.hpp"
+
+namespace bd = isaki::bitdiff;
+
+namespace
+{
+    constexpr std::string_view NODE_ROOT = "/sys/devices/system/node/node";
+
+    // Node masks passed to mbind(2); nodes beyond this are refused.
+    constexpr int MAX_NODES = 64;
+
+    bd::Placement* g_placement = nullptr;
+
+    // Records are per placement, and there is only ever one.
+    thread_local void* t_thread = nullptr;
+
+    // Parses a kernel style CPU list ("0-3,8"). Returns false on a syntax
+    // error.
+    bool parse_cpu_list(std::string_view text, std::vector<int>& out)
+    {
+        while (!text.empty() && (text.back() == '\n' || text.back() == ' '))
+        {
+            text.remove_suffix(1);
+        }
+
+        if (text.empty())
+        {
+            return true;
+        }
+
+        const auto number = [](std::string_view s, int& value)
+        {
+            if (s.empty() || s.size() > 6 || !std::all_of(s.begin(), s.end(), [](const char c) { return c >= '0' && c <= '9'; }))
+            {
+                return false;
+            }
+
+            value = std::stoi(std::string(s));
+            return true;
+        };
+
+        while (true)
+        {
+            const std::size_t comma = text.find(',');
+            const std::string_view item = text.substr(0, comma);
+
+            int first = 0;
+            int last = 0;
+            if (const std::size_t dash = item.find('-'); dash != std::string_view::npos)
+            {
+                if (!number(item.substr(0, dash), first) || !number(item.substr(dash + 1), last) || last < first)
+                {
+                    return false;
+                }
+            }
+            else if (!number(item, first))
+            {
+                return false;
+            }
+            else
+            {
+                last = first;
+            }
+
+            for (int cpu = first; cpu <= last; ++cpu)
+            {
+                out.push_back(cpu);
+            }
+
+            if (comma == std::string_view::npos)
+            {
+                return true;
+            }
+
+            text.remove_prefix(comma + 1);
+        }
+    }
+
+    // CPUs of node, or false if the node does not exist.
+    bool node_cpus(const int node, std::vector<int>& out)
+    {
+        std::ifstream in(std::string(NODE_ROOT) + std::to_string(node) + "/cpulist");
+        if (!in)
+        {
+            return false;
+        }
+
+        std::string line;
+        std::getline(in, line);
+        return parse_cpu_list(line, out);
+    }
+}
+
+bd::Placement::~Placement()
+{
+    if (g_placement == this)
+    {
+        g_placement = nullptr;
+    }
+}
+
+bd::Placement::Placement(const std::string_view cpus, const int node) :
+    m_node(node),
+    m_next(0),
+    m_memoryWarned(false)
+{
+    if (g_placement != nullptr)
+    {
+        throw std::runtime_error("A placement is already installed");
+    }
+
+    if (!parse_cpu_list(cpus, m_cpus))
+    {
+        std::string err;
+        err.append("Invalid CPU list: ");
+        err.append(cpus);
+        throw std::runtime_error(err);
+    }
+
+    // Map every CPU to its node for the report.
+    for (int n = 0; n < MAX_NODES; ++n)
+    {
+        std::vector<int> list;
+        if (!node_cpus(n, list))
+        {
+            continue;
+        }
+
+        for (const int cpu : list)
+        {
+            if (static_cast<std::size_t>(cpu) >= m_cpuNode.size())
+            {
+                m_cpuNode.resize(static_cast<std::size_t>(cpu) + 1, -1);
+            }
+
+            m_cpuNode[static_cast<std::size_t>(cpu)] = n;
+        }
+    }
+
+    if (m_node >= 0)
+    {
+        std::vector<int> list;
+        if (m_node >= MAX_NODES || !node_cpus(m_node, list))
+        {
+            throw std::runtime_error("No such NUMA node: " + std::to_string(m_node));
+        }
+
+        // Without a CPU list, threads float over the node's CPUs.
+        if (m_cpus.empty() && list.empty())
+        {
+            throw std::runtime_error("NUMA node " + std::to_string(m_node) + " has no CPUs");
+        }
+    }
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        throw std::runtime_error("Unable to read the CPU affinity");
+    }
+
+    for (const int cpu : m_cpus)
+    {
+        if (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed))
+        {
+            throw std::runtime_error("CPU " + std::to_string(cpu) + " is not available to this process");
+        }
+    }
+
+    g_placement = this;
+}
+
+bd::Placement* bd::Placement::getActive() noexcept
+{
+    return g_placement;
+}
+
+int bd::Placement::getNode(const int cpu) const noexcept
+{
+    return (cpu >= 0 && static_cast<std::size_t>(cpu) < m_cpuNode.size()) ? m_cpuNode[static_cast<std::size_t>(cpu)] : -1;
+}
+
+bd::Placement::thread_s* bd::Placement::add(const std::string_view name) noexcept
+{
+    try
+    {
+        auto t = std::make_unique<thread_s>();
+        t->name.assign(name);
+        t->pinned = -1;
+        for (std::atomic<std::uint64_t>& w : t->seen)
+        {
+            w.store(0, std::memory_order_relaxed);
+        }
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+
+        std::scoped_lock<std::mutex> lock(m_mtx);
+
+        if (!m_cpus.empty())
+        {
+            t->pinned = m_cpus[m_next++ % m_cpus.size()];
+            CPU_SET(t->pinned, &set);
+        }
+        else if (m_node >= 0)
+        {
+            std::vector<int> list;
+            node_cpus(m_node, list);
+            for (const int cpu : list)
+            {
+                CPU_SET(cpu, &set);
+            }
+        }
+
+        // Checked against the allowed set up front, so this only fails if
+        // the affinity was changed from outside meanwhile.
+        if (CPU_COUNT(&set) > 0 && ::sched_setaffinity(0, sizeof(set), &set) != 0)
+        {
+            t->pinned = -1;
+        }
+
+        m_threads.push_back(std::move(t));
+        return m_threads.back().get();
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void bd::Placement::report(std::ostream& os) const
+{
+    os << "Thread placement:" << std::endl;
+
+    for (const std::unique_ptr<thread_s>& t : m_threads)
+    {
+        os << "  " << t->name << ": ";
+        if (t->pinned >= 0)
+        {
+            os << "pinned to CPU " << t->pinned;
+        }
+        else if (m_node >= 0)
+        {
+            os << "bound to node " << m_node;
+        }
+        else
+        {
+            os << "not pinned";
+        }
+
+        os << "; ran on";
+
+        bool any = false;
+        for (std::size_t w = 0; w < CPU_WORDS; ++w)
+        {
+            for (std::uint64_t bits = t->seen[w].load(std::memory_order_relaxed); bits != 0; bits &= bits - 1)
+            {
+                const int cpu = static_cast<int>((w * 64) + static_cast<std::size_t>(std::countr_zero(bits)));
+                os << (any ? ", " : " ") << "CPU " << cpu;
+                if (const int n = getNode(cpu); n >= 0)
+                {
+                    os << " (node " << n << ")";
+                }
+
+                any = true;
+            }
+        }
+
+        if (!any)
+        {
+            os << " nothing recorded";
+        }
+
+        os << std::endl;
+    }
+}
+
+void bd::place_thread(const std::string_view name) noexcept
+{
+    Placement* p = Placement::getActive();
+    if (p == nullptr)
+    {
+        return;
+    }
+
+    t_thread = p->add(name);
+    place_sample();
+}
+
+void bd::place_sample() noexcept
+{
+    if (t_thread == nullptr || Placement::getActive() == nullptr)
+    {
+        return;
+    }
+
+    if (const int cpu = ::sched_getcpu(); cpu >= 0 && static_cast<std::size_t>(cpu) < Placement::CPU_WORDS * 64)
+    {
+        auto* t = static_cast<Placement::thread_s*>(t_thread);
+        t->seen[static_cast<std::size_t>(cpu) / 64].fetch_or(std::uint64_t{ 1 } << (cpu % 64), std::memory_order_relaxed);
+    }
+}
+
+void bd::place_memory(void* ptr, const std::size_t len) noexcept
+{
+    Placement* p = Placement::getActive();
+    if (p == nullptr || p->m_node < 0)
+    {
+        return;
+    }
+
+    const unsigned long mask = 1UL << p->m_node;
+
+    // Called directly; libnuma is not needed for one system call.
+    if (::syscall(SYS_mbind, ptr, len, MPOL_BIND, &mask, MAX_NODES + 1, 0) != 0 && !p->m_memoryWarned.exchange(true))
+    {
+        std::cerr << "Unable to bind memory to NUMA node " << p->m_node << "; continuing without" << std::endl;
+    }
+}
@@ -0,0 +1,139 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "bitdiff/placement.hpp"
+#include "bitdiff/trace.hpp"
+#include "bitdiff/pool.hpp"
+
+namespace bd = isaki::bitdiff;
+
+bd::WorkPool::~WorkPool()
+{
+    for (std::jthread& t : m_threads)
+    {
+        t.request_stop();
+    }
+
+    // jthread joins on destruction; clear before the queues go away.
+    m_threads.clear();
+}
+
+bd::WorkPool::WorkPool(std::size_t threads, const TaskOrder order) :
+    m_order(order),
+    m_pending(0),
+    m_next(0)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    m_queues.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+        m_queues.push_back(std::make_unique<queue_s>());
+    }
+
+    // Queues must be complete before any worker can steal from them.
+    m_threads.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+        m_threads.emplace_back([this, i](std::stop_token stop) { this->run(stop, i); });
+    }
+}
+
+void bd::WorkPool::submit(Task task)
+{
+    // Spread submissions; stealing evens out whatever imbalance remains.
+    const std::size_t index = m_next.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+
+    {
+        std::scoped_lock<std::mutex> lock(m_queues[index]->mtx);
+        m_queues[index]->tasks.push_back(std::move(task));
+    }
+
+    {
+        std::scoped_lock<std::mutex> lock(m_mtx);
+        m_pending.fetch_add(1, std::memory_order_release);
+    }
+
+    m_wake.notify_one();
+}
+
+std::size_t bd::WorkPool::getThreadCount() const noexcept
+{
+    return m_queues.size();
+}
+
+bool bd::WorkPool::tryTake(const std::size_t index, Task& task)
+{
+    const std::size_t count = m_queues.size();
+
+    for (std::size_t n = 0; n < count; ++n)
+    {
+        queue_s& q = *m_queues[(index + n) % count];
+        std::scoped_lock<std::mutex> lock(q.mtx);
+
+        if (q.tasks.empty())
+        {
+            continue;
+        }
+
+        // Stolen work is always FIFO.
+        if (n == 0 && m_order == TaskOrder::NewestFirst)
+        {
+            task = std::move(q.tasks.back());
+            q.tasks.pop_back();
+        }
+        else
+        {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+
+        m_pending.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+
+    return false;
+}
+
+void bd::WorkPool::run(std::stop_token stop, const std::size_t index)
+{
+    Task task;
+
+    trace_thread_name("worker " + std::to_string(index));
+    place_thread("worker " + std::to_string(index));
+
+    while (!stop.stop_requested())
+    {
+        if (tryTake(index, task))
+        {
+            try
+            {
+                const TraceSpan span("task");
+                place_sample();
+                task(index);
+            }
+            catch (...)
+            {
+                // Contract violation; keep the worker alive.
+            }
+
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mtx);
+        m_wake.wait(lock, stop, [this] { return m_pending.load(std::memory_order_acquire) > 0; });
+    }
+}
@@ -4,19 +4,31 @@
 #include <mutex>
 #include <thread>
 #include <stop_token>
+#include <chrono>
+#include <algorithm>
 
 #include <condition_variable>
 
+#include <cerrno>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 
 #include <filesystem>
-#include <fstream>
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
 
 #include <exception>
 #include <stdexcept>
+#include <system_error>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bitdiff/placement.hpp"
+#include "bitdiff/trace.hpp"
 #include "bitdiff/reader.hpp"
 
 namespace bd = isaki::bitdiff;
@@ -24,21 +36,66 @@ namespace fs = std::filesystem;
 
 namespace
 {
-    std::streamsize fillBuffer(std::ifstream * in, unsigned char* buffer, const std::streamsize len)
+    // Don't issue a DONTNEED for every small fill.
+    constexpr std::uintmax_t DROP_GRANULARITY = 8 * 1024 * 1024;
+}
+
+std::size_t bd::read_fully(const int fd, unsigned char* buffer, const std::size_t len)
+{
+    std::size_t read = 0;
+    while (read < len)
+    {
+        const ssize_t got = ::read(fd, buffer + read, len - read);
+        if (got < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            throw std::system_error(errno, std::generic_category(), "Read failure");
+        }
+
+        if (got == 0)
+        {
+            break;
+        }
+
+        read += static_cast<std::size_t>(got);
+    }
+
+    return read;
+}
+
+std::size_t bd::pread_fully(const int fd, unsigned char* buffer, const std::size_t len, const std::uintmax_t offset)
+{
+    std::size_t read = 0;
+    while (read < len)
     {
-        char* sbuff = reinterpret_cast<char*>(buffer);
+        const ssize_t got = ::pread(fd, buffer + read, len - read, static_cast<off_t>(offset + read));
+        if (got < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            throw std::system_error(errno, std::generic_category(), "Read failure");
+        }
 
-        std::streamsize read = 0;
-        while (read < len && !in->eof())
+        if (got == 0)
         {
-            in->read(sbuff + read, len - read);
-            read += in->gcount();
+            break;
         }
 
-        return read;
+        read += static_cast<std::size_t>(got);
     }
+
+    return read;
 }
 
+bd::ChunkSource::~ChunkSource() = default;
+
 bd::Reader::~Reader()
 {
     // Create the lock, but unlocked
@@ -57,44 +114,89 @@ bd::Reader::~Reader()
     cleanup();
 }
 
-bd::Reader::Reader(const fs::path& file, const std::size_t bufferSize) :
+bd::Reader::Reader(
+    const fs::path& file,
+    unsigned char* buffer,
+    const std::size_t bufferSize,
+    const std::size_t fillSize,
+    const bool keepCache,
+    const std::uintmax_t startOffset) :
+    Reader("read " + file.filename().string(), buffer, bufferSize, fillSize, keepCache)
+{
+    try
+    {
+        open(file, startOffset);
+    }
+    catch (const std::exception& e)
+    {
+        // The thread is stopped by the destructor.
+        std::cerr << "Reader initialization failure: " << e.what() << std::endl;
+        throw;
+    }
+}
+
+bd::Reader::Reader(
+    const std::string_view name,
+    unsigned char* buffer,
+    const std::size_t bufferSize,
+    const std::size_t fillSize,
+    const bool keepCache) :
     m_bsize(bufferSize),
+    m_fsize(std::min(fillSize, bufferSize)),
+    m_nextFsize(m_fsize),
+    m_offset(0),
+    m_dropped(0),
+    m_keepCache(keepCache),
+    m_fillBytes(0),
+    m_fillTime(0),
     m_error(nullptr),
     m_read(0),
-    m_eos(false),
-    m_is(nullptr),
-    m_buffer(nullptr)
+    m_eos(true),
+    m_buffer(buffer)
 {
-    try
+    // This must be the last statement of the constructor.
+    m_thread = std::jthread([this, name = std::string(name)](std::stop_token stop)
     {
-        // First can we even create the stream?
-        m_is = new std::ifstream();
-        m_is->open(file, std::ios_base::binary | std::ios_base::in);
-        if (!m_is->is_open())
-        {
-            std::string err;
-            err.append("Unable to open ");
-            err.append(file.string());
-            throw std::runtime_error(err);
-        }
-
-        m_is->exceptions(std::ifstream::badbit);
+        trace_thread_name(name);
+        place_thread(name);
+        this->run(stop);
+    });
+}
 
-        // We don't need to zero memory here.
-        m_buffer = new unsigned char[bufferSize];
+void bd::Reader::open(const fs::path& file, const std::uintmax_t startOffset)
+{
+    // First can we even open the file?
+    FileDescriptor fd = open_read(file);
 
-        // This must be the last call before the end of the try block.
-        m_thread = std::jthread([this](std::stop_token stop) { this->run(stop); });
-    }
-    catch (const std::exception& e)
+    if (startOffset > 0 && ::lseek(fd.get(), static_cast<off_t>(startOffset), SEEK_SET) < 0)
     {
-        std::cerr << "Reader initialization failure: " << e.what() << std::endl;
+        throw std::system_error(errno, std::generic_category(), "Unable to seek");
+    }
 
-        // Cleanup will clear valid flag. We don't need lock. If thread threw,
-        // we have no thread anyway.
-        cleanup();
-        throw;
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (!m_keepCache)
+    {
+        // Advisory only; failure is harmless.
+        ::posix_fadvise(fd.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
     }
+#endif
+
+    // The producer holds the lock for a whole fill, so it is between fills
+    // here and picks up the new file on its next one.
+    std::scoped_lock<std::mutex> lock(m_mtx);
+
+    dropCache(m_offset, true);
+    closeFile();
+
+    m_fd = std::move(fd);
+    m_offset = startOffset;
+    m_dropped = startOffset;
+    m_fsize = m_nextFsize;
+    m_error = nullptr;
+    m_read = 0;
+    m_eos = false;
+
+    m_bufferFree.notify_one();
 }
 
 std::size_t bd::Reader::read(unsigned char* buffer)
@@ -102,95 +204,140 @@ std::size_t bd::Reader::read(unsigned char* buffer)
     // This is effectively a consumer.
     std::unique_lock<std::mutex> lock(m_mtx);
 
-    m_bufferFull.wait(lock, [this]
     {
-        return this->m_read > 0 || this->m_eos;
-    });
+        const TraceSpan span("wait");
+        m_bufferFull.wait(lock, [this]
+        {
+            return this->m_read > 0 || this->m_eos;
+        });
+    }
 
     if (m_error) [[unlikely]]
     {
         std::rethrow_exception(m_error);
     }
 
-    std::streamsize ret = 0;
+    std::size_t ret = 0;
     if (m_read > 0)
     {
-        std::memcpy(buffer, m_buffer, static_cast<std::size_t>(m_read));
+        std::memcpy(buffer, m_buffer, m_read);
         ret = m_read;
         m_read = 0;
     }
 
+    // Set before the producer can start the next fill, so readers resized
+    // together change size on the same chunk.
+    m_fsize = m_nextFsize;
+
     m_bufferFree.notify_one();
 
-    return static_cast<std::size_t>(ret);
+    return ret;
+}
+
+void bd::Reader::setFillSize(const std::size_t fillSize)
+{
+    std::scoped_lock<std::mutex> lock(m_mtx);
+    m_nextFsize = std::clamp<std::size_t>(fillSize, 1, m_bsize);
+}
+
+double bd::Reader::getFillRate()
+{
+    std::scoped_lock<std::mutex> lock(m_mtx);
+
+    const double seconds = std::chrono::duration<double>(m_fillTime).count();
+    if (seconds <= 0.0)
+    {
+        return 0.0;
+    }
+
+    return static_cast<double>(m_fillBytes) / seconds;
 }
 
 void bd::Reader::run(std::stop_token stop)
 {
-    try
+    for (;;)
     {
-        for (;;)
+        // This is the producer and the thread.
+        std::unique_lock<std::mutex> lock(m_mtx);
         {
-            // This is the producer and the thread.
-            std::unique_lock<std::mutex> lock(m_mtx);
-            m_bufferFree.wait(lock, stop, [this] { return this->m_read == 0; });
+            const TraceSpan span("wait");
+            m_bufferFree.wait(lock, stop, [this] { return this->m_read == 0 && !this->m_eos; });
+        }
 
-            if (stop.stop_requested())
-            {
-                m_eos = true;
-                m_bufferFull.notify_all();
-                break;
-            }
+        if (stop.stop_requested())
+        {
+            m_eos = true;
+            m_bufferFull.notify_all();
+            break;
+        }
+
+        try
+        {
+            // Everything before m_offset has been copied out by the consumer.
+            dropCache(m_offset, false);
 
-            m_read = fillBuffer(m_is, m_buffer, static_cast<std::streamsize>(m_bsize));
+            place_sample();
 
-            if (m_read == 0)
+            const auto start = std::chrono::steady_clock::now();
             {
-                m_eos = true;
-                m_bufferFull.notify_all();
-                break;
+                const TraceSpan span("fill");
+                m_read = read_fully(m_fd.get(), m_buffer, m_fsize);
             }
+            m_fillTime += std::chrono::steady_clock::now() - start;
+            m_fillBytes += m_read;
+            m_offset += m_read;
+        }
+        catch (...)
+        {
+            // Ends this file only; the thread waits for the next open().
+            m_error = std::current_exception();
+            m_read = 0;
+            m_eos = true;
+            m_bufferFull.notify_all();
+            continue;
+        }
 
-            // else
-            m_bufferFull.notify_one();
+        if (m_read == 0)
+        {
+            dropCache(m_offset, true);
+            m_eos = true;
+            m_bufferFull.notify_all();
+            continue;
         }
-    }
-    catch (...)
-    {
-        std::scoped_lock<std::mutex> lock(m_mtx);
-        m_error = std::current_exception();
-        m_eos = true;
-        m_bufferFull.notify_all();
+
+        // else
+        m_bufferFull.notify_one();
     }
 
     // End of thread reached.
 }
 
-// This is NOT thread safe.
-void bd::Reader::cleanup() noexcept
+void bd::Reader::dropCache(const std::uintmax_t end, const bool force) noexcept
 {
-    // This may not throw exceptions.
-    if (m_buffer != nullptr)
+#ifdef POSIX_FADV_DONTNEED
+    if (m_keepCache || end == m_dropped || (!force && end - m_dropped < DROP_GRANULARITY))
     {
-        delete[] m_buffer;
-        m_buffer = nullptr;
+        return;
     }
 
-    if (m_is != nullptr)
-    {
-        try
-        {
-            if (m_is->is_open())
-            {
-                m_is->close();
-            }
-        }
-        catch (const std::exception& e)
-        {
-            std::cerr << "Failed to close stream: " << e.what() << std::endl;
-        }
+    ::posix_fadvise(m_fd.get(), static_cast<off_t>(m_dropped), static_cast<off_t>(end - m_dropped), POSIX_FADV_DONTNEED);
+    m_dropped = end;
+#else
+    static_cast<void>(end);
+    static_cast<void>(force);
+#endif
+}
 
-        delete m_is;
-        m_is = nullptr;
-    }
+void bd::Reader::closeFile() noexcept
+{
+    m_fd.close();
+}
+
+// This is NOT thread safe.
+void bd::Reader::cleanup() noexcept
+{
+    // This may not throw exceptions. The buffer belongs to the caller.
+    m_buffer = nullptr;
+
+    closeFile();
 }
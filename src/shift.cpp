@@ -0,0 +1,636 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <filesystem>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bitdiff/arena.hpp"
+#include "bitdiff/compare.hpp"
+#include "bitdiff/dataout.hpp"
+#include "bitdiff/fd.hpp"
+#include "bitdiff/hash.hpp"
+#include "bitdiff/kernel.hpp"
+#include "bitdiff/reader.hpp"
+#include "bitdiff/sink.hpp"
+#include "bitdiff/trace.hpp"
+#include "bitdiff/shift.hpp"
+
+namespace bd = isaki::bitdiff;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr char OUT_DELIM = '\t';
+
+    constexpr std::size_t SCRATCH_LENGTH = 4096;
+
+    // Sequential read size while chunking.
+    constexpr std::size_t READ_LENGTH = 4 * 1024 * 1024;
+
+    // Pread size while comparing changed regions.
+    constexpr std::size_t PIECE_LENGTH = 1024 * 1024;
+
+    // FastCDC sizes. Cuts are never made in the first MIN_CHUNK bytes of a
+    // chunk, are made at MAX_CHUNK regardless, and land around AVG_CHUNK.
+    constexpr std::size_t MIN_CHUNK = 2 * 1024;
+    constexpr std::size_t AVG_CHUNK = 8 * 1024;
+    constexpr std::size_t MAX_CHUNK = 64 * 1024;
+
+    // Normalized chunking: two bits harder than the average before it, two
+    // bits easier after, which narrows the spread of chunk sizes. Bit k of
+    // the gear hash depends on the last k + 1 bytes, so the masks take the
+    // high bits to see a window of about 50 bytes.
+    constexpr std::uint64_t MASK_S = ~std::uint64_t(0) << (64 - 15);
+    constexpr std::uint64_t MASK_L = ~std::uint64_t(0) << (64 - 11);
+
+    constexpr std::uintmax_t NO_OFFSET = std::numeric_limits<std::uintmax_t>::max();
+    constexpr std::size_t NO_MATCH = std::numeric_limits<std::size_t>::max();
+
+    constexpr std::size_t HEX_DIGITS = 16;
+
+    // Fixed, so chunk boundaries are the same from run to run.
+    consteval std::array<std::uint64_t, 256> make_gear() noexcept
+    {
+        std::array<std::uint64_t, 256> ret{};
+
+        // splitmix64
+        std::uint64_t x = 0x6269746469666621;
+        for (std::uint64_t& g : ret)
+        {
+            x += 0x9E3779B97F4A7C15;
+
+            std::uint64_t z = x;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+            g = z ^ (z >> 31);
+        }
+
+        return ret;
+    }
+
+    constexpr std::array<std::uint64_t, 256> GEAR = make_gear();
+
+    struct chunk_s
+    {
+        std::uintmax_t offset;
+        std::uint64_t hash;
+        std::uint32_t length;
+    };
+
+    struct range_s
+    {
+        std::uintmax_t offset;
+        std::uintmax_t length;
+    };
+
+    // Position within the chunk being cut; carried across reads.
+    struct cut_state_s
+    {
+        std::size_t len;
+        std::uint64_t fp;
+        bool cut;
+    };
+
+    // Consumes up to n bytes of the current chunk. Sets state.cut when the
+    // chunk ends with the last byte consumed.
+    std::size_t scan(const unsigned char* p, const std::size_t n, cut_state_s& state) noexcept
+    {
+        const std::size_t base = state.len;
+        std::uint64_t fp = state.fp;
+
+        // No cut may land here, so these bytes are not hashed at all.
+        std::size_t i = (base < MIN_CHUNK) ? std::min(n, MIN_CHUNK - base) : 0;
+        bool cut = false;
+
+        std::size_t end = (base + i < AVG_CHUNK) ? std::min(n, AVG_CHUNK - base) : i;
+        for (; i < end; ++i)
+        {
+            fp = (fp << 1) + GEAR[p[i]];
+            if ((fp & MASK_S) == 0)
+            {
+                cut = true;
+                ++i;
+                break;
+            }
+        }
+
+        if (!cut)
+        {
+            end = std::min(n, MAX_CHUNK - base);
+            for (; i < end; ++i)
+            {
+                fp = (fp << 1) + GEAR[p[i]];
+                if ((fp & MASK_L) == 0)
+                {
+                    cut = true;
+                    ++i;
+                    break;
+                }
+            }
+
+            cut = cut || (base + i == MAX_CHUNK);
+        }
+
+        state.len = cut ? 0 : base + i;
+        state.fp = cut ? 0 : fp;
+        state.cut = cut;
+
+        return i;
+    }
+
+    std::vector<chunk_s> chunk_file(const fs::path& file, const bool keepCache)
+    {
+        bd::Arena arena(2 * READ_LENGTH);
+        unsigned char* readerBuffer = arena.allocate<unsigned char>(READ_LENGTH, bd::IO_ALIGNMENT);
+        unsigned char* buffer = arena.allocate<unsigned char>(READ_LENGTH, bd::IO_ALIGNMENT);
+
+        bd::Reader reader(file, readerBuffer, READ_LENGTH, READ_LENGTH, keepCache, 0);
+
+        std::vector<chunk_s> ret;
+        ret.reserve(static_cast<std::size_t>(fs::file_size(file) / AVG_CHUNK) + 1);
+
+        cut_state_s state{ .len = 0, .fp = 0, .cut = false };
+        std::optional<bd::Hash64> hash;
+        hash.emplace();
+
+        std::uintmax_t offset = 0;
+        std::size_t pending = 0;
+
+        for (std::size_t got = reader.read(buffer); got > 0; got = reader.read(buffer))
+        {
+            const bd::TraceSpan span("chunk");
+
+            for (std::size_t i = 0; i < got;)
+            {
+                const std::size_t used = scan(buffer + i, got - i, state);
+                hash->update(buffer + i, used);
+                i += used;
+                pending += used;
+
+                if (state.cut)
+                {
+                    ret.push_back({ .offset = offset, .hash = hash->digest(), .length = static_cast<std::uint32_t>(pending) });
+                    offset += pending;
+                    pending = 0;
+                    hash.emplace();
+                }
+            }
+        }
+
+        if (pending > 0)
+        {
+            ret.push_back({ .offset = offset, .hash = hash->digest(), .length = static_cast<std::uint32_t>(pending) });
+        }
+
+        return ret;
+    }
+
+    // For each chunk of b, the index of a chunk of a with the same content,
+    // or NO_MATCH. The chunk following the previous match is tried first, so
+    // repeated content (zero runs) keeps its position instead of collapsing
+    // onto the first copy.
+    std::vector<std::size_t> match_chunks(const std::vector<chunk_s>& a, const std::vector<chunk_s>& b)
+    {
+        std::unordered_map<std::uint64_t, std::size_t> index;
+        index.reserve(a.size());
+        for (std::size_t j = 0; j < a.size(); ++j)
+        {
+            index.try_emplace(a[j].hash, j);
+        }
+
+        const auto same = [](const chunk_s& x, const chunk_s& y) noexcept
+        {
+            return x.hash == y.hash && x.length == y.length;
+        };
+
+        std::vector<std::size_t> ret(b.size(), NO_MATCH);
+        std::size_t expect = 0;
+
+        for (std::size_t k = 0; k < b.size(); ++k)
+        {
+            if (expect < a.size() && same(a[expect], b[k]))
+            {
+                ret[k] = expect;
+            }
+            else if (const auto it = index.find(b[k].hash); it != index.end() && same(a[it->second], b[k]))
+            {
+                ret[k] = it->second;
+            }
+
+            // A miss most likely replaced the expected chunk.
+            expect = (ret[k] == NO_MATCH) ? expect + 1 : ret[k] + 1;
+        }
+
+        return ret;
+    }
+
+    // Bytes covered by chunks [first, last); empty ranges sit at the end of
+    // the previous chunk.
+    range_s span_of(const std::vector<chunk_s>& chunks, const std::size_t first, const std::size_t last) noexcept
+    {
+        if (first >= last)
+        {
+            return { .offset = NO_OFFSET, .length = 0 };
+        }
+
+        const chunk_s& end = chunks[last - 1];
+        return { .offset = chunks[first].offset, .length = end.offset + end.length - chunks[first].offset };
+    }
+
+    // Writes region and byte records, and keeps the counts.
+    struct emitter_s
+    {
+        bd::Sink& output;
+        const bool fast;
+
+        const bd::FileDescriptor inA;
+        const bd::FileDescriptor inB;
+
+        bd::Arena arena;
+        unsigned char* bufferA;
+        unsigned char* bufferB;
+        std::unique_ptr<bd::DataOut> out;
+
+        bd::shift_count count;
+
+        emitter_s(bd::Sink& os, const bool fastMode, const fs::path& a, const fs::path& b, const bd::DataOutType type) :
+            output(os),
+            fast(fastMode),
+            inA(bd::open_read(a)),
+            inB(bd::open_read(b)),
+            arena((2 * PIECE_LENGTH) + SCRATCH_LENGTH),
+            bufferA(arena.allocate<unsigned char>(PIECE_LENGTH, bd::IO_ALIGNMENT)),
+            bufferB(arena.allocate<unsigned char>(PIECE_LENGTH, bd::IO_ALIGNMENT)),
+            out(bd::make_data_out(type, OUT_DELIM, 1, arena)),
+            count{ .moved = 0, .inserted = 0, .deleted = 0, .changed = { .bytes = 0, .bits = 0 } } {}
+
+        void newline()
+        {
+            output.write("\n", 1);
+
+            if (!fast)
+            {
+                output.flush();
+            }
+        }
+
+        void region(const std::string_view kind, const std::uintmax_t offA, const std::uintmax_t offB, const std::uintmax_t len)
+        {
+            // Offsets match the 0x-prefixed, zero padded DataOut addresses.
+            char line[64];
+            char* pos = std::copy(kind.begin(), kind.end(), line);
+
+            for (const std::uintmax_t off : { offA, offB })
+            {
+                *pos++ = OUT_DELIM;
+                if (off == NO_OFFSET)
+                {
+                    *pos++ = '-';
+                    continue;
+                }
+
+                *pos++ = '0';
+                *pos++ = 'x';
+                std::fill_n(pos, HEX_DIGITS, '0');
+
+                char digits[HEX_DIGITS];
+                const auto res = std::to_chars(digits, digits + HEX_DIGITS, off, 16);
+                const auto n = static_cast<std::size_t>(res.ptr - digits);
+                pos = std::copy(digits, res.ptr, pos + HEX_DIGITS - n);
+            }
+
+            *pos++ = OUT_DELIM;
+            pos = std::to_chars(pos, line + sizeof(line), len).ptr;
+
+            output.write(line, static_cast<std::size_t>(pos - line));
+            newline();
+        }
+
+        void inserted(const std::uintmax_t offB, const std::uintmax_t len)
+        {
+            region("insert", NO_OFFSET, offB, len);
+            count.inserted += len;
+        }
+
+        void deleted(const std::uintmax_t offA, const std::uintmax_t len)
+        {
+            region("delete", offA, NO_OFFSET, len);
+            count.deleted += len;
+        }
+
+        void moved(const std::uintmax_t offA, const std::uintmax_t offB, const std::uintmax_t len)
+        {
+            region("move", offA, offB, len);
+            count.moved += len;
+        }
+
+        // In order, only displaced by the edits before it; not counted.
+        void shifted(const std::uintmax_t offA, const std::uintmax_t offB, const std::uintmax_t len)
+        {
+            region("shift", offA, offB, len);
+        }
+
+        void load(const std::uintmax_t offA, const std::uintmax_t offB, const std::size_t len)
+        {
+            if (bd::pread_fully(inA.get(), bufferA, len, offA) != len || bd::pread_fully(inB.get(), bufferB, len, offB) != len)
+            {
+                throw std::runtime_error("Input changed size during diff");
+            }
+        }
+
+        // Leading bytes of len that are the same at offA and offB.
+        std::uintmax_t commonPrefix(const std::uintmax_t offA, const std::uintmax_t offB, const std::uintmax_t len)
+        {
+            for (std::uintmax_t done = 0; done < len;)
+            {
+                const auto want = static_cast<std::size_t>(std::min<std::uintmax_t>(PIECE_LENGTH, len - done));
+                load(offA + done, offB + done, want);
+
+                if (const std::size_t i = bd::find_difference(bufferA, bufferB, want); i < want)
+                {
+                    return done + i;
+                }
+
+                done += want;
+            }
+
+            return len;
+        }
+
+        // Trailing bytes of len that are the same before endA and endB.
+        std::uintmax_t commonSuffix(const std::uintmax_t endA, const std::uintmax_t endB, const std::uintmax_t len)
+        {
+            for (std::uintmax_t done = 0; done < len;)
+            {
+                const auto want = static_cast<std::size_t>(std::min<std::uintmax_t>(PIECE_LENGTH, len - done));
+                load(endA - done - want, endB - done - want, want);
+
+                for (std::size_t i = want; i > 0; --i)
+                {
+                    if (bufferA[i - 1] != bufferB[i - 1])
+                    {
+                        return done + (want - i);
+                    }
+                }
+
+                done += want;
+            }
+
+            return len;
+        }
+
+        // Unmatched bytes between two matches. Whatever both sides share at
+        // either end is trimmed (chunks around an edit are mostly intact);
+        // what remains is an edit in place up to the shorter side.
+        void gap(range_s a, range_s b)
+        {
+            if (a.length > 0 && b.length > 0)
+            {
+                const std::uintmax_t head = commonPrefix(a.offset, b.offset, std::min(a.length, b.length));
+                a.offset += head;
+                a.length -= head;
+                b.offset += head;
+                b.length -= head;
+
+                const std::uintmax_t tail = commonSuffix(a.offset + a.length, b.offset + b.length, std::min(a.length, b.length));
+                a.length -= tail;
+                b.length -= tail;
+            }
+
+            if (a.length == 0)
+            {
+                if (b.length > 0)
+                {
+                    inserted(b.offset, b.length);
+                }
+
+                return;
+            }
+
+            if (b.length == 0)
+            {
+                deleted(a.offset, a.length);
+                return;
+            }
+
+            const std::uintmax_t common = std::min(a.length, b.length);
+            region("change", a.offset, b.offset, common);
+            compare(a.offset, b.offset, common);
+
+            if (b.length > common)
+            {
+                inserted(b.offset + common, b.length - common);
+            }
+            else if (a.length > common)
+            {
+                deleted(a.offset + common, a.length - common);
+            }
+        }
+
+        void compare(const std::uintmax_t offA, const std::uintmax_t offB, const std::uintmax_t len)
+        {
+            for (std::uintmax_t done = 0; done < len;)
+            {
+                const auto want = static_cast<std::size_t>(std::min<std::uintmax_t>(PIECE_LENGTH, len - done));
+                load(offA + done, offB + done, want);
+
+                const bd::TraceSpan span("compare");
+
+                bd::for_each_difference(bufferA, bufferB, want, [&](const std::size_t i)
+                {
+                    out->init(offA + done + i, bufferA[i], bufferB[i]);
+
+                    ++count.changed.bytes;
+                    count.changed.bits += static_cast<std::uintmax_t>(out->getDiffPopCount());
+
+                    out->print(output);
+                    newline();
+                });
+
+                done += want;
+            }
+        }
+    };
+}
+
+bd::ShiftDiff::~ShiftDiff() = default;
+
+bd::ShiftDiff::ShiftDiff(std::string_view a, std::string_view b, const bool keepCache, const bool fastMode) :
+    m_path_a(a),
+    m_path_b(b),
+    m_fsize_a(fs::file_size(m_path_a)),
+    m_fsize_b(fs::file_size(m_path_b)),
+    m_keepCache(keepCache),
+    m_fast(fastMode),
+    m_valid(true)
+{
+}
+
+std::uintmax_t bd::ShiftDiff::getFileASize() const noexcept
+{
+    return m_fsize_a;
+}
+
+std::uintmax_t bd::ShiftDiff::getFileBSize() const noexcept
+{
+    return m_fsize_b;
+}
+
+bd::shift_count bd::ShiftDiff::process(Sink& output, const bool printHeader, const DataOutType type)
+{
+    if (!m_valid)
+    {
+        throw std::runtime_error("Attempt to use invalid object");
+    }
+
+    m_valid = false;
+
+    // Chunk both inputs at once; the rolling hash is the expensive part.
+    std::vector<chunk_s> chunksA;
+    std::vector<chunk_s> chunksB;
+    {
+        std::exception_ptr errorA;
+        std::jthread worker([&]
+        {
+            trace_thread_name("chunk A");
+
+            try
+            {
+                chunksA = chunk_file(m_path_a, m_keepCache);
+            }
+            catch (...)
+            {
+                errorA = std::current_exception();
+            }
+        });
+
+        chunksB = chunk_file(m_path_b, m_keepCache);
+        worker.join();
+
+        if (errorA)
+        {
+            std::rethrow_exception(errorA);
+        }
+    }
+
+    std::cerr << "Chunks: " << chunksA.size() << " in A, " << chunksB.size() << " in B" << std::endl;
+
+    const std::vector<std::size_t> match = match_chunks(chunksA, chunksB);
+
+    std::vector<bool> usedA(chunksA.size(), false);
+    for (const std::size_t j : match)
+    {
+        if (j != NO_MATCH)
+        {
+            usedA[j] = true;
+        }
+    }
+
+    if (printHeader)
+    {
+        // Paths are quoted the same way operator<< would.
+        std::ostringstream header;
+        header << "Region\tOffset in " << m_path_a << "\tOffset in " << m_path_b << "\tLength";
+
+        const std::string tmp = header.str();
+        output.write(tmp.data(), tmp.size());
+        output.write("\n", 1);
+    }
+
+    emitter_s emit(output, m_fast, m_path_a, m_path_b, type);
+
+    // Alternate between a stretch of unmatched B chunks and a run of B
+    // chunks matching consecutive A chunks. A stretch pairs with the
+    // unmatched A chunks that follow the previous run.
+    std::size_t prevA = 0;
+    for (std::size_t k = 0;;)
+    {
+        const std::size_t gapStart = k;
+        while (k < chunksB.size() && match[k] == NO_MATCH)
+        {
+            ++k;
+        }
+
+        const std::size_t nextA = (k < chunksB.size()) ? match[k] : chunksA.size();
+
+        std::size_t gapEndA = prevA;
+        while (gapEndA < nextA && !usedA[gapEndA])
+        {
+            usedA[gapEndA++] = true;
+        }
+
+        emit.gap(span_of(chunksA, prevA, gapEndA), span_of(chunksB, gapStart, k));
+
+        if (k == chunksB.size())
+        {
+            break;
+        }
+
+        const std::size_t runStart = k;
+        for (++k; k < chunksB.size() && match[k] == match[k - 1] + 1; ++k)
+        {
+        }
+
+        // A run that continues forward through A is in order, however far
+        // the edits before it displaced it. Only a run that goes back to
+        // data before the previous run's end was moved.
+        const range_s run = span_of(chunksB, runStart, k);
+        if (const std::uintmax_t offA = chunksA[match[runStart]].offset; offA != run.offset)
+        {
+            if (match[runStart] >= prevA)
+            {
+                emit.shifted(offA, run.offset, run.length);
+            }
+            else
+            {
+                emit.moved(offA, run.offset, run.length);
+            }
+        }
+
+        prevA = match[k - 1] + 1;
+    }
+
+    // Whatever is left of A appears nowhere in B.
+    for (std::size_t j = 0; j < chunksA.size();)
+    {
+        if (usedA[j])
+        {
+            ++j;
+            continue;
+        }
+
+        const std::size_t first = j;
+        while (j < chunksA.size() && !usedA[j])
+        {
+            ++j;
+        }
+
+        const range_s gone = span_of(chunksA, first, j);
+        emit.deleted(gone.offset, gone.length);
+    }
+
+    output.flush();
+
+    return emit.count;
+}
@@ -0,0 +1,599 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <algorithm>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "bitdiff/trace.hpp"
+#include "bitdiff/sink.hpp"
+
+namespace bd = isaki::bitdiff;
+namespace fs = std::filesystem;
+
+namespace
+{
+    // Large enough to amortize the syscall, small enough to stay in L2.
+    constexpr std::size_t OUTPUT_BUFFER_LENGTH = 256 * 1024;
+
+    // In-memory sinks only stage to batch the string appends.
+    constexpr std::size_t STAGING_LENGTH = 16 * 1024;
+
+    // Reservation granularity for fallocate.
+    constexpr std::size_t PREALLOC_STEP = 64 * 1024 * 1024;
+
+    // vmsplice rotates through this many output buffers, with the pipe
+    // sized to hold all but one of them (1 MiB, the default unprivileged
+    // limit). Once a buffer is spliced, the one after it has left the pipe.
+    constexpr std::size_t SPLICE_BUFFERS = 5;
+    constexpr std::size_t SPLICE_PIPE_LENGTH = (SPLICE_BUFFERS - 1) * OUTPUT_BUFFER_LENGTH;
+
+    [[noreturn]] void throw_failure(const char* what, const int err)
+    {
+        throw std::ios_base::failure(what, std::error_code(err, std::generic_category()));
+    }
+
+    char* map_buffer()
+    {
+        void* ptr = ::mmap(nullptr, SPLICE_BUFFERS * OUTPUT_BUFFER_LENGTH, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+
+        return static_cast<char*>(ptr);
+    }
+}
+
+//
+// BASE CLASS
+//
+
+bd::Sink::~Sink() = default;
+
+bd::Sink::Sink() noexcept :
+    m_committed(0),
+    m_begin(nullptr),
+    m_pos(nullptr),
+    m_end(nullptr) {}
+
+void bd::Sink::setBuffer(char* buffer, const std::size_t len) noexcept
+{
+    m_begin = buffer;
+    m_pos = buffer;
+    m_end = buffer + len;
+}
+
+void bd::Sink::flush()
+{
+    if (m_pos != m_begin)
+    {
+        const auto staged = static_cast<std::size_t>(m_pos - m_begin);
+        commit(m_begin, staged, nullptr, 0);
+        m_committed += staged;
+        m_pos = m_begin;
+    }
+
+    sync();
+}
+
+void bd::Sink::persist()
+{
+    flush();
+    syncData();
+}
+
+std::uintmax_t bd::Sink::tell() const noexcept
+{
+    return m_committed + static_cast<std::uintmax_t>(m_pos - m_begin);
+}
+
+void bd::Sink::setPosition(const std::uintmax_t position) noexcept
+{
+    m_committed = position;
+}
+
+void bd::Sink::sync()
+{
+    // Nothing beyond the staging buffer by default.
+}
+
+void bd::Sink::syncData()
+{
+    // Nothing is durable by default.
+}
+
+void bd::Sink::overflow(const char* data, std::size_t len)
+{
+    const auto capacity = static_cast<std::size_t>(m_end - m_begin);
+
+    if (len < capacity)
+    {
+        // Top up so derived classes always see full buffers here.
+        const auto room = static_cast<std::size_t>(m_end - m_pos);
+        std::memcpy(m_pos, data, room);
+
+        commit(m_begin, capacity, nullptr, 0);
+        m_committed += capacity;
+
+        // commit() may have swapped the buffer.
+        m_pos = m_begin;
+
+        data += room;
+        len -= room;
+
+        std::memcpy(m_pos, data, len);
+        m_pos += len;
+    }
+    else
+    {
+        const auto staged = static_cast<std::size_t>(m_pos - m_begin);
+        commit(m_begin, staged, data, len);
+        m_committed += staged + len;
+        m_pos = m_begin;
+    }
+}
+
+//
+// OSTREAM
+//
+
+bd::OStreamSink::~OStreamSink() = default;
+
+bd::OStreamSink::OStreamSink(std::ostream& os) :
+    m_os(os) {}
+
+void bd::OStreamSink::commit(const char* staged, const std::size_t stagedLen, const char* data, const std::size_t len)
+{
+    if (stagedLen > 0)
+    {
+        m_os.write(staged, static_cast<std::streamsize>(stagedLen));
+    }
+
+    if (len > 0)
+    {
+        m_os.write(data, static_cast<std::streamsize>(len));
+    }
+}
+
+void bd::OStreamSink::sync()
+{
+    m_os.flush();
+}
+
+//
+// MEMORY
+//
+
+bd::BufferSink::~BufferSink()
+{
+    delete[] m_buffer;
+}
+
+bd::BufferSink::BufferSink() :
+    m_buffer(new char[STAGING_LENGTH])
+{
+    setBuffer(m_buffer, STAGING_LENGTH);
+}
+
+std::string bd::BufferSink::take()
+{
+    flush();
+
+    std::string ret;
+    ret.swap(m_data);
+    return ret;
+}
+
+void bd::BufferSink::commit(const char* staged, const std::size_t stagedLen, const char* data, const std::size_t len)
+{
+    if (stagedLen > 0)
+    {
+        m_data.append(staged, stagedLen);
+    }
+
+    if (len > 0)
+    {
+        m_data.append(data, len);
+    }
+}
+
+//
+// FILE DESCRIPTOR
+//
+
+bd::FdSink::~FdSink()
+{
+    cleanup();
+}
+
+bd::FdSink::FdSink(const int fd, const bool useVmsplice) :
+    m_offset(0),
+    m_reserved(0),
+    m_buffer(nullptr),
+    m_spliceIndex(0),
+    m_fd(fd),
+    m_owned(false),
+    m_bad(false),
+    m_vmsplice(false),
+    m_preallocate(false)
+{
+#ifdef __linux__
+    if (struct stat st{}; useVmsplice && ::fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode))
+    {
+        // Reusing buffers is only safe when the pipe holds no more than the
+        // rest of the ring.
+        const int pipeLength = static_cast<int>(SPLICE_PIPE_LENGTH);
+        if (::fcntl(fd, F_SETPIPE_SZ, pipeLength) == pipeLength)
+        {
+            m_vmsplice = true;
+        }
+        else
+        {
+            std::cerr << "Unable to resize the output pipe; writing instead of splicing" << std::endl;
+        }
+    }
+#else
+    static_cast<void>(useVmsplice);
+#endif
+
+    allocateBuffer();
+}
+
+bd::FdSink::FdSink(const fs::path& file) :
+    m_offset(0),
+    m_reserved(0),
+    m_buffer(nullptr),
+    m_spliceIndex(0),
+    m_fd(-1),
+    m_owned(true),
+    m_bad(false),
+    m_vmsplice(false),
+#ifdef __linux__
+    m_preallocate(true)
+#else
+    m_preallocate(false)
+#endif
+{
+    open(file, O_TRUNC);
+
+    try
+    {
+        allocateBuffer();
+    }
+    catch (...)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+        throw;
+    }
+}
+
+bd::FdSink::FdSink(const fs::path& file, const std::uintmax_t position) :
+    m_offset(position),
+    m_reserved(position),
+    m_buffer(nullptr),
+    m_spliceIndex(0),
+    m_fd(-1),
+    m_owned(true),
+    m_bad(false),
+    m_vmsplice(false),
+#ifdef __linux__
+    m_preallocate(true)
+#else
+    m_preallocate(false)
+#endif
+{
+    open(file, 0);
+
+    try
+    {
+        struct stat st{};
+        if (::fstat(m_fd, &st) != 0)
+        {
+            throw_failure("Unable to stat output", errno);
+        }
+
+        if (static_cast<std::uintmax_t>(st.st_size) < position)
+        {
+            std::string err;
+            err.append(file.string());
+            err.append(" is shorter than the resume position");
+            throw std::runtime_error(err);
+        }
+
+        // Anything past the position was written after the checkpoint.
+        if (::ftruncate(m_fd, static_cast<off_t>(position)) != 0
+            || ::lseek(m_fd, static_cast<off_t>(position), SEEK_SET) < 0)
+        {
+            throw_failure("Unable to position output", errno);
+        }
+
+        setPosition(position);
+        allocateBuffer();
+    }
+    catch (...)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+        throw;
+    }
+}
+
+void bd::FdSink::close()
+{
+    if (m_fd < 0)
+    {
+        return;
+    }
+
+    // Like badbit: once a write has failed nothing more is attempted.
+    if (!m_bad)
+    {
+        flush();
+    }
+
+    // Hand back whatever we reserved past the final write position. Punching
+    // a hole beyond EOF does not free blocks on ext4; truncating does.
+    if (m_reserved > m_offset)
+    {
+        if (::ftruncate(m_fd, static_cast<off_t>(m_offset)) != 0)
+        {
+            m_bad = true;
+            throw_failure("Unable to release reserved output space", errno);
+        }
+
+        m_reserved = m_offset;
+    }
+
+    if (m_owned)
+    {
+        const int fd = m_fd;
+        m_fd = -1;
+
+        if (::close(fd) != 0)
+        {
+            throw_failure("Unable to close output", errno);
+        }
+    }
+    else
+    {
+        m_fd = -1;
+    }
+}
+
+void bd::FdSink::commit(const char* staged, const std::size_t stagedLen, const char* data, const std::size_t len)
+{
+    const TraceSpan span("flush");
+
+    // Only full pages can be gifted; partial flushes (non-fast mode) are
+    // cheaper to copy than to remap.
+    if (m_vmsplice && stagedLen == OUTPUT_BUFFER_LENGTH)
+    {
+        spliceAll(staged, stagedLen);
+        writeAll(nullptr, 0, data, len);
+    }
+    else
+    {
+        writeAll(staged, stagedLen, data, len);
+    }
+}
+
+void bd::FdSink::syncData()
+{
+    if (m_fd < 0 || m_bad)
+    {
+        return;
+    }
+
+    // Pipes and terminals have nothing to sync.
+    if (::fdatasync(m_fd) != 0 && errno != EINVAL && errno != EROFS)
+    {
+        m_bad = true;
+        throw_failure("Unable to sync output", errno);
+    }
+}
+
+void bd::FdSink::open(const fs::path& file, const int flags)
+{
+    m_fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | flags, 0666);
+    if (m_fd < 0)
+    {
+        std::string err;
+        err.append("Unable to open ");
+        err.append(file.string());
+        err.append(": ");
+        err.append(std::strerror(errno));
+        throw std::runtime_error(err);
+    }
+
+    // Devices such as /dev/null cannot be preallocated.
+    if (struct stat st{}; ::fstat(m_fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        m_preallocate = false;
+    }
+}
+
+void bd::FdSink::allocateBuffer()
+{
+    // vmsplice hands pages to the pipe, so those buffers must be page
+    // aligned; the ring is mapped once and m_buffer is its first buffer.
+    m_buffer = m_vmsplice ? map_buffer() : new char[OUTPUT_BUFFER_LENGTH];
+    m_spliceIndex = 0;
+    setBuffer(m_buffer, OUTPUT_BUFFER_LENGTH);
+}
+
+void bd::FdSink::releaseBuffer() noexcept
+{
+    if (m_buffer == nullptr)
+    {
+        return;
+    }
+
+    if (m_vmsplice)
+    {
+        ::munmap(m_buffer, SPLICE_BUFFERS * OUTPUT_BUFFER_LENGTH);
+    }
+    else
+    {
+        delete[] m_buffer;
+    }
+
+    m_buffer = nullptr;
+    setBuffer(nullptr, 0);
+}
+
+void bd::FdSink::reserve(const std::size_t len)
+{
+#ifdef __linux__
+    if (!m_preallocate || m_offset + len <= m_reserved)
+    {
+        return;
+    }
+
+    const std::uintmax_t start = std::max(m_offset, m_reserved);
+    const std::uintmax_t step = std::max<std::uintmax_t>(PREALLOC_STEP, m_offset + len - start);
+
+    if (::fallocate(m_fd, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(start), static_cast<off_t>(step)) != 0)
+    {
+        if (errno == EOPNOTSUPP || errno == ENOSYS || errno == EINVAL)
+        {
+            // Not supported here; plain writes still work.
+            m_preallocate = false;
+            return;
+        }
+
+        m_bad = true;
+        throw_failure("Unable to reserve output space", errno);
+    }
+
+    m_reserved = start + step;
+#else
+    static_cast<void>(len);
+#endif
+}
+
+void bd::FdSink::writeAll(const char* staged, const std::size_t stagedLen, const char* data, const std::size_t len)
+{
+    iovec iov[2];
+    int count = 0;
+
+    if (stagedLen > 0)
+    {
+        iov[count++] = { .iov_base = const_cast<char*>(staged), .iov_len = stagedLen };
+    }
+
+    if (len > 0)
+    {
+        iov[count++] = { .iov_base = const_cast<char*>(data), .iov_len = len };
+    }
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    reserve(stagedLen + len);
+
+    iovec* cur = iov;
+    while (count > 0)
+    {
+        const ssize_t written = ::writev(m_fd, cur, count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            m_bad = true;
+            throw_failure("Unable to write output", errno);
+        }
+
+        auto remaining = static_cast<std::size_t>(written);
+        m_offset += remaining;
+
+        while (count > 0 && remaining >= cur->iov_len)
+        {
+            remaining -= cur->iov_len;
+            ++cur;
+            --count;
+        }
+
+        if (count > 0)
+        {
+            cur->iov_base = static_cast<char*>(cur->iov_base) + remaining;
+            cur->iov_len -= remaining;
+        }
+    }
+}
+
+void bd::FdSink::spliceAll(const char* staged, const std::size_t stagedLen)
+{
+#ifdef __linux__
+    iovec iov = { .iov_base = const_cast<char*>(staged), .iov_len = stagedLen };
+
+    while (iov.iov_len > 0)
+    {
+        const ssize_t spliced = ::vmsplice(m_fd, &iov, 1, 0);
+        if (spliced < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            m_bad = true;
+            throw_failure("Unable to splice output", errno);
+        }
+
+        iov.iov_base = static_cast<char*>(iov.iov_base) + spliced;
+        iov.iov_len -= static_cast<std::size_t>(spliced);
+        m_offset += static_cast<std::uintmax_t>(spliced);
+    }
+
+    // The pipe now holds references to these pages, so move on to the next
+    // buffer; the pipe size guarantees it has been read.
+    m_spliceIndex = (m_spliceIndex + 1) % SPLICE_BUFFERS;
+    setBuffer(m_buffer + (m_spliceIndex * OUTPUT_BUFFER_LENGTH), OUTPUT_BUFFER_LENGTH);
+#else
+    writeAll(staged, stagedLen, nullptr, 0);
+#endif
+}
+
+void bd::FdSink::cleanup() noexcept
+{
+    try
+    {
+        close();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Failed to close output: " << e.what() << std::endl;
+
+        if (m_owned && m_fd >= 0)
+        {
+            ::close(m_fd);
+        }
+
+        m_fd = -1;
+    }
+
+    releaseBuffer();
+}
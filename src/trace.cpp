@@ -0,0 +1,223 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+
+#include "bitdiff/trace.hpp"
+
+namespace bd = isaki::bitdiff;
+namespace fs = std::filesystem;
+
+namespace
+{
+    bd::Tracer* g_tracer = nullptr;
+
+    // Rings are per tracer, and there is only ever one.
+    thread_local void* t_ring = nullptr;
+
+    std::uint64_t steady_ns() noexcept
+    {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Trace event timestamps are microseconds.
+    void append_us(std::string& out, const std::uint64_t ns)
+    {
+        out.append(std::to_string(ns / 1000));
+        out.push_back('.');
+
+        const std::string frac = std::to_string(ns % 1000);
+        out.append(3 - frac.size(), '0');
+        out.append(frac);
+    }
+
+    void append_quoted(std::string& out, const std::string_view text)
+    {
+        out.push_back('"');
+        for (const char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out.push_back('\\');
+            }
+
+            if (static_cast<unsigned char>(c) >= 0x20)
+            {
+                out.push_back(c);
+            }
+        }
+
+        out.push_back('"');
+    }
+}
+
+bd::Tracer::~Tracer()
+{
+    if (g_tracer == this)
+    {
+        g_tracer = nullptr;
+    }
+}
+
+bd::Tracer::Tracer(const std::size_t eventsPerThread) :
+    m_capacity(std::max<std::size_t>(1, eventsPerThread)),
+    m_epoch(steady_ns())
+{
+    if (g_tracer != nullptr)
+    {
+        throw std::runtime_error("A tracer is already installed");
+    }
+
+    g_tracer = this;
+}
+
+bd::Tracer* bd::Tracer::getActive() noexcept
+{
+    return g_tracer;
+}
+
+std::uint64_t bd::Tracer::now() const noexcept
+{
+    return steady_ns() - m_epoch;
+}
+
+bd::Tracer::ring_s* bd::Tracer::getRing() noexcept
+{
+    if (t_ring != nullptr)
+    {
+        return static_cast<ring_s*>(t_ring);
+    }
+
+    try
+    {
+        auto ring = std::make_unique<ring_s>();
+        ring->events = std::make_unique<event_s[]>(m_capacity);
+        ring->count = 0;
+
+        std::scoped_lock<std::mutex> lock(m_mtx);
+        ring->thread = "thread " + std::to_string(m_rings.size());
+        m_rings.push_back(std::move(ring));
+
+        t_ring = m_rings.back().get();
+        return m_rings.back().get();
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void bd::Tracer::write(const fs::path& file) const
+{
+    std::string out;
+    out.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    const std::string pid = std::to_string(::getpid());
+    bool first = true;
+
+    for (std::size_t tid = 0; tid < m_rings.size(); ++tid)
+    {
+        const ring_s& ring = *m_rings[tid];
+
+        out.append(first ? "\n" : ",\n");
+        first = false;
+
+        out.append("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":");
+        out.append(pid);
+        out.append(",\"tid\":");
+        out.append(std::to_string(tid));
+        out.append(",\"args\":{\"name\":");
+        append_quoted(out, ring.thread);
+        out.append("}}");
+
+        // Oldest surviving span first.
+        const std::uint64_t kept = std::min<std::uint64_t>(ring.count, m_capacity);
+        for (std::uint64_t i = ring.count - kept; i < ring.count; ++i)
+        {
+            const event_s& e = ring.events[i % m_capacity];
+
+            out.append(",\n{\"ph\":\"X\",\"name\":");
+            append_quoted(out, e.name);
+            out.append(",\"pid\":");
+            out.append(pid);
+            out.append(",\"tid\":");
+            out.append(std::to_string(tid));
+            out.append(",\"ts\":");
+            append_us(out, e.begin);
+            out.append(",\"dur\":");
+            append_us(out, e.end - e.begin);
+            out.append("}");
+        }
+    }
+
+    out.append("\n]}\n");
+
+    std::ofstream os(file, std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!os.write(out.data(), static_cast<std::streamsize>(out.size())) || !os.flush())
+    {
+        std::string err;
+        err.append("Unable to write trace ");
+        err.append(file.string());
+        throw std::runtime_error(err);
+    }
+}
+
+//
+// SPAN
+//
+
+bd::TraceSpan::TraceSpan(const char* name) noexcept :
+    m_tracer(Tracer::getActive()),
+    m_name(name),
+    m_begin((m_tracer != nullptr) ? m_tracer->now() : 0) {}
+
+bd::TraceSpan::~TraceSpan()
+{
+    if (m_tracer == nullptr) [[likely]]
+    {
+        return;
+    }
+
+    Tracer::ring_s* ring = m_tracer->getRing();
+    if (ring == nullptr)
+    {
+        return;
+    }
+
+    ring->events[ring->count % m_tracer->m_capacity] = { .name = m_name, .begin = m_begin, .end = m_tracer->now() };
+    ++ring->count;
+}
+
+void bd::trace_thread_name(const std::string_view name) noexcept
+{
+    Tracer* tracer = Tracer::getActive();
+    if (tracer == nullptr)
+    {
+        return;
+    }
+
+    if (Tracer::ring_s* ring = tracer->getRing(); ring != nullptr)
+    {
+        try
+        {
+            ring->thread.assign(name);
+        }
+        catch (...)
+        {
+            // Keep the default name.
+        }
+    }
+}
@@ -0,0 +1,402 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <filesystem>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bitdiff/arena.hpp"
+#include "bitdiff/compare.hpp"
+#include "bitdiff/dataout.hpp"
+#include "bitdiff/fd.hpp"
+#include "bitdiff/pool.hpp"
+#include "bitdiff/reader.hpp"
+#include "bitdiff/sink.hpp"
+#include "bitdiff/trace.hpp"
+#include "bitdiff/tree.hpp"
+
+namespace bd = isaki::bitdiff;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr char OUT_DELIM = '\t';
+
+    // Per worker read size.
+    constexpr std::size_t CHUNK_LENGTH = 1024 * 1024;
+
+    // Files longer than this are split into pieces of this length.
+    constexpr std::uintmax_t SPLIT_LENGTH = 8 * 1024 * 1024;
+
+    // Files no longer than this are batched until the batch reaches it.
+    constexpr std::uintmax_t BATCH_LENGTH = 4 * 1024 * 1024;
+
+    // Tasks allowed ahead of the one being emitted, per worker. Bounds the
+    // memory held by finished but not yet emitted output.
+    constexpr std::size_t WINDOW_PER_THREAD = 4;
+
+    constexpr std::size_t SCRATCH_LENGTH = 4096;
+
+    struct piece_s
+    {
+        std::size_t pair;
+        std::uintmax_t offset;
+        std::uintmax_t length;
+    };
+
+    struct task_s
+    {
+        std::vector<piece_s> pieces;
+    };
+
+    struct slot_s
+    {
+        std::string text;
+        bd::diff_count count;
+        std::exception_ptr error;
+        bool done;
+    };
+
+    struct worker_s
+    {
+        bd::Arena arena;
+        unsigned char* bufferA;
+        unsigned char* bufferB;
+        std::unique_ptr<bd::DataOut> out;
+        bd::BufferSink sink;
+
+        worker_s(const bd::DataOutType type, const std::size_t wordSize) :
+            arena((2 * CHUNK_LENGTH) + SCRATCH_LENGTH),
+            bufferA(arena.allocate<unsigned char>(CHUNK_LENGTH, bd::IO_ALIGNMENT)),
+            bufferB(arena.allocate<unsigned char>(CHUNK_LENGTH, bd::IO_ALIGNMENT)),
+            out(bd::make_data_out(type, OUT_DELIM, wordSize, arena)) {}
+    };
+
+    // Sorted relative paths of every regular file beneath root.
+    std::vector<std::string> list_files(const fs::path& root)
+    {
+        if (!fs::is_directory(root))
+        {
+            std::string err;
+            err.append(root.string());
+            err.append(" is not a directory");
+            throw std::runtime_error(err);
+        }
+
+        std::vector<std::string> ret;
+        for (const fs::directory_entry& entry : fs::recursive_directory_iterator(root))
+        {
+            if (entry.is_regular_file())
+            {
+                ret.push_back(entry.path().lexically_relative(root).generic_string());
+            }
+        }
+
+        std::sort(ret.begin(), ret.end());
+        return ret;
+    }
+}
+
+bd::TreeDiff::~TreeDiff() = default;
+
+bd::TreeDiff::TreeDiff(std::string_view a, std::string_view b, const std::size_t threads, const bool fastMode) :
+    m_root_a(a),
+    m_root_b(b),
+    m_threads(threads),
+    m_fast(fastMode),
+    m_valid(true)
+{
+    const std::vector<std::string> filesA = list_files(m_root_a);
+    const std::vector<std::string> filesB = list_files(m_root_b);
+
+    // Merge the two sorted listings.
+    auto itA = filesA.begin();
+    auto itB = filesB.begin();
+
+    while (itA != filesA.end() || itB != filesB.end())
+    {
+        if (itB == filesB.end() || (itA != filesA.end() && *itA < *itB))
+        {
+            m_only_a.push_back(*itA++);
+        }
+        else if (itA == filesA.end() || *itB < *itA)
+        {
+            m_only_b.push_back(*itB++);
+        }
+        else
+        {
+            m_pairs.push_back({
+                .relative = *itA,
+                .sizeA = fs::file_size(m_root_a / *itA),
+                .sizeB = fs::file_size(m_root_b / *itB)
+            });
+
+            ++itA;
+            ++itB;
+        }
+    }
+}
+
+std::size_t bd::TreeDiff::getPairedCount() const noexcept
+{
+    return m_pairs.size();
+}
+
+std::size_t bd::TreeDiff::getUnpairedCount() const noexcept
+{
+    return m_only_a.size() + m_only_b.size();
+}
+
+bd::diff_count bd::TreeDiff::process(Sink& output, const bool printHeader, const DataOutType type, const word_format_s& word)
+{
+    if (!m_valid)
+    {
+        throw std::runtime_error("Attempt to use invalid object");
+    }
+
+    m_valid = false;
+
+    for (const std::string& rel : m_only_a)
+    {
+        std::cerr << "Only in " << m_root_a << ": " << rel << std::endl;
+    }
+
+    for (const std::string& rel : m_only_b)
+    {
+        std::cerr << "Only in " << m_root_b << ": " << rel << std::endl;
+    }
+
+    // Cut the pairs into tasks, keeping path order.
+    std::vector<task_s> tasks;
+    task_s batch;
+    std::uintmax_t batchLength = 0;
+
+    const auto flushBatch = [&tasks, &batch, &batchLength]
+    {
+        if (!batch.pieces.empty())
+        {
+            tasks.push_back(std::move(batch));
+            batch = task_s();
+            batchLength = 0;
+        }
+    };
+
+    for (std::size_t i = 0; i < m_pairs.size(); ++i)
+    {
+        const pair_s& pair = m_pairs[i];
+
+        if (pair.sizeA != pair.sizeB)
+        {
+            std::cerr
+                << pair.relative << ": sizes differ ("
+                << pair.sizeA << " and " << pair.sizeB
+                << "); diff will end at smaller size"
+                << std::endl;
+        }
+
+        const std::uintmax_t len = std::min(pair.sizeA, pair.sizeB);
+        if (len == 0)
+        {
+            continue;
+        }
+
+        if (len <= BATCH_LENGTH)
+        {
+            batch.pieces.push_back({ .pair = i, .offset = 0, .length = len });
+            batchLength += len;
+
+            if (batchLength >= BATCH_LENGTH)
+            {
+                flushBatch();
+            }
+
+            continue;
+        }
+
+        flushBatch();
+
+        for (std::uintmax_t off = 0; off < len; off += SPLIT_LENGTH)
+        {
+            task_s task;
+            task.pieces.push_back({ .pair = i, .offset = off, .length = std::min(SPLIT_LENGTH, len - off) });
+            tasks.push_back(std::move(task));
+        }
+    }
+
+    flushBatch();
+
+    if (printHeader)
+    {
+        // Paths are quoted the same way operator<< would.
+        std::ostringstream header;
+        const char* unit = (word.size > 1) ? "Word" : "Byte";
+        header << "Path\tOffset\t" << unit << " in " << m_root_a << "\t" << unit << " in " << m_root_b << '\n';
+
+        const std::string tmp = header.str();
+        output.write(tmp.data(), tmp.size());
+    }
+
+    // Declaration order matters: the pool must stop before the state its
+    // tasks reference is destroyed.
+    std::vector<slot_s> slots(tasks.size());
+    std::mutex mtx;
+    std::condition_variable finished;
+
+    const std::size_t threads = (m_threads == 0) ? std::max(1U, std::thread::hardware_concurrency()) : m_threads;
+
+    std::vector<std::unique_ptr<worker_s>> workers;
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+        workers.push_back(std::make_unique<worker_s>(type, word.size));
+    }
+
+    const auto runTask = [this, &tasks, &slots, &workers, &mtx, &finished, &word](const std::size_t t, const std::size_t w)
+    {
+        worker_s& worker = *workers[w];
+        slot_s& slot = slots[t];
+
+        diff_count count = { .bytes = 0, .bits = 0 };
+        std::exception_ptr error;
+        std::string text;
+
+        // Every path below fills the slot; the main thread waits on it.
+        try
+        {
+            for (const piece_s& piece : tasks[t].pieces)
+            {
+                const pair_s& pair = m_pairs[piece.pair];
+
+                const bd::FileDescriptor fileA = bd::open_read(m_root_a / pair.relative);
+                const bd::FileDescriptor fileB = bd::open_read(m_root_b / pair.relative);
+
+                std::string prefix = pair.relative;
+                prefix.push_back(OUT_DELIM);
+
+                for (std::uintmax_t done = 0; done < piece.length;)
+                {
+                    const auto want = static_cast<std::size_t>(std::min<std::uintmax_t>(CHUNK_LENGTH, piece.length - done));
+                    const std::uintmax_t base = piece.offset + done;
+
+                    const std::size_t tmpA = pread_fully(fileA.get(), worker.bufferA, want, base);
+                    const std::size_t tmpB = pread_fully(fileB.get(), worker.bufferB, want, base);
+                    const std::size_t tmpX = std::min(tmpA, tmpB);
+
+                    for_each_word_difference(word, worker.bufferA, worker.bufferB, tmpX, [&](const std::size_t i, const std::uint64_t wordA, const std::uint64_t wordB)
+                    {
+                        worker.out->init(base + i, wordA, wordB);
+
+                        count.bytes += static_cast<std::uintmax_t>(nonzero_bytes(wordA ^ wordB));
+                        count.bits += static_cast<std::uintmax_t>(worker.out->getDiffPopCount());
+
+                        worker.sink.write(prefix.data(), prefix.size());
+                        worker.out->print(worker.sink);
+                        worker.sink.write("\n", 1);
+                    });
+
+                    if (tmpX != want)
+                    {
+                        // Truncated underneath us.
+                        std::string err;
+                        err.append(pair.relative);
+                        err.append(": file changed during diff");
+                        throw std::runtime_error(err);
+                    }
+
+                    done += tmpX;
+                }
+            }
+
+            text = worker.sink.take();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+
+            // Drop the partial text so the worker's next task starts clean.
+            try
+            {
+                static_cast<void>(worker.sink.take());
+            }
+            catch (...)
+            {
+                // The error above is the one to report.
+            }
+        }
+
+        std::scoped_lock<std::mutex> lock(mtx);
+        slot.text = std::move(text);
+        slot.count = count;
+        slot.error = error;
+        slot.done = true;
+        finished.notify_all();
+    };
+
+    WorkPool pool(threads, TaskOrder::OldestFirst);
+
+    std::size_t submitted = 0;
+    const auto submitNext = [&pool, &submitted, &runTask]
+    {
+        const std::size_t t = submitted++;
+        pool.submit([t, &runTask](const std::size_t w) { runTask(t, w); });
+    };
+
+    const std::size_t window = pool.getThreadCount() * WINDOW_PER_THREAD;
+    while (submitted < tasks.size() && submitted < window)
+    {
+        submitNext();
+    }
+
+    bd::diff_count ret = { .bytes = 0, .bits = 0 };
+
+    for (slot_s& slot : slots)
+    {
+        std::string text;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            const TraceSpan span("wait");
+            finished.wait(lock, [&slot] { return slot.done; });
+
+            if (slot.error)
+            {
+                std::rethrow_exception(slot.error);
+            }
+
+            text.swap(slot.text);
+        }
+
+        output.write(text.data(), text.size());
+        if (!m_fast)
+        {
+            output.flush();
+        }
+
+        ret.bytes += slot.count.bytes;
+        ret.bits += slot.count.bits;
+
+        if (submitted < tasks.size())
+        {
+            submitNext();
+        }
+    }
+
+    output.flush();
+
+    return ret;
+}
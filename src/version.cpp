@@ -7,6 +7,7 @@
 #include <boost/version.hpp>
 
 #include "bitdiff_internal/config.hpp"
+#include "bitdiff/kernel.hpp"
 #include "bitdiff/version.hpp"
 
 namespace bd = isaki::bitdiff;
@@ -53,4 +54,7 @@ void bd::print_version(std::ostream& os, const std::string_view name)
         << '.'
         << BOOST_VERSION_PATCH
         << std::endl;
+
+    os << "Compare kernel: " << get_kernel_name() << std::endl;
+    os << "Bit kernel: " << get_bit_kernel_name() << std::endl;
 }
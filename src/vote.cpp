@@ -0,0 +1,232 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "bitdiff/arena.hpp"
+#include "bitdiff/kernel.hpp"
+#include "bitdiff/reader.hpp"
+#include "bitdiff/sink.hpp"
+#include "bitdiff/trace.hpp"
+#include "bitdiff/vote.hpp"
+
+namespace bd = isaki::bitdiff;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr char OUT_DELIM = '\t';
+
+    constexpr std::size_t REPLICAS = 3;
+
+    // Per input fill; all three readers use the same size so their chunks
+    // line up.
+    constexpr std::size_t READ_LENGTH = 2 * 1024 * 1024;
+
+    constexpr std::size_t ADDRESS_DIGITS = 16;
+    constexpr std::size_t BYTE_DIGITS = 2;
+
+    constexpr std::string_view OUTLIER_NAMES = "ABC";
+    constexpr char NO_OUTLIER = '-';
+
+    constexpr std::string_view HEX_DIGITS = "0123456789abcdef";
+
+    char* put_hex(char* pos, std::uintmax_t value, const std::size_t digits) noexcept
+    {
+        *pos++ = '0';
+        *pos++ = 'x';
+
+        for (std::size_t i = digits; i > 0; --i)
+        {
+            pos[i - 1] = HEX_DIGITS[value & 0xF];
+            value >>= 4;
+        }
+
+        return pos + digits;
+    }
+
+    // Bitwise majority of three; a plain loop the compiler vectorizes.
+    void majority(const unsigned char* __restrict a, const unsigned char* __restrict b, const unsigned char* __restrict c,
+        unsigned char* __restrict out, const std::size_t len) noexcept
+    {
+        for (std::size_t i = 0; i < len; ++i)
+        {
+            out[i] = static_cast<unsigned char>((a[i] & b[i]) | (c[i] & (a[i] | b[i])));
+        }
+    }
+}
+
+bd::VoteDiff::~VoteDiff() = default;
+
+bd::VoteDiff::VoteDiff(std::string_view a, std::string_view b, std::string_view c, const bool keepCache, const bool fastMode) :
+    m_path_a(a),
+    m_path_b(b),
+    m_path_c(c),
+    m_fsize(fs::file_size(m_path_a)),
+    m_keepCache(keepCache),
+    m_fast(fastMode),
+    m_valid(true)
+{
+    if (fs::file_size(m_path_b) != m_fsize || fs::file_size(m_path_c) != m_fsize)
+    {
+        throw std::runtime_error("Vote requires inputs of equal size");
+    }
+}
+
+std::uintmax_t bd::VoteDiff::getFileSize() const noexcept
+{
+    return m_fsize;
+}
+
+bd::vote_count bd::VoteDiff::process(Sink& output, const bool printHeader, Sink* repair)
+{
+    if (!m_valid)
+    {
+        throw std::runtime_error("Attempt to use invalid object");
+    }
+
+    m_valid = false;
+
+    // Reader and consumer buffers for each input, plus the repaired chunk.
+    Arena arena(((2 * REPLICAS) + 1) * READ_LENGTH);
+
+    std::array<unsigned char*, REPLICAS> buffers{};
+    for (unsigned char*& p : buffers)
+    {
+        p = arena.allocate<unsigned char>(READ_LENGTH, IO_ALIGNMENT);
+    }
+
+    unsigned char* repaired = arena.allocate<unsigned char>(READ_LENGTH, IO_ALIGNMENT);
+
+    // Declared after the arena they borrow from.
+    Reader readerA(m_path_a, arena.allocate<unsigned char>(READ_LENGTH, IO_ALIGNMENT), READ_LENGTH, READ_LENGTH, m_keepCache, 0);
+    Reader readerB(m_path_b, arena.allocate<unsigned char>(READ_LENGTH, IO_ALIGNMENT), READ_LENGTH, READ_LENGTH, m_keepCache, 0);
+    Reader readerC(m_path_c, arena.allocate<unsigned char>(READ_LENGTH, IO_ALIGNMENT), READ_LENGTH, READ_LENGTH, m_keepCache, 0);
+
+    if (printHeader)
+    {
+        // Paths are quoted the same way operator<< would.
+        std::ostringstream header;
+        header << "Offset\tByte in " << m_path_a << "\tByte in " << m_path_b << "\tByte in " << m_path_c << "\tMajority\tOutlier";
+
+        const std::string tmp = header.str();
+        output.write(tmp.data(), tmp.size());
+        output.write("\n", 1);
+    }
+
+    vote_count ret{ .bytes = 0, .outliers = { 0, 0, 0 }, .split = 0 };
+
+    const unsigned char* a = buffers[0];
+    const unsigned char* b = buffers[1];
+    const unsigned char* c = buffers[2];
+
+    const auto emit = [&](const std::uintmax_t offset, const std::size_t i)
+    {
+        const unsigned char m = static_cast<unsigned char>((a[i] & b[i]) | (c[i] & (a[i] | b[i])));
+
+        char outlier = NO_OUTLIER;
+        if (a[i] == b[i])
+        {
+            outlier = OUTLIER_NAMES[2];
+            ++ret.outliers[2];
+        }
+        else if (a[i] == c[i])
+        {
+            outlier = OUTLIER_NAMES[1];
+            ++ret.outliers[1];
+        }
+        else if (b[i] == c[i])
+        {
+            outlier = OUTLIER_NAMES[0];
+            ++ret.outliers[0];
+        }
+        else
+        {
+            ++ret.split;
+        }
+
+        ++ret.bytes;
+
+        char line[64];
+        char* pos = put_hex(line, offset, ADDRESS_DIGITS);
+        for (const unsigned char v : { a[i], b[i], c[i], m })
+        {
+            *pos++ = OUT_DELIM;
+            pos = put_hex(pos, v, BYTE_DIGITS);
+        }
+
+        *pos++ = OUT_DELIM;
+        *pos++ = outlier;
+        *pos++ = '\n';
+
+        output.write(line, static_cast<std::size_t>(pos - line));
+        if (!m_fast)
+        {
+            output.flush();
+        }
+    };
+
+    std::uintmax_t base = 0;
+    while (true)
+    {
+        const std::size_t len = readerA.read(buffers[0]);
+        if (readerB.read(buffers[1]) != len || readerC.read(buffers[2]) != len)
+        {
+            throw std::runtime_error("Read mismatch");
+        }
+
+        if (len == 0)
+        {
+            break;
+        }
+
+        {
+            const TraceSpan span("compare");
+
+            // The next difference against A in each of the other two; each
+            // is only searched again once the scan has passed it.
+            std::size_t nextB = find_difference(a, b, len);
+            std::size_t nextC = find_difference(a, c, len);
+
+            for (std::size_t i = std::min(nextB, nextC); i < len; i = std::min(nextB, nextC))
+            {
+                emit(base + i, i);
+
+                if (nextB == i)
+                {
+                    nextB = i + 1 + find_difference(a + i + 1, b + i + 1, len - i - 1);
+                }
+
+                if (nextC == i)
+                {
+                    nextC = i + 1 + find_difference(a + i + 1, c + i + 1, len - i - 1);
+                }
+            }
+        }
+
+        if (repair != nullptr)
+        {
+            majority(a, b, c, repaired, len);
+            repair->write(reinterpret_cast<const char*>(repaired), len);
+        }
+
+        base += len;
+    }
+
+    if (base != m_fsize)
+    {
+        throw std::runtime_error("Inputs changed size during vote");
+    }
+
+    output.flush();
+
+    return ret;
+}
@@ -0,0 +1,397 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/* Copyright 2025-2026 isaki */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bitdiff/arena.hpp"
+#include "bitdiff/compare.hpp"
+#include "bitdiff/fd.hpp"
+#include "bitdiff/hash.hpp"
+#include "bitdiff/kernel.hpp"
+#include "bitdiff/reader.hpp"
+#include "bitdiff/trace.hpp"
+#include "bitdiff/watch.hpp"
+
+namespace bd = isaki::bitdiff;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr char OUT_DELIM = '\t';
+
+    // Unit of change detection. Small enough that an append or a local
+    // rewrite re-compares little, large enough to keep the state tiny; a
+    // multiple of every word size.
+    constexpr std::size_t BLOCK_LENGTH = 1024 * 1024;
+
+    // Writers rarely finish in one write(2); wait for a quiet spell before
+    // a pass, but never longer than the cap while writes keep coming.
+    constexpr int SETTLE_MS = 100;
+    constexpr auto SETTLE_CAP = std::chrono::seconds(1);
+
+    constexpr std::uint32_t WATCH_EVENTS = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF;
+    constexpr std::uint32_t GONE_EVENTS = IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED;
+
+    // Room for the DataOut record.
+    constexpr std::size_t SCRATCH_LENGTH = 4096;
+
+    // Write end of the self-pipe; the only state a signal handler may touch.
+    int g_stopFd = -1;
+
+    void on_stop_signal(int) noexcept
+    {
+        const int saved = errno;
+        const char c = 0;
+        [[maybe_unused]] const ssize_t ignored = ::write(g_stopFd, &c, 1);
+        errno = saved;
+    }
+
+    // Turns SIGINT and SIGTERM into a readable pipe for as long as it lives,
+    // so the event loop can stop between passes whichever thread the signal
+    // lands on.
+    struct stop_signal_s
+    {
+        // Read and write ends.
+        bd::FileDescriptor fds[2];
+        struct sigaction oldInt;
+        struct sigaction oldTerm;
+
+        stop_signal_s() :
+            oldInt{},
+            oldTerm{}
+        {
+            int raw[2];
+            if (::pipe2(raw, O_NONBLOCK | O_CLOEXEC) != 0)
+            {
+                throw std::system_error(errno, std::generic_category(), "Unable to create pipe");
+            }
+
+            fds[0] = bd::FileDescriptor(raw[0]);
+            fds[1] = bd::FileDescriptor(raw[1]);
+
+            g_stopFd = fds[1].get();
+
+            struct sigaction sa{};
+            sa.sa_handler = on_stop_signal;
+            sigemptyset(&sa.sa_mask);
+
+            ::sigaction(SIGINT, &sa, &oldInt);
+            ::sigaction(SIGTERM, &sa, &oldTerm);
+        }
+
+        ~stop_signal_s()
+        {
+            ::sigaction(SIGINT, &oldInt, nullptr);
+            ::sigaction(SIGTERM, &oldTerm, nullptr);
+
+            g_stopFd = -1;
+        }
+
+        stop_signal_s(const stop_signal_s&) = delete;
+        stop_signal_s& operator=(const stop_signal_s&) = delete;
+    };
+
+    int add_watch(const int notify, const fs::path& p)
+    {
+        const int wd = ::inotify_add_watch(notify, p.c_str(), WATCH_EVENTS);
+        if (wd < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "Unable to watch " + p.string());
+        }
+
+        return wd;
+    }
+
+    std::uintmax_t size_of(const int fd, const fs::path& p)
+    {
+        struct stat st{};
+        if (::fstat(fd, &st) != 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "Unable to stat " + p.string());
+        }
+
+        return static_cast<std::uintmax_t>(st.st_size);
+    }
+
+    std::uint64_t hash_of(const unsigned char* data, const std::size_t len) noexcept
+    {
+        bd::Hash64 h;
+        h.update(data, len);
+        return h.digest();
+    }
+}
+
+bd::WatchDiff::~WatchDiff() = default;
+
+bd::WatchDiff::WatchDiff(std::string_view a, std::string_view b, const bool fastMode) :
+    m_path_a(a),
+    m_path_b(b),
+    m_total{ .bytes = 0, .bits = 0 },
+    m_fast(fastMode),
+    m_valid(true) {}
+
+bd::diff_count bd::WatchDiff::process(Sink& output, const bool printHeader, const DataOutType type, const word_format_s& word, const Mask* mask)
+{
+    if (!m_valid)
+    {
+        throw std::runtime_error("Attempt to use invalid object");
+    }
+
+    m_valid = false;
+
+    // Set up the watches before the first read so no write is missed.
+    const bd::FileDescriptor notify(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+    if (notify.get() < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Unable to initialize inotify");
+    }
+
+    const int wdA = add_watch(notify.get(), m_path_a);
+    const int wdB = add_watch(notify.get(), m_path_b);
+
+    const bd::FileDescriptor inA = bd::open_read(m_path_a);
+    const bd::FileDescriptor inB = bd::open_read(m_path_b);
+
+    const stop_signal_s stop;
+
+    Arena arena((3 * BLOCK_LENGTH) + SCRATCH_LENGTH + IO_ALIGNMENT);
+    unsigned char* bufferA = arena.allocate<unsigned char>(BLOCK_LENGTH, IO_ALIGNMENT);
+    unsigned char* bufferB = arena.allocate<unsigned char>(BLOCK_LENGTH, IO_ALIGNMENT);
+    unsigned char* bufferMask = arena.allocate<unsigned char>(BLOCK_LENGTH, IO_ALIGNMENT);
+
+    const std::unique_ptr<DataOut> optr = make_data_out(type, OUT_DELIM, word.size, arena);
+
+    if (printHeader)
+    {
+        // Paths are quoted the same way operator<< would.
+        std::ostringstream header;
+        const char* unit = (word.size > 1) ? "Word" : "Byte";
+        header << "Offset\t" << unit << " in " << m_path_a << "\t" << unit << " in " << m_path_b;
+
+        const std::string tmp = header.str();
+        output.write(tmp.data(), tmp.size());
+        output.write("\n", 1);
+    }
+
+    const auto readBlock = [](const int fd, unsigned char* buffer, const std::size_t len, const std::uintmax_t offset)
+    {
+        return pread_fully(fd, buffer, len, offset) == len;
+    };
+
+    // Compares the blocks whose length or content changed. With a file's
+    // changed flag clear its stored hashes are trusted and it is only read
+    // where the other file changed.
+    const auto pass = [&](const bool changedA, const bool changedB)
+    {
+        const std::uintmax_t sizeA = size_of(inA.get(), m_path_a);
+        const std::uintmax_t sizeB = size_of(inB.get(), m_path_b);
+        const std::uintmax_t compared = std::min(sizeA, sizeB);
+
+        const std::size_t blocks = static_cast<std::size_t>((compared + BLOCK_LENGTH - 1) / BLOCK_LENGTH);
+
+        // Blocks past a truncation no longer differ.
+        for (std::size_t i = blocks; i < m_blocks.size(); ++i)
+        {
+            m_total.bytes -= m_blocks[i].count.bytes;
+            m_total.bits -= m_blocks[i].count.bits;
+        }
+
+        m_blocks.resize(blocks);
+
+        std::size_t rediffed = 0;
+        for (std::size_t i = 0; i < blocks; ++i)
+        {
+            const std::uintmax_t base = static_cast<std::uintmax_t>(i) * BLOCK_LENGTH;
+            const std::size_t len = static_cast<std::size_t>(std::min<std::uintmax_t>(BLOCK_LENGTH, compared - base));
+
+            // New blocks start out with no length and no differences.
+            block_s& blk = m_blocks[i];
+            const bool fresh = blk.length != len;
+
+            bool haveA = false;
+            bool haveB = false;
+            std::uint64_t hashA = blk.hashA;
+            std::uint64_t hashB = blk.hashB;
+
+            if (fresh || changedA)
+            {
+                haveA = readBlock(inA.get(), bufferA, len, base);
+                hashA = hash_of(bufferA, len);
+            }
+
+            if (fresh || changedB)
+            {
+                haveB = readBlock(inB.get(), bufferB, len, base);
+                hashB = hash_of(bufferB, len);
+            }
+
+            if (!fresh && hashA == blk.hashA && hashB == blk.hashB)
+            {
+                continue;
+            }
+
+            if ((!haveA && !readBlock(inA.get(), bufferA, len, base)) || (!haveB && !readBlock(inB.get(), bufferB, len, base)))
+            {
+                // Truncated since the sizes were taken; the truncation
+                // wakes another pass, which compares this block again.
+                blk.length = 0;
+                break;
+            }
+
+            const TraceSpan span("compare");
+
+            const unsigned char* compareB = (mask != nullptr) ? mask->apply(base, bufferA, bufferB, bufferMask, len) : bufferB;
+
+            diff_count count{ .bytes = 0, .bits = 0 };
+            for_each_word_difference(word, bufferA, compareB, len, [&](const std::size_t k, const std::uint64_t wordA, const std::uint64_t wordB)
+            {
+                // Masked bits are not counted, but the record shows B as read.
+                const std::uint64_t shownB = (compareB == bufferB) ? wordB : read_word(word, bufferB + k, len - k);
+                optr->init(base + static_cast<std::uintmax_t>(k), wordA, shownB);
+
+                count.bytes += static_cast<std::uintmax_t>(nonzero_bytes(wordA ^ wordB));
+                count.bits += static_cast<std::uintmax_t>(count_bits(wordA ^ wordB));
+
+                optr->print(output);
+                output.write("\n", 1);
+                if (!m_fast)
+                {
+                    output.flush();
+                }
+            });
+
+            m_total.bytes -= blk.count.bytes;
+            m_total.bits -= blk.count.bits;
+            m_total.bytes += count.bytes;
+            m_total.bits += count.bits;
+
+            blk = { .hashA = hashA, .hashB = hashB, .length = len, .count = count };
+            ++rediffed;
+        }
+
+        // Every pass ends on a record boundary a reader can act on.
+        output.flush();
+
+        std::cerr << "Compared " << rediffed << " of " << blocks << " blocks; "
+            << m_total.bits << " bit" << ((m_total.bits != 1) ? "s" : "") << " across "
+            << m_total.bytes << " byte" << ((m_total.bytes != 1) ? "s" : "") << " differ"
+            << std::endl;
+    };
+
+    pass(true, true);
+
+    alignas(struct inotify_event) char events[64 * 1024];
+
+    // Reads queued events; returns false once there are none.
+    bool changedA = false;
+    bool changedB = false;
+    const auto drain = [&]
+    {
+        bool any = false;
+        while (true)
+        {
+            const ssize_t got = ::read(notify.get(), events, sizeof(events));
+            if (got < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                if (errno == EAGAIN)
+                {
+                    return any;
+                }
+
+                throw std::system_error(errno, std::generic_category(), "inotify read failure");
+            }
+
+            for (ssize_t pos = 0; pos < got;)
+            {
+                const auto* ev = reinterpret_cast<const struct inotify_event*>(events + pos);
+                pos += static_cast<ssize_t>(sizeof(struct inotify_event) + ev->len);
+
+                const fs::path& which = (ev->wd == wdA) ? m_path_a : m_path_b;
+                if ((ev->mask & GONE_EVENTS) != 0)
+                {
+                    // The open descriptor would go on reading the old file.
+                    std::string err;
+                    err.append(which.string());
+                    err.append(" was removed or renamed");
+                    throw std::runtime_error(err);
+                }
+
+                changedA = changedA || ev->wd == wdA;
+                changedB = changedB || ev->wd == wdB;
+                any = true;
+            }
+        }
+    };
+
+    std::cerr << "Watching for changes; interrupt to stop" << std::endl;
+
+    while (true)
+    {
+        pollfd fds[2] = {
+            { .fd = notify.get(), .events = POLLIN, .revents = 0 },
+            { .fd = stop.fds[0].get(), .events = POLLIN, .revents = 0 }
+        };
+
+        {
+            const TraceSpan span("wait");
+            if (::poll(fds, 2, -1) < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                throw std::system_error(errno, std::generic_category(), "poll failure");
+            }
+        }
+
+        if ((fds[1].revents & POLLIN) != 0)
+        {
+            break;
+        }
+
+        if (!drain())
+        {
+            continue;
+        }
+
+        const auto deadline = std::chrono::steady_clock::now() + SETTLE_CAP;
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            pollfd quiet = { .fd = notify.get(), .events = POLLIN, .revents = 0 };
+            if (::poll(&quiet, 1, SETTLE_MS) <= 0 || !drain())
+            {
+                break;
+            }
+        }
+
+        pass(changedA, changedB);
+        changedA = false;
+        changedB = false;
+    }
+
+    return m_total;
+}